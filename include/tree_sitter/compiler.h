@@ -5,6 +5,9 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef enum {
   TSCompileErrorTypeNone,
   TSCompileErrorTypeInvalidGrammar,
@@ -24,7 +27,56 @@ typedef struct {
   TSCompileErrorType error_type;
 } TSCompileResult;
 
+typedef struct {
+  char *data;
+  size_t size;
+  char *error_message;
+  TSCompileErrorType error_type;
+} TSBinaryCompileResult;
+
+typedef struct {
+  uint64_t parse_grammar_micros;
+  uint64_t intern_symbols_micros;
+  uint64_t extract_tokens_micros;
+  uint64_t expand_repeats_micros;
+  uint64_t flatten_grammar_micros;
+  uint64_t normalize_rules_micros;
+  uint64_t item_set_closure_micros;
+  uint64_t add_actions_micros;
+  uint64_t unmergable_token_pairs_micros;
+  uint64_t merge_parse_states_micros;
+  uint64_t lex_table_micros;
+  uint64_t code_generation_micros;
+  uint64_t total_micros;
+  uint32_t item_set_count;
+  uint32_t closure_expansion_count;
+  uint32_t token_conflict_cache_hit_count;
+  uint32_t token_conflict_cache_miss_count;
+  uint32_t prepared_grammar_cache_hit_count;
+  uint32_t lex_item_set_count;
+  uint32_t parse_state_count;
+  uint32_t lex_state_count;
+  size_t peak_memory_bytes;
+} TSCompileStats;
+
+// Results that can be shared between compilations of similar grammars. Token
+// conflict results are keyed by the tokens' rules, so recompiling an edited
+// grammar only checks the tokens that the edit affects. The most recently
+// prepared grammar is reused when the next grammar has the same rules. Only
+// the token conflict results are serialized, so that they outlive the
+// process. A cache must not be used by two compilations at once.
+typedef struct TSCompileCache TSCompileCache;
+
+TSCompileCache *ts_compile_cache_new();
+TSCompileCache *ts_compile_cache_load(const char *data, size_t length);
+char *ts_compile_cache_serialize(const TSCompileCache *, size_t *length);
+void ts_compile_cache_free(TSCompileCache *);
+
 TSCompileResult ts_compile_grammar(const char *input);
+TSCompileResult ts_compile_grammar_with_stats(const char *input, TSCompileStats *);
+TSCompileResult ts_compile_grammar_with_cache(const char *input, TSCompileCache *,
+                                              TSCompileStats *);
+TSBinaryCompileResult ts_compile_grammar_binary(const char *input);
 
 #ifdef __cplusplus
 }
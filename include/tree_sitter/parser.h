@@ -24,8 +24,14 @@ typedef struct {
   bool structural : 1;
 } TSSymbolMetadata;
 
+typedef struct {
+  uint32_t ascii[4];
+  bool non_ascii : 1;
+} TSCharacterClass;
+
 typedef struct {
   void (*advance)(void *, bool);
+  void (*advance_while)(void *, const TSCharacterClass *, bool);
   void (*mark_end)(void *);
   int32_t lookahead;
   TSSymbol result_symbol;
@@ -70,9 +76,12 @@ typedef struct TSLanguage {
   uint32_t symbol_count;
   uint32_t token_count;
   uint32_t external_token_count;
+  uint32_t large_state_count;
   const char **symbol_names;
   const TSSymbolMetadata *symbol_metadata;
   const unsigned short *parse_table;
+  const unsigned short *small_parse_table;
+  const uint32_t *small_parse_table_map;
   const TSParseActionEntry *parse_actions;
   const TSLexMode *lex_modes;
   bool (*lex_fn)(TSLexer *, TSStateId);
@@ -112,6 +121,20 @@ typedef struct TSLanguage {
     goto next_state;             \
   }
 
+#define ADVANCE_WHILE(state_value, class_index)                             \
+  {                                                                         \
+    lexer->advance_while(lexer, &ts_character_classes[class_index], false); \
+    state = state_value;                                                    \
+    goto next_state;                                                        \
+  }
+
+#define SKIP_WHILE(state_value, class_index)                               \
+  {                                                                        \
+    lexer->advance_while(lexer, &ts_character_classes[class_index], true); \
+    state = state_value;                                                   \
+    goto next_state;                                                       \
+  }
+
 #define ACCEPT_TOKEN(symbol_value)     \
   result = true;                       \
   lexer->result_symbol = symbol_value; \
@@ -125,6 +148,7 @@ typedef struct TSLanguage {
 
 #define STATE(id) id
 #define ACTIONS(id) id
+#define SMALL_STATE(id) ((id) - LARGE_STATE_COUNT)
 
 #define SHIFT(to_state_value)                                                 \
   {                                                                           \
@@ -172,7 +196,10 @@ typedef struct TSLanguage {
     .symbol_count = SYMBOL_COUNT,                                  \
     .token_count = TOKEN_COUNT,                                    \
     .symbol_metadata = ts_symbol_metadata,                         \
+    .large_state_count = LARGE_STATE_COUNT,                        \
     .parse_table = (const unsigned short *)ts_parse_table,         \
+    .small_parse_table = ts_small_parse_table,                     \
+    .small_parse_table_map = ts_small_parse_table_map,             \
     .parse_actions = ts_parse_actions,                             \
     .lex_modes = ts_lex_modes,                                     \
     .symbol_names = ts_symbol_names,                               \
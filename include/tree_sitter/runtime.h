@@ -9,11 +9,13 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 
-#define TREE_SITTER_LANGUAGE_VERSION 2
+#define TREE_SITTER_LANGUAGE_VERSION 4
 
 typedef unsigned short TSSymbol;
 typedef struct TSLanguage TSLanguage;
 typedef struct TSDocument TSDocument;
+typedef struct TSTreeCursor TSTreeCursor;
+typedef struct TSTraceBuffer TSTraceBuffer;
 
 typedef enum {
   TSInputEncodingUTF8,
@@ -56,6 +58,98 @@ typedef struct {
   TSPoint end;
 } TSRange;
 
+typedef struct {
+  uint32_t lex_count;
+  uint32_t bytes_lexed;
+  uint32_t external_scan_count;
+  uint32_t token_cache_hit_count;
+  uint32_t token_cache_miss_count;
+  uint32_t shift_count;
+  uint32_t reduce_count;
+  uint32_t max_version_count;
+  float average_version_count;
+  uint32_t merge_count;
+  uint32_t condense_count;
+  uint32_t dropped_version_count;
+  uint32_t handle_error_count;
+  uint32_t repair_error_count;
+  uint32_t recover_count;
+  uint32_t reused_subtree_count;
+  uint32_t reused_bytes;
+  uint64_t lex_nanos;
+  uint64_t error_handling_nanos;
+  uint64_t condense_nanos;
+  uint64_t balance_nanos;
+  uint64_t total_nanos;
+} TSParseStats;
+
+typedef enum {
+  TSParseStatusComplete,
+  TSParseStatusPaused,
+  TSParseStatusCancelled,
+} TSParseStatus;
+
+typedef enum {
+  TSTraceEventNewParse,
+  TSTraceEventParseAfterEdit,
+  TSTraceEventResumeParse,
+  TSTraceEventPauseParse,
+  TSTraceEventReset,
+  TSTraceEventProcess,
+  TSTraceEventCondense,
+  TSTraceEventDone,
+  TSTraceEventTokenCache,
+  TSTraceEventRestoreExternalScanner,
+  TSTraceEventLexExternal,
+  TSTraceEventLexInternal,
+  TSTraceEventRetryInErrorMode,
+  TSTraceEventSkipUnrecognizedCharacter,
+  TSTraceEventLexedLookahead,
+  TSTraceEventCachedLookahead,
+  TSTraceEventReusedLookahead,
+  TSTraceEventBeforeReusableNode,
+  TSTraceEventPastReusable,
+  TSTraceEventCantReuseChanged,
+  TSTraceEventCantReuseError,
+  TSTraceEventCantReuseExternalTokens,
+  TSTraceEventBreakdownTopOfStack,
+  TSTraceEventStateMismatch,
+  TSTraceEventSelectSmallerError,
+  TSTraceEventSelectEarlier,
+  TSTraceEventSelectExisting,
+  TSTraceEventHaltOther,
+  TSTraceEventShift,
+  TSTraceEventShiftExtra,
+  TSTraceEventReduce,
+  TSTraceEventAccept,
+  TSTraceEventBailOnError,
+  TSTraceEventHandleError,
+  TSTraceEventSkipPrecedingTrees,
+  TSTraceEventRepairError,
+  TSTraceEventNoRepairFound,
+  TSTraceEventNoBetterRepairFound,
+  TSTraceEventRepairFound,
+  TSTraceEventRecoverEOF,
+  TSTraceEventRecover,
+  TSTraceEventBailOnRecovery,
+  TSTraceEventSkipCharacter,
+  TSTraceEventConsumeCharacter,
+  TSTraceEventDropVersion,
+} TSTraceEventType;
+
+// A fixed-size record of one parser or lexer action. The meaning of `symbol`,
+// `other_symbol` and `arguments` depends on the event type; they hold exactly
+// what `ts_trace_event_format` needs to render the action's log message.
+typedef struct {
+  uint16_t type;
+  uint16_t state;
+  TSSymbol symbol;
+  TSSymbol other_symbol;
+  uint32_t byte_offset;
+  TSPoint point;
+  uint32_t arguments[2];
+} TSTraceEvent;
+
 typedef struct {
   const void *data;
   uint32_t offset[3];
@@ -97,6 +191,13 @@ TSNode ts_node_named_descendant_for_byte_range(TSNode, uint32_t, uint32_t);
 TSNode ts_node_descendant_for_point_range(TSNode, TSPoint, TSPoint);
 TSNode ts_node_named_descendant_for_point_range(TSNode, TSPoint, TSPoint);
 
+TSTreeCursor *ts_document_tree_cursor(const TSDocument *);
+void ts_tree_cursor_delete(TSTreeCursor *);
+bool ts_tree_cursor_goto_first_child(TSTreeCursor *);
+bool ts_tree_cursor_goto_next_sibling(TSTreeCursor *);
+bool ts_tree_cursor_goto_parent(TSTreeCursor *);
+TSNode ts_tree_cursor_current_node(const TSTreeCursor *);
+
 TSDocument *ts_document_new();
 void ts_document_free(TSDocument *);
 const TSLanguage *ts_document_language(TSDocument *);
@@ -105,19 +206,46 @@ TSInput ts_document_input(TSDocument *);
 void ts_document_set_input(TSDocument *, TSInput);
 void ts_document_set_input_string(TSDocument *, const char *);
 void ts_document_set_input_string_with_length(TSDocument *, const char *, uint32_t);
+bool ts_document_set_input_file(TSDocument *, int fd);
 TSLogger ts_document_logger(const TSDocument *);
 void ts_document_set_logger(TSDocument *, TSLogger);
 void ts_document_print_debugging_graphs(TSDocument *, bool);
+const volatile size_t *ts_document_cancellation_flag(const TSDocument *);
+void ts_document_set_cancellation_flag(TSDocument *, const volatile size_t *);
+uint64_t ts_document_timeout_micros(const TSDocument *);
+void ts_document_set_timeout_micros(TSDocument *, uint64_t);
+uint32_t ts_document_version_limit(const TSDocument *);
+void ts_document_set_version_limit(TSDocument *, uint32_t);
+uint32_t ts_document_lex_limit(const TSDocument *);
+void ts_document_set_lex_limit(TSDocument *, uint32_t);
+void ts_document_set_arena_enabled(TSDocument *, bool);
 void ts_document_edit(TSDocument *, TSInputEdit);
-void ts_document_parse(TSDocument *);
-void ts_document_parse_and_get_changed_ranges(TSDocument *, TSRange **, uint32_t *);
+bool ts_document_parse(TSDocument *);
+bool ts_document_parse_and_get_changed_ranges(TSDocument *, TSRange **, uint32_t *);
 void ts_document_invalidate(TSDocument *);
 TSNode ts_document_root_node(const TSDocument *);
 uint32_t ts_document_parse_count(const TSDocument *);
+TSParseStatus ts_document_parse_status(const TSDocument *);
+TSParseStats ts_document_parse_stats(const TSDocument *);
+void ts_document_set_phase_timing_enabled(TSDocument *, bool);
+TSTraceBuffer *ts_document_trace_buffer(const TSDocument *);
+void ts_document_set_trace_buffer(TSDocument *, TSTraceBuffer *);
+
+TSTraceBuffer *ts_trace_buffer_new(uint32_t capacity);
+void ts_trace_buffer_delete(TSTraceBuffer *);
+void ts_trace_buffer_clear(TSTraceBuffer *);
+uint32_t ts_trace_buffer_event_count(const TSTraceBuffer *);
+uint64_t ts_trace_buffer_dropped_event_count(const TSTraceBuffer *);
+const TSTraceEvent *ts_trace_buffer_event(const TSTraceBuffer *, uint32_t);
+void ts_trace_buffer_replay(const TSTraceBuffer *, const TSLanguage *, TSLogger);
+TSLogType ts_trace_event_log_type(const TSTraceEvent *);
+uint32_t ts_trace_event_format(const TSTraceEvent *, const TSLanguage *, char *, uint32_t);
 
 uint32_t ts_language_symbol_count(const TSLanguage *);
 const char *ts_language_symbol_name(const TSLanguage *, TSSymbol);
 uint32_t ts_language_version(const TSLanguage *);
+const TSLanguage *ts_language_load(const void *, size_t);
+void ts_language_free(const TSLanguage *);
 
 #ifdef __cplusplus
 }
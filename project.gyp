@@ -21,8 +21,11 @@
         'src/compiler/build_tables/parse_item.cc',
         'src/compiler/build_tables/parse_item_set_builder.cc',
         'src/compiler/build_tables/rule_can_be_blank.cc',
+        'src/compiler/build_tables/token_conflict_cache.cc',
         'src/compiler/compile.cc',
+        'src/compiler/generate_code/binary.cc',
         'src/compiler/generate_code/c_code.cc',
+        'src/compiler/generate_code/parse_table_layout.cc',
         'src/compiler/lex_table.cc',
         'src/compiler/parse_grammar.cc',
         'src/compiler/parse_table.cc',
@@ -44,6 +47,7 @@
         'src/compiler/rules/repeat.cc',
         'src/compiler/rules/seq.cc',
         'src/compiler/util/string_helpers.cc',
+        'src/compiler/util/worker_pool.cc',
         'externals/utf8proc/utf8proc.c',
         'externals/json-parser/json.c',
       ],
@@ -60,9 +64,16 @@
         ],
       },
 
-      # Mac OS has an old version of libstdc++ that doesn't support c++11.
-      # libc++ is only present on 10.7 and later.
       'conditions': [
+        # The parse table builder computes item set closures on several threads.
+        ['OS != "win"', {
+          'link_settings': {
+            'libraries': [ '-lpthread' ],
+          },
+        }],
+
+        # Mac OS has an old version of libstdc++ that doesn't support c++11.
+        # libc++ is only present on 10.7 and later.
         ['OS == "mac"', {
           'cflags_cc': [ '-stdlib=libc++' ],
           'xcode_settings': {
@@ -85,20 +96,25 @@
       'include_dirs': [
         'include',
         'src',
-        'externals/utf8proc',
       ],
       'sources': [
+        'src/runtime/binary_language.c',
+        'src/runtime/clock.c',
         'src/runtime/document.c',
         'src/runtime/error_costs.c',
+        'src/runtime/file_input.c',
         'src/runtime/language.c',
         'src/runtime/lexer.c',
         'src/runtime/node.c',
         'src/runtime/stack.c',
         'src/runtime/parser.c',
         'src/runtime/string_input.c',
+        'src/runtime/trace.c',
         'src/runtime/tree.c',
+        'src/runtime/tree_arena.c',
+        'src/runtime/tree_cursor.c',
         'src/runtime/utf16.c',
-        'externals/utf8proc/utf8proc.c',
+        'src/runtime/utf8.c',
       ],
       'cflags_c': [
         '-std=c99'
@@ -138,6 +154,15 @@
         'cflags': [ '-O2', '-fno-strict-aliasing' ],
         'cflags!': [ '-O3', '-fstrict-aliasing' ],
       },
+      'Benchmark': {
+        'defines': ['TREE_SITTER_WRAP_MALLOC=true'],
+        'cflags': [ '-O2', '-g', '-fno-strict-aliasing' ],
+        'ldflags': [ '-g' ],
+        'xcode_settings': {
+          'OTHER_LDFLAGS': ['-g'],
+          'GCC_OPTIMIZATION_LEVEL': '2',
+        },
+      },
     },
 
     'cflags': [
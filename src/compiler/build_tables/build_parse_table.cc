@@ -12,6 +12,10 @@
 #include "compiler/syntax_grammar.h"
 #include "compiler/rule.h"
 #include "compiler/build_tables/lex_table_builder.h"
+#include "compiler/build_tables/token_conflict_cache.h"
+#include "compiler/util/hash_combine.h"
+#include "compiler/util/phase_timer.h"
+#include "compiler/util/worker_pool.h"
 
 namespace tree_sitter {
 namespace build_tables {
@@ -23,31 +27,79 @@ using std::set;
 using std::map;
 using std::string;
 using std::to_string;
+using std::unique_ptr;
 using std::unordered_map;
 using rules::Associativity;
 using rules::Symbol;
 using rules::END_OF_INPUT;
+using util::hash_combine;
+using util::PhaseTimer;
+using util::WorkerPool;
+
+// The number of pending item sets whose closures are computed in one batch,
+// for each worker thread.
+static const size_t ITEM_SETS_PER_THREAD = 4;
+
+// Two states can only be merged if they have the same nonterminal entries, and
+// the same entries for every lookahead whose last action is not a reduction,
+// because merging only adds entries that end in a reduction. This hashes those
+// entries, so that states that differ in them are never compared.
+static size_t parse_state_merge_key(const ParseState &state) {
+  size_t result = 0;
+  for (const auto &pair : state.terminal_entries) {
+    const vector<ParseAction> &actions = pair.second.actions;
+    if (actions.back().type == ParseActionTypeReduce) continue;
+    hash_combine(&result, pair.first);
+    for (const ParseAction &action : actions) {
+      hash_combine(&result, static_cast<int>(action.type));
+      hash_combine(&result, action.symbol);
+      hash_combine(&result, action.state_index);
+    }
+  }
+  for (const auto &pair : state.nonterminal_entries) {
+    hash_combine(&result, pair.first);
+    hash_combine(&result, pair.second);
+  }
+  return result;
+}
 
 class ParseTableBuilder {
+  struct PendingItemSet {
+    ParseItemSet item_set;
+    ParseStateId state_id;
+    bool is_closed;
+  };
+
   const SyntaxGrammar grammar;
   const LexicalGrammar lexical_grammar;
   unordered_map<Symbol, ParseItemSet> recovery_states;
   unordered_map<ParseItemSet, ParseStateId> parse_state_ids;
-  vector<pair<ParseItemSet, ParseStateId>> item_sets_to_process;
+  vector<PendingItemSet> item_sets_to_process;
   ParseTable parse_table;
   set<string> conflicts;
   ParseItemSetBuilder item_set_builder;
   set<const Production *> fragile_productions;
   vector<set<Symbol>> incompatible_tokens_by_index;
   bool allow_any_conflict;
+  unsigned thread_count;
+  WorkerPool worker_pool;
+  TSCompileStats *stats;
+  TokenConflictCache *token_conflict_cache;
 
  public:
   ParseTableBuilder(const SyntaxGrammar &grammar,
-                    const LexicalGrammar &lex_grammar)
+                    const LexicalGrammar &lex_grammar,
+                    unsigned thread_count,
+                    TSCompileStats *stats,
+                    TokenConflictCache *token_conflict_cache)
       : grammar(grammar),
         lexical_grammar(lex_grammar),
         item_set_builder(grammar, lex_grammar),
-        allow_any_conflict(false) {}
+        allow_any_conflict(false),
+        thread_count(thread_count),
+        worker_pool(thread_count),
+        stats(stats),
+        token_conflict_cache(token_conflict_cache) {}
 
   pair<ParseTable, CompileError> build() {
     Symbol start_symbol = grammar.variables.empty() ?
@@ -73,7 +125,10 @@ class ParseTableBuilder {
       return { parse_table, error };
     }
 
-    compute_unmergable_token_pairs();
+    {
+      PhaseTimer timer(stats ? &stats->unmergable_token_pairs_micros : nullptr);
+      compute_unmergable_token_pairs();
+    }
 
     build_error_parse_state();
 
@@ -82,7 +137,16 @@ class ParseTableBuilder {
     allow_any_conflict = false;
 
     mark_fragile_actions();
-    remove_duplicate_parse_states();
+
+    if (stats) {
+      stats->item_set_count = parse_table.states.size();
+      stats->closure_expansion_count = item_set_builder.get_closure_expansion_count();
+    }
+
+    {
+      PhaseTimer timer(stats ? &stats->merge_parse_states_micros : nullptr);
+      remove_duplicate_parse_states();
+    }
 
     return { parse_table, CompileError::none() };
   }
@@ -90,13 +154,17 @@ class ParseTableBuilder {
  private:
   CompileError process_part_state_queue() {
     while (!item_sets_to_process.empty()) {
-      auto pair = item_sets_to_process.back();
-      ParseItemSet &item_set = pair.first;
-      ParseStateId state_id = pair.second;
+      if (!item_sets_to_process.back().is_closed) {
+        PhaseTimer timer(stats ? &stats->item_set_closure_micros : nullptr);
+        close_pending_item_sets();
+      }
+
+      PendingItemSet entry = item_sets_to_process.back();
       item_sets_to_process.pop_back();
 
-      item_set_builder.apply_transitive_closure(&item_set);
-      string conflict = add_actions(item_set, state_id);
+      PhaseTimer timer(stats ? &stats->add_actions_micros : nullptr);
+      string conflict = add_actions(entry.item_set, entry.state_id);
+      timer.stop();
 
       if (!conflict.empty()) {
         return CompileError(TSCompileErrorTypeParseConflict, conflict);
@@ -106,6 +174,26 @@ class ParseTableBuilder {
     return CompileError::none();
   }
 
+  // Compute the transitive closures of a batch of item sets from the top of the
+  // queue, using the worker pool. The item sets are still added to the parse
+  // table one at a time, in the same order as in a single-threaded build, so
+  // the numbering of the parse states does not depend on the thread count.
+  void close_pending_item_sets() {
+    vector<ParseItemSet *> item_sets;
+    size_t batch_size = thread_count > 1 ? thread_count * ITEM_SETS_PER_THREAD : 1;
+    for (auto iter = item_sets_to_process.rbegin(), end = item_sets_to_process.rend();
+         iter != end && item_sets.size() < batch_size; ++iter) {
+      if (!iter->is_closed) {
+        iter->is_closed = true;
+        item_sets.push_back(&iter->item_set);
+      }
+    }
+
+    worker_pool.run(item_sets.size(), [&](size_t i) {
+      item_set_builder.apply_transitive_closure(item_sets[i]);
+    });
+  }
+
   void build_error_parse_state() {
     ParseState error_state;
 
@@ -164,7 +252,7 @@ class ParseTableBuilder {
       parse_table.states.push_back(ParseState());
       parse_state_ids[item_set] = state_id;
       parse_table.states[state_id].shift_actions_signature = item_set.unfinished_item_signature();
-      item_sets_to_process.push_back({ std::move(item_set), state_id });
+      item_sets_to_process.push_back({ item_set, state_id, false });
       return state_id;
     } else {
       return pair->second;
@@ -188,7 +276,7 @@ class ParseTableBuilder {
           ParseAction::Reduce(item.lhs(), item.step_index, *item.production);
 
         int precedence = item.precedence();
-        for (Symbol lookahead : *lookahead_symbols.entries) {
+        lookahead_symbols.for_each([&](const Symbol &lookahead) {
           ParseTableEntry &entry = parse_table.states[state_id].terminal_entries[lookahead];
 
           // Only add the highest-precedence Reduce actions to the parse table.
@@ -215,7 +303,7 @@ class ParseTableBuilder {
               }
             }
           }
-        }
+        });
 
       // If the item is unfinished, create a new item by advancing one symbol.
       // Add that new item to a successor item set.
@@ -307,14 +395,25 @@ class ParseTableBuilder {
   void compute_unmergable_token_pairs() {
     incompatible_tokens_by_index.resize(lexical_grammar.variables.size());
 
-    auto lex_table_builder = LexTableBuilder::create(lexical_grammar);
+    TokenConflictCache::GrammarIds ids;
+    if (token_conflict_cache) ids = token_conflict_cache->intern(lexical_grammar);
+    unique_ptr<LexTableBuilder> lex_table_builder;
     for (unsigned i = 0, n = lexical_grammar.variables.size(); i < n; i++) {
       Symbol token = Symbol::terminal(i);
       auto &incompatible_indices = incompatible_tokens_by_index[i];
 
       for (unsigned j = 0; j < n; j++) {
         if (i == j) continue;
-        if (lex_table_builder->detect_conflict(i, j)) {
+        bool conflict;
+        if (token_conflict_cache && token_conflict_cache->find(ids, i, j, &conflict)) {
+          if (stats) stats->token_conflict_cache_hit_count++;
+        } else {
+          if (!lex_table_builder) lex_table_builder = LexTableBuilder::create(lexical_grammar);
+          conflict = lex_table_builder->detect_conflict(i, j);
+          if (token_conflict_cache) token_conflict_cache->insert(ids, i, j, conflict);
+          if (stats) stats->token_conflict_cache_miss_count++;
+        }
+        if (conflict) {
           incompatible_indices.insert(Symbol::terminal(j));
         }
       }
@@ -330,27 +429,85 @@ class ParseTableBuilder {
   }
 
   void remove_duplicate_parse_states() {
-    map<size_t, set<ParseStateId>> state_indices_by_signature;
+    set<ParseStateId> deleted_states;
+    merge_equivalent_parse_states(&parse_table, &deleted_states);
+    merge_compatible_parse_states(&deleted_states);
 
-    for (ParseStateId i = 0, n = parse_table.states.size(); i < n; i++) {
-      ParseState &state = parse_table.states[i];
-      state_indices_by_signature[state.shift_actions_signature].insert(i);
+    vector<ParseStateId> new_state_ids(parse_table.states.size());
+    size_t deleted_state_count = 0;
+    auto deleted_state_iter = deleted_states.begin();
+    for (ParseStateId i = 0; i < new_state_ids.size(); i++) {
+      while (deleted_state_iter != deleted_states.end() && *deleted_state_iter < i) {
+        deleted_state_count++;
+        deleted_state_iter++;
+      }
+      new_state_ids[i] = i - deleted_state_count;
     }
 
-    set<ParseStateId> deleted_states;
+    ParseStateId original_state_index = 0;
+    auto iter = parse_table.states.begin();
+    while (iter != parse_table.states.end()) {
+      if (deleted_states.count(original_state_index)) {
+        iter = parse_table.states.erase(iter);
+      } else {
+        ParseState &state = *iter;
+        state.each_referenced_state([&new_state_ids](ParseStateId *state_index) {
+          *state_index = new_state_ids[*state_index];
+        });
+        ++iter;
+      }
+      original_state_index++;
+    }
+  }
+
+  // Merge pairs of states whose actions do not conflict, even though they are
+  // not identical, until no more states can be merged.
+  //
+  // Candidates are grouped by shift_actions_signature and by
+  // parse_state_merge_key, which merging never changes. A pair that failed to
+  // merge is only compared again once one of its states has changed, and when
+  // a state is merged away, only the states that refer to it are updated.
+  // The first pass still compares every pair within a group, so the phase is
+  // quadratic in the size of the largest group, but the passes after it only
+  // revisit the states that the previous pass changed.
+  void merge_compatible_parse_states(set<ParseStateId> *deleted_states) {
+    typedef pair<size_t, size_t> GroupKey;
+    size_t state_count = parse_table.states.size();
+    map<GroupKey, set<ParseStateId>> state_indices_by_key;
+    vector<GroupKey> state_keys(state_count);
+    vector<set<ParseStateId>> referring_states(state_count);
+    vector<bool> changed_states(state_count, true);
+
+    for (ParseStateId i = 0; i < state_count; i++) {
+      if (deleted_states->count(i)) continue;
+      ParseState &state = parse_table.states[i];
+      state_keys[i] = { state.shift_actions_signature, parse_state_merge_key(state) };
+      state_indices_by_key[state_keys[i]].insert(i);
+      state.each_referenced_state([&](ParseStateId *state_index) {
+        referring_states[*state_index].insert(i);
+      });
+    }
 
     while (true) {
       map<ParseStateId, ParseStateId> state_replacements;
+      vector<bool> next_changed_states(state_count, false);
 
-      for (auto &pair : state_indices_by_signature) {
+      for (auto &pair : state_indices_by_key) {
         auto &state_group = pair.second;
 
         for (ParseStateId i : state_group) {
           for (ParseStateId j : state_group) {
             if (j == i) break;
+            if (!changed_states[i] && !changed_states[j]) continue;
             if (!state_replacements.count(j) && merge_parse_state(j, i)) {
               state_replacements.insert({ i, j });
-              deleted_states.insert(i);
+              deleted_states->insert(i);
+              changed_states[j] = next_changed_states[j] = true;
+
+              // The merged entries may include shifts alongside their reductions.
+              parse_table.states[j].each_referenced_state([&](ParseStateId *state_index) {
+                referring_states[*state_index].insert(j);
+              });
               break;
             }
           }
@@ -359,46 +516,33 @@ class ParseTableBuilder {
 
       if (state_replacements.empty()) break;
 
-      for (ParseStateId i = 0, n = parse_table.states.size(); i < n; i++) {
-        ParseState &state = parse_table.states[i];
+      for (auto &replacement : state_replacements) {
+        state_indices_by_key[state_keys[replacement.first]].erase(replacement.first);
+      }
 
-        if (state_replacements.count(i)) {
-          state_indices_by_signature[state.shift_actions_signature].erase(i);
-        } else {
+      for (auto &merged_pair : state_replacements) {
+        for (ParseStateId i : referring_states[merged_pair.first]) {
+          if (deleted_states->count(i)) continue;
+          ParseState &state = parse_table.states[i];
           state.each_referenced_state([&state_replacements](ParseStateId *state_index) {
             auto replacement = state_replacements.find(*state_index);
             if (replacement != state_replacements.end()) {
               *state_index = replacement->second;
             }
           });
+          referring_states[merged_pair.second].insert(i);
+          next_changed_states[i] = true;
+
+          GroupKey key = { state.shift_actions_signature, parse_state_merge_key(state) };
+          if (key != state_keys[i]) {
+            state_indices_by_key[state_keys[i]].erase(i);
+            state_indices_by_key[key].insert(i);
+            state_keys[i] = key;
+          }
         }
       }
-    }
 
-    vector<ParseStateId> new_state_ids(parse_table.states.size());
-    size_t deleted_state_count = 0;
-    auto deleted_state_iter = deleted_states.begin();
-    for (ParseStateId i = 0; i < new_state_ids.size(); i++) {
-      while (deleted_state_iter != deleted_states.end() && *deleted_state_iter < i) {
-        deleted_state_count++;
-        deleted_state_iter++;
-      }
-      new_state_ids[i] = i - deleted_state_count;
-    }
-
-    ParseStateId original_state_index = 0;
-    auto iter = parse_table.states.begin();
-    while (iter != parse_table.states.end()) {
-      if (deleted_states.count(original_state_index)) {
-        iter = parse_table.states.erase(iter);
-      } else {
-        ParseState &state = *iter;
-        state.each_referenced_state([&new_state_ids](ParseStateId *state_index) {
-          *state_index = new_state_ids[*state_index];
-        });
-        ++iter;
-      }
-      original_state_index++;
+      changed_states.swap(next_changed_states);
     }
   }
 
@@ -466,6 +610,39 @@ class ParseTableBuilder {
     return true;
   }
 
+  bool is_repetition_production(const Symbol &symbol, const Production &production) {
+    return symbol.is_non_terminal() &&
+      grammar.variables[symbol.index].type == VariableTypeAuxiliary &&
+      production.size() == 2 &&
+      production[0].symbol == symbol &&
+      production[1].symbol == symbol;
+  }
+
+  bool is_repetition_conflict(const ParseItemSet &item_set,
+                              const ParseTableEntry &entry, Symbol lookahead) {
+    if (entry.actions.size() != 2 ||
+        entry.actions.front().type != ParseActionTypeReduce ||
+        entry.actions.back().type != ParseActionTypeShift)
+      return false;
+
+    const ParseAction &reduction = entry.actions.front();
+    if (!is_repetition_production(reduction.symbol, *reduction.production))
+      return false;
+
+    for (const auto &item_set_entry : item_set.entries) {
+      const ParseItem &item = item_set_entry.first;
+      if (item.step_index > 0 && !item.is_done()) {
+        LookaheadSet first_set = item_set_builder.get_first_set(item.next_symbol());
+        if (first_set.contains(lookahead) &&
+            (item.lhs() != reduction.symbol ||
+             !is_repetition_production(item.lhs(), *item.production)))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
   string handle_conflict(const ParseItemSet &item_set, ParseStateId state_id,
                          Symbol lookahead) {
     ParseTableEntry &entry = parse_table.states[state_id].terminal_entries[lookahead];
@@ -473,6 +650,15 @@ class ParseTableBuilder {
     set<ParseItem> shift_items;
     bool considered_associativity = false;
 
+    // Repetitions are expanded into ambiguous `x_repeat -> x_repeat x_repeat`
+    // productions so that the runtime can store them as balanced trees.
+    // Resolve their conflicts in favor of the reduction, without marking the
+    // production as fragile, so that repetition nodes stay reusable.
+    if (is_repetition_conflict(item_set, entry, lookahead)) {
+      entry.actions.pop_back();
+      return "";
+    }
+
     for (const ParseAction &action : entry.actions)
       if (action.type == ParseActionTypeReduce)
         fragile_productions.insert(action.production);
@@ -697,9 +883,108 @@ class ParseTableBuilder {
   }
 };
 
+static size_t parse_state_shape_hash(const ParseState &state) {
+  size_t result = 0;
+  hash_combine(&result, state.shift_actions_signature);
+  hash_combine(&result, state.terminal_entries.size());
+  for (const auto &pair : state.terminal_entries) {
+    hash_combine(&result, pair.first);
+    hash_combine(&result, pair.second.actions.size());
+    for (const ParseAction &action : pair.second.actions) {
+      hash_combine(&result, static_cast<int>(action.type));
+      hash_combine(&result, action.symbol);
+      hash_combine(&result, action.consumed_symbol_count);
+    }
+  }
+  hash_combine(&result, state.nonterminal_entries.size());
+  for (const auto &pair : state.nonterminal_entries)
+    hash_combine(&result, pair.first);
+  return result;
+}
+
+static bool parse_states_have_same_shape(ParseState state, ParseState other) {
+  if (state.shift_actions_signature != other.shift_actions_signature)
+    return false;
+
+  state.each_referenced_state([](ParseStateId *state_index) { *state_index = 0; });
+  other.each_referenced_state([](ParseStateId *state_index) { *state_index = 0; });
+  return state == other;
+}
+
+void merge_equivalent_parse_states(ParseTable *parse_table,
+                                   set<ParseStateId> *deleted_states) {
+  size_t state_count = parse_table->states.size();
+  vector<size_t> group_ids(state_count);
+  vector<ParseStateId> group_representatives;
+
+  unordered_map<size_t, vector<ParseStateId>> representatives_by_hash;
+  for (ParseStateId i = 0; i < state_count; i++) {
+    vector<ParseStateId> &candidates =
+      representatives_by_hash[parse_state_shape_hash(parse_table->states[i])];
+
+    bool found_group = false;
+    for (ParseStateId j : candidates) {
+      if (parse_states_have_same_shape(parse_table->states[i], parse_table->states[j])) {
+        group_ids[i] = group_ids[j];
+        found_group = true;
+        break;
+      }
+    }
+
+    if (!found_group) {
+      group_ids[i] = group_representatives.size();
+      group_representatives.push_back(i);
+      candidates.push_back(i);
+    }
+  }
+
+  size_t group_count = group_representatives.size();
+  vector<size_t> successor_group_ids;
+  for (;;) {
+    map<vector<size_t>, size_t> new_group_ids;
+    vector<size_t> next_group_ids(state_count);
+    group_representatives.clear();
+
+    for (ParseStateId i = 0; i < state_count; i++) {
+      successor_group_ids.assign({ group_ids[i] });
+      parse_table->states[i].each_referenced_state([&](ParseStateId *state_index) {
+        successor_group_ids.push_back(group_ids[*state_index]);
+      });
+
+      auto insertion = new_group_ids.insert({ successor_group_ids, new_group_ids.size() });
+      if (insertion.second)
+        group_representatives.push_back(i);
+      next_group_ids[i] = insertion.first->second;
+    }
+
+    group_ids.swap(next_group_ids);
+    if (new_group_ids.size() == group_count) break;
+    group_count = new_group_ids.size();
+  }
+
+  for (ParseStateId i = 0; i < state_count; i++) {
+    if (group_representatives[group_ids[i]] != i) {
+      deleted_states->insert(i);
+    } else {
+      parse_table->states[i].each_referenced_state([&](ParseStateId *state_index) {
+        *state_index = group_representatives[group_ids[*state_index]];
+      });
+    }
+  }
+}
+
+pair<ParseTable, CompileError> build_parse_table(
+  const SyntaxGrammar &grammar, const LexicalGrammar &lex_grammar,
+  unsigned thread_count) {
+  return build_parse_table(grammar, lex_grammar, thread_count, nullptr, nullptr);
+}
+
 pair<ParseTable, CompileError> build_parse_table(
-  const SyntaxGrammar &grammar, const LexicalGrammar &lex_grammar) {
-  return ParseTableBuilder(grammar, lex_grammar).build();
+  const SyntaxGrammar &grammar, const LexicalGrammar &lex_grammar,
+  unsigned thread_count, TSCompileStats *stats, TokenConflictCache *token_conflict_cache) {
+  return ParseTableBuilder(
+    grammar, lex_grammar, thread_count, stats, token_conflict_cache
+  ).build();
 }
 
 }  // namespace build_tables
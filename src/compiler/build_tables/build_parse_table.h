@@ -1,6 +1,7 @@
 #ifndef COMPILER_BUILD_TABLES_BUILD_PARSE_TABLE_H_
 #define COMPILER_BUILD_TABLES_BUILD_PARSE_TABLE_H_
 
+#include <set>
 #include <utility>
 #include <vector>
 #include "compiler/parse_table.h"
@@ -13,8 +14,32 @@ struct LexicalGrammar;
 
 namespace build_tables {
 
+class TokenConflictCache;
+
+// Builds the parse table using the given number of threads to compute the
+// closures of the item sets. The result does not depend on the thread count.
+std::pair<ParseTable, CompileError> build_parse_table(const SyntaxGrammar &,
+                                                      const LexicalGrammar &,
+                                                      unsigned thread_count);
+
+// Also records the time taken by each phase, and the number of item sets, in
+// the given stats, and reuses and records the results of the token conflict
+// checks in the given cache, if they are present.
 std::pair<ParseTable, CompileError> build_parse_table(const SyntaxGrammar &,
-                                                      const LexicalGrammar &);
+                                                      const LexicalGrammar &,
+                                                      unsigned thread_count,
+                                                      TSCompileStats *,
+                                                      TokenConflictCache *);
+
+// Merges the states whose actions are identical, once the states that those
+// actions refer to have been merged, and adds the states that were merged away
+// to the given set. This uses Moore's partition refinement algorithm: the
+// states are first grouped by their actions, ignoring the states that the
+// actions refer to. Groups are then split until all of the states in each
+// group refer to the same groups of states. Unlike merging pairs of identical
+// states until nothing changes, this also merges states that refer to each
+// other in cycles. Each group is replaced by its lowest-numbered state.
+void merge_equivalent_parse_states(ParseTable *, std::set<ParseStateId> *deleted_states);
 
 }  // namespace build_tables
 }  // namespace tree_sitter
@@ -1,10 +1,13 @@
 #include "compiler/build_tables/build_tables.h"
+#include <algorithm>
+#include <thread>
 #include <tuple>
 #include "compiler/build_tables/lex_table_builder.h"
 #include "compiler/build_tables/build_parse_table.h"
 #include "compiler/syntax_grammar.h"
 #include "compiler/lexical_grammar.h"
 #include "compiler/compile_error.h"
+#include "compiler/util/phase_timer.h"
 
 namespace tree_sitter {
 namespace build_tables {
@@ -13,15 +16,41 @@ using std::string;
 using std::tuple;
 using std::vector;
 using std::make_tuple;
+using std::max;
+using std::thread;
+using util::PhaseTimer;
 
 tuple<ParseTable, LexTable, CompileError> build_tables(
   const SyntaxGrammar &grammar,
   const LexicalGrammar &lexical_grammar
 ) {
-  auto parse_table_result = build_parse_table(grammar, lexical_grammar);
+  return build_tables(grammar, lexical_grammar, nullptr, nullptr);
+}
+
+tuple<ParseTable, LexTable, CompileError> build_tables(
+  const SyntaxGrammar &grammar,
+  const LexicalGrammar &lexical_grammar,
+  TSCompileStats *stats,
+  TokenConflictCache *token_conflict_cache
+) {
+  unsigned thread_count = max(1u, thread::hardware_concurrency());
+  auto parse_table_result = build_parse_table(
+    grammar, lexical_grammar, thread_count, stats, token_conflict_cache
+  );
   ParseTable parse_table = parse_table_result.first;
   const CompileError error = parse_table_result.second;
-  LexTable lex_table = LexTableBuilder::create(lexical_grammar)->build(&parse_table);
+
+  PhaseTimer timer(stats ? &stats->lex_table_micros : nullptr);
+  auto lex_table_builder = LexTableBuilder::create(lexical_grammar);
+  LexTable lex_table = lex_table_builder->build(&parse_table);
+  timer.stop();
+
+  if (stats) {
+    stats->lex_item_set_count = lex_table_builder->get_item_set_count();
+    stats->lex_state_count = lex_table.states.size();
+    stats->parse_state_count = parse_table.states.size();
+  }
+
   return make_tuple(parse_table, lex_table, error);
 }
 
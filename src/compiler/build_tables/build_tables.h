@@ -15,9 +15,15 @@ struct LexicalGrammar;
 
 namespace build_tables {
 
+class TokenConflictCache;
+
 std::tuple<ParseTable, LexTable, CompileError> build_tables(
   const SyntaxGrammar &, const LexicalGrammar &);
 
+std::tuple<ParseTable, LexTable, CompileError> build_tables(
+  const SyntaxGrammar &, const LexicalGrammar &, TSCompileStats *,
+  TokenConflictCache *);
+
 }  // namespace build_tables
 }  // namespace tree_sitter
 
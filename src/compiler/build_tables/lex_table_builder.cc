@@ -99,6 +99,10 @@ class LexTableBuilderImpl : public LexTableBuilder {
     return lex_table;
   }
 
+  size_t get_item_set_count() const {
+    return lex_state_ids.size();
+  }
+
   bool detect_conflict(Symbol::Index left, Symbol::Index right) {
     clear();
 
@@ -222,71 +226,68 @@ class LexTableBuilderImpl : public LexTableBuilder {
     }
   }
 
+  // Minimize the lex table using Moore's partition refinement algorithm. The
+  // states are first grouped by the token that they accept. The groups are
+  // then split until all of the states in each group advance to the same
+  // groups on the same characters. Precedence is not part of the generated
+  // code, so it is ignored when comparing states.
   void remove_duplicate_lex_states(ParseTable *parse_table) {
     for (LexState &state : lex_table.states) {
       state.accept_action.is_string = false;
       state.accept_action.precedence = 0;
     }
 
-    map<LexStateId, LexStateId> replacements;
-
-    while (true) {
-      map<LexStateId, LexStateId> duplicates;
-      for (LexStateId i = 0, size = lex_table.states.size(); i < size; i++) {
-        for (LexStateId j = 0; j < i; j++) {
-          if (!duplicates.count(j) && lex_table.states[j] == lex_table.states[i]) {
-            duplicates.insert({ i, j });
-            break;
-          }
-        }
-      }
-
-      if (duplicates.empty()) break;
-
-      map<size_t, size_t> new_replacements;
-      for (LexStateId i = 0, size = lex_table.states.size(); i < size; i++) {
-        LexStateId new_state_index = i;
-        auto duplicate = duplicates.find(i);
-        if (duplicate != duplicates.end()) {
-          new_state_index = duplicate->second;
-        }
-
-        size_t prior_removed = 0;
-        for (const auto &duplicate : duplicates) {
-          if (duplicate.first >= new_state_index) break;
-          prior_removed++;
-        }
+    size_t state_count = lex_table.states.size();
+    vector<size_t> group_ids(state_count);
+    map<Symbol, size_t> group_ids_by_accepted_symbol;
+    for (LexStateId i = 0; i < static_cast<LexStateId>(state_count); i++) {
+      Symbol symbol = lex_table.states[i].accept_action.symbol;
+      group_ids[i] = group_ids_by_accepted_symbol.insert({
+        symbol,
+        group_ids_by_accepted_symbol.size()
+      }).first->second;
+    }
 
-        new_state_index -= prior_removed;
-        new_replacements.insert({ i, new_state_index });
-        replacements.insert({ i, new_state_index });
-        for (auto &replacement : replacements) {
-          if (replacement.second == i) {
-            replacement.second = new_state_index;
-          }
+    typedef map<pair<size_t, bool>, CharacterSet> TransitionsByGroup;
+    size_t group_count = group_ids_by_accepted_symbol.size();
+    vector<LexStateId> group_representatives;
+    for (;;) {
+      map<pair<size_t, TransitionsByGroup>, size_t> new_group_ids;
+      vector<size_t> next_group_ids(state_count);
+      group_representatives.clear();
+
+      for (LexStateId i = 0; i < static_cast<LexStateId>(state_count); i++) {
+        TransitionsByGroup transitions;
+        for (const auto &entry : lex_table.states[i].advance_actions) {
+          const AdvanceAction &action = entry.second;
+          transitions[{ group_ids[action.state_index], action.in_main_token }].add_set(entry.first);
         }
-      }
 
-      for (auto &state : lex_table.states) {
-        for (auto &entry : state.advance_actions) {
-          auto new_replacement = new_replacements.find(entry.second.state_index);
-          if (new_replacement != new_replacements.end()) {
-            entry.second.state_index = new_replacement->second;
-          }
-        }
+        auto insertion = new_group_ids.insert({
+          { group_ids[i], transitions },
+          new_group_ids.size()
+        });
+        if (insertion.second)
+          group_representatives.push_back(i);
+        next_group_ids[i] = insertion.first->second;
       }
 
-      for (auto i = duplicates.rbegin(); i != duplicates.rend(); ++i) {
-        lex_table.states.erase(lex_table.states.begin() + i->first);
-      }
+      group_ids.swap(next_group_ids);
+      if (new_group_ids.size() == group_count) break;
+      group_count = new_group_ids.size();
     }
 
-    for (ParseState &parse_state : parse_table->states) {
-      auto replacement = replacements.find(parse_state.lex_state_id);
-      if (replacement != replacements.end()) {
-        parse_state.lex_state_id = replacement->second;
-      }
+    vector<LexState> states;
+    for (LexStateId representative : group_representatives) {
+      LexState state = lex_table.states[representative];
+      for (auto &entry : state.advance_actions)
+        entry.second.state_index = group_ids[entry.second.state_index];
+      states.push_back(state);
     }
+    lex_table.states.swap(states);
+
+    for (ParseState &parse_state : parse_table->states)
+      parse_state.lex_state_id = group_ids[parse_state.lex_state_id];
   }
 
   LexItemSet item_set_for_terminals(const map<Symbol, ParseTableEntry> &terminals) {
@@ -341,5 +342,9 @@ bool LexTableBuilder::detect_conflict(Symbol::Index left, Symbol::Index right) {
   return static_cast<LexTableBuilderImpl *>(this)->detect_conflict(left, right);
 }
 
+size_t LexTableBuilder::get_item_set_count() const {
+  return static_cast<const LexTableBuilderImpl *>(this)->get_item_set_count();
+}
+
 }  // namespace build_tables
 }  // namespace tree_sitter
@@ -16,6 +16,10 @@ class LexTableBuilder {
   static std::unique_ptr<LexTableBuilder> create(const LexicalGrammar &);
   LexTable build(ParseTable *);
   bool detect_conflict(rules::Symbol::Index, rules::Symbol::Index);
+
+  // The number of distinct lex item sets encountered by the last call to
+  // `build`, before duplicate lex states were merged.
+  size_t get_item_set_count() const;
  protected:
   LexTableBuilder() = default;
 };
@@ -1,46 +1,118 @@
 #include "compiler/build_tables/lookahead_set.h"
 #include <set>
-#include <memory>
+#include <vector>
 #include "compiler/rule.h"
+#include "compiler/util/hash_combine.h"
 
 namespace tree_sitter {
 namespace build_tables {
 
 using std::set;
-using std::make_shared;
+using std::vector;
 using rules::Symbol;
+using util::hash_combine;
 
-LookaheadSet::LookaheadSet() : entries(nullptr) {}
+static const size_t BITS_PER_WORD = 64;
 
-LookaheadSet::LookaheadSet(const set<Symbol> &symbols)
-    : entries(make_shared<set<Symbol>>(symbols)) {}
+static size_t bit_index_for_symbol(const Symbol &symbol) {
+  return symbol.is_external() ? symbol.index : symbol.index + 1;
+}
+
+static bool words_are_empty(const vector<uint64_t> &words) {
+  for (uint64_t word : words)
+    if (word)
+      return false;
+  return true;
+}
+
+static bool words_are_equal(const vector<uint64_t> &left, const vector<uint64_t> &right) {
+  const vector<uint64_t> &shorter = left.size() < right.size() ? left : right;
+  const vector<uint64_t> &longer = left.size() < right.size() ? right : left;
+  for (size_t i = 0, n = shorter.size(); i < n; i++)
+    if (shorter[i] != longer[i])
+      return false;
+  for (size_t i = shorter.size(), n = longer.size(); i < n; i++)
+    if (longer[i])
+      return false;
+  return true;
+}
+
+static bool insert_words(vector<uint64_t> *words, const vector<uint64_t> &other) {
+  if (words->size() < other.size())
+    words->resize(other.size(), 0);
+
+  uint64_t added_bits = 0;
+  for (size_t i = 0, n = other.size(); i < n; i++) {
+    added_bits |= other[i] & ~(*words)[i];
+    (*words)[i] |= other[i];
+  }
+  return added_bits != 0;
+}
+
+static void hash_words(size_t *result, const vector<uint64_t> &words) {
+  size_t size = words.size();
+  while (size > 0 && !words[size - 1])
+    size--;
+  hash_combine(result, size);
+  for (size_t i = 0; i < size; i++)
+    hash_combine(result, words[i]);
+}
+
+LookaheadSet::LookaheadSet() : cached_hash(0), has_cached_hash(false) {}
+
+LookaheadSet::LookaheadSet(const set<Symbol> &symbols) : LookaheadSet() {
+  for (const Symbol &symbol : symbols)
+    insert(symbol);
+}
 
 bool LookaheadSet::empty() const {
-  return !entries.get() || entries->empty();
+  return words_are_empty(external_bits) && words_are_empty(terminal_bits);
 }
 
 bool LookaheadSet::operator==(const LookaheadSet &other) const {
-  return *entries == *other.entries;
+  return
+    words_are_equal(external_bits, other.external_bits) &&
+    words_are_equal(terminal_bits, other.terminal_bits);
 }
 
 bool LookaheadSet::contains(const Symbol &symbol) const {
-  return entries->find(symbol) != entries->end();
+  const vector<uint64_t> &words = symbol.is_external() ? external_bits : terminal_bits;
+  size_t bit_index = bit_index_for_symbol(symbol);
+  size_t word_index = bit_index / BITS_PER_WORD;
+  return word_index < words.size() &&
+    (words[word_index] & (1ull << (bit_index % BITS_PER_WORD)));
 }
 
 bool LookaheadSet::insert_all(const LookaheadSet &other) {
-  if (!other.entries.get())
-    return false;
-  if (!entries.get())
-    entries = make_shared<set<Symbol>>();
-  size_t previous_size = entries->size();
-  entries->insert(other.entries->begin(), other.entries->end());
-  return entries->size() > previous_size;
+  bool result = false;
+  if (insert_words(&external_bits, other.external_bits)) result = true;
+  if (insert_words(&terminal_bits, other.terminal_bits)) result = true;
+  if (result) has_cached_hash = false;
+  return result;
 }
 
 bool LookaheadSet::insert(const Symbol &symbol) {
-  if (!entries.get())
-    entries = make_shared<set<Symbol>>();
-  return entries->insert(symbol).second;
+  vector<uint64_t> &words = symbol.is_external() ? external_bits : terminal_bits;
+  size_t bit_index = bit_index_for_symbol(symbol);
+  size_t word_index = bit_index / BITS_PER_WORD;
+  uint64_t mask = 1ull << (bit_index % BITS_PER_WORD);
+  if (word_index >= words.size())
+    words.resize(word_index + 1, 0);
+  if (words[word_index] & mask)
+    return false;
+  words[word_index] |= mask;
+  has_cached_hash = false;
+  return true;
+}
+
+size_t LookaheadSet::hash() const {
+  if (!has_cached_hash) {
+    cached_hash = 0;
+    hash_words(&cached_hash, external_bits);
+    hash_words(&cached_hash, terminal_bits);
+    has_cached_hash = true;
+  }
+  return cached_hash;
 }
 
 }  // namespace build_tables
@@ -2,12 +2,16 @@
 #define COMPILER_BUILD_TABLES_LOOKAHEAD_SET_H_
 
 #include <set>
-#include <memory>
+#include <vector>
+#include <cstdint>
 #include "compiler/rule.h"
 
 namespace tree_sitter {
 namespace build_tables {
 
+// A set of terminal and external symbols, stored as two dense bitsets. Bit `i`
+// of `terminal_bits` represents the terminal with index `i - 1`, so that the
+// built-in end-of-input symbol can be stored alongside the grammar's terminals.
 class LookaheadSet {
  public:
   LookaheadSet();
@@ -18,8 +22,30 @@ class LookaheadSet {
   bool contains(const rules::Symbol &) const;
   bool insert_all(const LookaheadSet &);
   bool insert(const rules::Symbol &);
+  size_t hash() const;
 
-  std::shared_ptr<std::set<rules::Symbol>> entries;
+  template <typename Callback>
+  void for_each(const Callback &callback) const {
+    for (size_t i = 0, n = external_bits.size(); i < n; i++) {
+      uint64_t word = external_bits[i];
+      for (auto j = static_cast<rules::Symbol::Index>(i * 64); word; j++, word >>= 1)
+        if (word & 1)
+          callback(rules::Symbol::external(j));
+    }
+
+    for (size_t i = 0, n = terminal_bits.size(); i < n; i++) {
+      uint64_t word = terminal_bits[i];
+      for (auto j = static_cast<rules::Symbol::Index>(i * 64) - 1; word; j++, word >>= 1)
+        if (word & 1)
+          callback(rules::Symbol::terminal(j));
+    }
+  }
+
+ private:
+  std::vector<uint64_t> external_bits;
+  std::vector<uint64_t> terminal_bits;
+  mutable size_t cached_hash;
+  mutable bool has_cached_hash;
 };
 
 }  // namespace build_tables
@@ -20,7 +20,8 @@ using rules::Symbol;
 using rules::NONE;
 
 ParseItemSetBuilder::ParseItemSetBuilder(const SyntaxGrammar &grammar,
-                                         const LexicalGrammar &lexical_grammar) {
+                                         const LexicalGrammar &lexical_grammar)
+    : closure_expansion_count(0) {
   vector<Symbol> symbols_to_process;
   set<Symbol::Index> processed_non_terminals;
 
@@ -125,8 +126,11 @@ ParseItemSetBuilder::ParseItemSetBuilder(const SyntaxGrammar &grammar,
   }
 }
 
-void ParseItemSetBuilder::apply_transitive_closure(ParseItemSet *item_set) {
-  item_set_buffer.clear();
+// This method does not modify the builder, so it can be called for several
+// item sets concurrently.
+void ParseItemSetBuilder::apply_transitive_closure(ParseItemSet *item_set) const {
+  vector<pair<ParseItem, LookaheadSet>> item_set_buffer;
+  size_t expansion_count = 0;
 
   for (const auto &pair : item_set->entries) {
     const ParseItem &item = pair.first;
@@ -143,7 +147,8 @@ void ParseItemSetBuilder::apply_transitive_closure(ParseItemSet *item_set) {
         next_lookaheads = first_sets.find(symbol_after_next)->second;
       }
 
-      for (const ParseItemSetComponent &component : component_cache[next_symbol.index]) {
+      expansion_count++;
+      for (const ParseItemSetComponent &component : component_cache.find(next_symbol.index)->second) {
         item_set_buffer.push_back({component.item, component.lookaheads});
         if (component.propagates_lookaheads) {
           item_set_buffer.push_back({component.item, next_lookaheads});
@@ -155,11 +160,17 @@ void ParseItemSetBuilder::apply_transitive_closure(ParseItemSet *item_set) {
   for (const auto &buffer_entry : item_set_buffer) {
     item_set->entries[buffer_entry.first].insert_all(buffer_entry.second);
   }
+
+  closure_expansion_count += expansion_count;
 }
 
 LookaheadSet ParseItemSetBuilder::get_first_set(const rules::Symbol &symbol) const {
   return first_sets.find(symbol)->second;
 }
 
+size_t ParseItemSetBuilder::get_closure_expansion_count() const {
+  return closure_expansion_count;
+}
+
 }  // namespace build_tables
 }  // namespace tree_sitter
@@ -3,6 +3,7 @@
 
 #include "compiler/build_tables/parse_item.h"
 #include "compiler/rule.h"
+#include <atomic>
 #include <map>
 
 namespace tree_sitter {
@@ -21,12 +22,17 @@ class ParseItemSetBuilder {
 
   std::map<rules::Symbol, LookaheadSet> first_sets;
   std::map<rules::Symbol::Index, std::vector<ParseItemSetComponent>> component_cache;
-  std::vector<std::pair<ParseItem, LookaheadSet>> item_set_buffer;
+  mutable std::atomic<size_t> closure_expansion_count;
 
  public:
   ParseItemSetBuilder(const SyntaxGrammar &, const LexicalGrammar &);
-  void apply_transitive_closure(ParseItemSet *);
+  void apply_transitive_closure(ParseItemSet *) const;
   LookaheadSet get_first_set(const rules::Symbol &) const;
+
+  // The number of times that a non-terminal has been expanded while closing
+  // item sets. Every expansion uses the components precomputed for that
+  // non-terminal, so this counts work done, not cache reuse.
+  size_t get_closure_expansion_count() const;
 };
 
 }  // namespace build_tables
@@ -0,0 +1,248 @@
+#include "compiler/build_tables/token_conflict_cache.h"
+#include "compiler/lexical_grammar.h"
+
+namespace tree_sitter {
+namespace build_tables {
+
+using std::get;
+using std::make_tuple;
+using std::string;
+using std::unordered_map;
+using std::vector;
+using rules::Rule;
+using rules::Symbol;
+
+// When the cache holds this many results, new results are no longer added.
+static const size_t MAX_RESULT_COUNT = 1 << 22;
+
+// Serialized caches from other versions of the format are ignored. This must
+// change whenever the way that conflicts are detected changes, because the
+// saved results would no longer be valid.
+static const uint32_t SERIALIZATION_VERSION = 1;
+
+static void write_uint32(string *buffer, uint32_t value) {
+  for (unsigned i = 0; i < 4; i++) {
+    buffer->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+static void write_string(string *buffer, const string &value) {
+  write_uint32(buffer, value.size());
+  buffer->append(value);
+}
+
+static void write_character_ranges(string *buffer,
+                                   const vector<rules::CharacterRange> &ranges) {
+  write_uint32(buffer, ranges.size());
+  for (const rules::CharacterRange &range : ranges) {
+    write_uint32(buffer, range.min);
+    write_uint32(buffer, range.max);
+  }
+}
+
+// Rules are keyed by a serialization of their content, which, unlike their
+// hashes, is the same in every process.
+static void write_rule(string *buffer, const Rule &rule) {
+  buffer->push_back(static_cast<char>(rule.type));
+  rule.match(
+    [](const rules::Blank &) {},
+
+    [&](const rules::CharacterSet &character_set) {
+      buffer->push_back(character_set.includes_all);
+      write_character_ranges(buffer, character_set.included_chars);
+      write_character_ranges(buffer, character_set.excluded_chars);
+    },
+
+    [&](const rules::String &value) {
+      write_string(buffer, value.value);
+    },
+
+    [&](const rules::Pattern &pattern) {
+      write_string(buffer, pattern.value);
+    },
+
+    [&](const rules::NamedSymbol &symbol) {
+      write_string(buffer, symbol.value);
+    },
+
+    [&](const rules::Symbol &symbol) {
+      write_uint32(buffer, symbol.index);
+      write_uint32(buffer, symbol.type);
+    },
+
+    [&](const rules::Choice &choice) {
+      write_uint32(buffer, choice.elements.size());
+      for (const Rule &element : choice.elements) {
+        write_rule(buffer, element);
+      }
+    },
+
+    [&](const rules::Metadata &metadata) {
+      const rules::MetadataParams &params = metadata.params;
+      write_uint32(buffer, params.precedence);
+      write_uint32(buffer, params.associativity);
+      buffer->push_back(params.has_precedence);
+      buffer->push_back(params.has_associativity);
+      buffer->push_back(params.is_token);
+      buffer->push_back(params.is_string);
+      buffer->push_back(params.is_active);
+      buffer->push_back(params.is_main_token);
+      write_rule(buffer, *metadata.rule);
+    },
+
+    [&](const rules::Repeat &repeat) {
+      write_rule(buffer, *repeat.rule);
+    },
+
+    [&](const rules::Seq &seq) {
+      write_rule(buffer, *seq.left);
+      write_rule(buffer, *seq.right);
+    }
+  );
+}
+
+static unsigned intern_key(unordered_map<string, unsigned> *ids, const string &key) {
+  return ids->emplace(key, ids->size()).first->second;
+}
+
+class Reader {
+  const string &data;
+  size_t position;
+
+ public:
+  explicit Reader(const string &data) : data(data), position(0) {}
+
+  bool read_uint32(uint32_t *value) {
+    if (data.size() - position < 4) return false;
+    *value = 0;
+    for (unsigned i = 0; i < 4; i++) {
+      *value |= static_cast<uint32_t>(static_cast<unsigned char>(data[position++])) << (8 * i);
+    }
+    return true;
+  }
+
+  bool read_bool(bool *value) {
+    if (position == data.size() || static_cast<unsigned char>(data[position]) > 1) return false;
+    *value = data[position++];
+    return true;
+  }
+
+  bool read_string(string *value) {
+    uint32_t size;
+    if (!read_uint32(&size) || data.size() - position < size) return false;
+    value->assign(data, position, size);
+    position += size;
+    return true;
+  }
+
+  bool read_keys(unordered_map<string, unsigned> *ids) {
+    uint32_t count;
+    if (!read_uint32(&count)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+      string key;
+      if (!read_string(&key) || intern_key(ids, key) != i) return false;
+    }
+    return true;
+  }
+
+  bool is_done() const {
+    return position == data.size();
+  }
+};
+
+TokenConflictCache::GrammarIds TokenConflictCache::intern(const LexicalGrammar &grammar) {
+  GrammarIds result;
+
+  string separators_key;
+  write_uint32(&separators_key, grammar.separators.size());
+  for (const Rule &separator : grammar.separators) {
+    write_rule(&separators_key, separator);
+  }
+  result.separators = intern_key(&separator_ids, separators_key);
+
+  for (const LexicalVariable &variable : grammar.variables) {
+    string token_key(1, variable.is_string);
+    write_rule(&token_key, variable.rule);
+    result.tokens.push_back(intern_key(&token_ids, token_key));
+  }
+
+  return result;
+}
+
+bool TokenConflictCache::find(const GrammarIds &ids, Symbol::Index left,
+                              Symbol::Index right, bool *conflict) const {
+  auto entry = results.find(make_tuple(
+    ids.separators, ids.tokens[left], ids.tokens[right], left < right
+  ));
+  if (entry == results.end()) return false;
+  *conflict = entry->second;
+  return true;
+}
+
+void TokenConflictCache::insert(const GrammarIds &ids, Symbol::Index left,
+                                Symbol::Index right, bool conflict) {
+  if (results.size() >= MAX_RESULT_COUNT) return;
+  results[make_tuple(ids.separators, ids.tokens[left], ids.tokens[right], left < right)] = conflict;
+}
+
+string TokenConflictCache::serialize() const {
+  string result;
+  write_uint32(&result, SERIALIZATION_VERSION);
+
+  for (const unordered_map<string, unsigned> *ids : {&separator_ids, &token_ids}) {
+    vector<const string *> keys(ids->size());
+    for (const auto &entry : *ids) {
+      keys[entry.second] = &entry.first;
+    }
+    write_uint32(&result, keys.size());
+    for (const string *key : keys) {
+      write_string(&result, *key);
+    }
+  }
+
+  write_uint32(&result, results.size());
+  for (const auto &entry : results) {
+    write_uint32(&result, get<0>(entry.first));
+    write_uint32(&result, get<1>(entry.first));
+    write_uint32(&result, get<2>(entry.first));
+    result.push_back(get<3>(entry.first));
+    result.push_back(entry.second);
+  }
+
+  return result;
+}
+
+// Replaces the contents of the cache with the given serialized cache. If the
+// data is malformed or comes from another version of the format, the cache is
+// left unchanged.
+bool TokenConflictCache::deserialize(const string &data) {
+  Reader reader(data);
+  uint32_t version, result_count;
+  unordered_map<string, unsigned> new_separator_ids, new_token_ids;
+  std::map<PairKey, bool> new_results;
+
+  if (!reader.read_uint32(&version) || version != SERIALIZATION_VERSION) return false;
+  if (!reader.read_keys(&new_separator_ids)) return false;
+  if (!reader.read_keys(&new_token_ids)) return false;
+  if (!reader.read_uint32(&result_count)) return false;
+
+  for (uint32_t i = 0; i < result_count; i++) {
+    uint32_t separators, left, right;
+    bool is_ordered, conflict;
+    if (!reader.read_uint32(&separators) || separators >= new_separator_ids.size()) return false;
+    if (!reader.read_uint32(&left) || left >= new_token_ids.size()) return false;
+    if (!reader.read_uint32(&right) || right >= new_token_ids.size()) return false;
+    if (!reader.read_bool(&is_ordered) || !reader.read_bool(&conflict)) return false;
+    new_results[make_tuple(separators, left, right, is_ordered)] = conflict;
+  }
+
+  if (!reader.is_done()) return false;
+
+  separator_ids.swap(new_separator_ids);
+  token_ids.swap(new_token_ids);
+  results.swap(new_results);
+  return true;
+}
+
+}  // namespace build_tables
+}  // namespace tree_sitter
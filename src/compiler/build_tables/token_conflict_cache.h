@@ -0,0 +1,49 @@
+#ifndef COMPILER_BUILD_TABLES_TOKEN_CONFLICT_CACHE_H_
+#define COMPILER_BUILD_TABLES_TOKEN_CONFLICT_CACHE_H_
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "compiler/rule.h"
+
+namespace tree_sitter {
+
+struct LexicalGrammar;
+
+namespace build_tables {
+
+// Whether one token can prevent another from being recognized depends only
+// on the two tokens' rules, their order in the grammar and the grammar's
+// separators. This cache keeps those results keyed by a serialization of
+// that content rather than by symbol index, so that recompiling an edited
+// grammar only checks the pairs involving tokens that changed. The cache can
+// itself be serialized, so that its results outlive the process.
+class TokenConflictCache {
+ public:
+  // Ids for a grammar's separators and for each of its tokens.
+  struct GrammarIds {
+    unsigned separators;
+    std::vector<unsigned> tokens;
+  };
+
+  GrammarIds intern(const LexicalGrammar &);
+  bool find(const GrammarIds &, rules::Symbol::Index, rules::Symbol::Index, bool *) const;
+  void insert(const GrammarIds &, rules::Symbol::Index, rules::Symbol::Index, bool);
+
+  std::string serialize() const;
+  bool deserialize(const std::string &);
+
+ private:
+  typedef std::tuple<unsigned, unsigned, unsigned, bool> PairKey;
+
+  std::unordered_map<std::string, unsigned> separator_ids;
+  std::unordered_map<std::string, unsigned> token_ids;
+  std::map<PairKey, bool> results;
+};
+
+}  // namespace build_tables
+}  // namespace tree_sitter
+
+#endif  // COMPILER_BUILD_TABLES_TOKEN_CONFLICT_CACHE_H_
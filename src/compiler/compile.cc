@@ -1,28 +1,91 @@
 #include "tree_sitter/compiler.h"
+#include <string.h>
+#include <memory>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 #include "compiler/prepare_grammar/prepare_grammar.h"
 #include "compiler/build_tables/build_tables.h"
+#include "compiler/build_tables/token_conflict_cache.h"
+#include "compiler/generate_code/binary.h"
 #include "compiler/generate_code/c_code.h"
 #include "compiler/syntax_grammar.h"
 #include "compiler/lexical_grammar.h"
 #include "compiler/parse_grammar.h"
+#include "compiler/util/phase_timer.h"
 #include "json.h"
 
 namespace tree_sitter {
 
+struct PreparedGrammar {
+  InputGrammar input_grammar;
+  SyntaxGrammar syntax_grammar;
+  LexicalGrammar lexical_grammar;
+};
+
+}  // namespace tree_sitter
+
+struct TSCompileCache {
+  tree_sitter::build_tables::TokenConflictCache token_conflicts;
+  std::unique_ptr<tree_sitter::PreparedGrammar> prepared_grammar;
+};
+
+namespace tree_sitter {
+
 using std::pair;
 using std::string;
+using std::tuple;
 using std::vector;
 using std::get;
 using std::make_tuple;
+using util::PhaseTimer;
 
-extern "C" TSCompileResult ts_compile_grammar(const char *input) {
+static size_t peak_memory_bytes() {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// The first sets and closures that the table builder computes are indexed by
+// symbol, and the symbols are renumbered whenever a rule is added or removed,
+// so only the prepared grammar is reused, and only when the rules are equal.
+static tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar_with_cache(
+  const InputGrammar &grammar, TSCompileCache *cache, TSCompileStats *stats) {
+  if (cache && cache->prepared_grammar && cache->prepared_grammar->input_grammar == grammar) {
+    if (stats) stats->prepared_grammar_cache_hit_count++;
+    return make_tuple(cache->prepared_grammar->syntax_grammar,
+                      cache->prepared_grammar->lexical_grammar, CompileError::none());
+  }
+
+  auto result = prepare_grammar::prepare_grammar(grammar, stats);
+  if (cache && !get<2>(result).type) {
+    cache->prepared_grammar.reset(new PreparedGrammar{
+      grammar, get<0>(result), get<1>(result)
+    });
+  }
+  return result;
+}
+
+static TSCompileResult compile_grammar(const char *input, TSCompileCache *cache,
+                                       TSCompileStats *stats) {
+  PhaseTimer parse_timer(stats ? &stats->parse_grammar_micros : nullptr);
   ParseGrammarResult parse_result = parse_grammar(string(input));
+  parse_timer.stop();
   if (!parse_result.error_message.empty()) {
     return { nullptr, strdup(parse_result.error_message.c_str()),
              TSCompileErrorTypeInvalidGrammar };
   }
 
-  auto prepare_grammar_result = prepare_grammar::prepare_grammar(parse_result.grammar);
+  auto prepare_grammar_result =
+    prepare_grammar_with_cache(parse_result.grammar, cache, stats);
   const SyntaxGrammar &syntax_grammar = get<0>(prepare_grammar_result);
   const LexicalGrammar &lexical_grammar = get<1>(prepare_grammar_result);
   CompileError error = get<2>(prepare_grammar_result);
@@ -31,7 +94,8 @@ extern "C" TSCompileResult ts_compile_grammar(const char *input) {
   }
 
   auto table_build_result =
-    build_tables::build_tables(syntax_grammar, lexical_grammar);
+    build_tables::build_tables(syntax_grammar, lexical_grammar, stats,
+                               cache ? &cache->token_conflicts : nullptr);
   const ParseTable &parse_table = get<0>(table_build_result);
   const LexTable &lex_table = get<1>(table_build_result);
   error = get<2>(table_build_result);
@@ -39,12 +103,98 @@ extern "C" TSCompileResult ts_compile_grammar(const char *input) {
     return { nullptr, strdup(error.message.c_str()), error.type };
   }
 
+  PhaseTimer code_generation_timer(stats ? &stats->code_generation_micros : nullptr);
   string code = generate_code::c_code(parse_result.name, parse_table, lex_table,
                                       syntax_grammar, lexical_grammar);
+  code_generation_timer.stop();
 
   return { strdup(code.c_str()), nullptr, TSCompileErrorTypeNone };
 }
 
+extern "C" TSCompileCache *ts_compile_cache_new() {
+  return new TSCompileCache();
+}
+
+extern "C" TSCompileCache *ts_compile_cache_load(const char *data, size_t length) {
+  TSCompileCache *result = new TSCompileCache();
+  if (!result->token_conflicts.deserialize(string(data, length))) {
+    delete result;
+    return nullptr;
+  }
+  return result;
+}
+
+extern "C" char *ts_compile_cache_serialize(const TSCompileCache *self, size_t *length) {
+  string data = self->token_conflicts.serialize();
+  char *result = static_cast<char *>(malloc(data.size()));
+  memcpy(result, data.data(), data.size());
+  *length = data.size();
+  return result;
+}
+
+extern "C" void ts_compile_cache_free(TSCompileCache *self) {
+  delete self;
+}
+
+extern "C" TSCompileResult ts_compile_grammar(const char *input) {
+  return compile_grammar(input, nullptr, nullptr);
+}
+
+extern "C" TSCompileResult ts_compile_grammar_with_stats(const char *input,
+                                                         TSCompileStats *stats) {
+  return ts_compile_grammar_with_cache(input, nullptr, stats);
+}
+
+extern "C" TSCompileResult ts_compile_grammar_with_cache(const char *input,
+                                                         TSCompileCache *cache,
+                                                         TSCompileStats *stats) {
+  if (!stats) return compile_grammar(input, cache, nullptr);
+  memset(stats, 0, sizeof(TSCompileStats));
+  PhaseTimer timer(&stats->total_micros);
+  TSCompileResult result = compile_grammar(input, cache, stats);
+  timer.stop();
+  stats->peak_memory_bytes = peak_memory_bytes();
+  return result;
+}
+
+extern "C" TSBinaryCompileResult ts_compile_grammar_binary(const char *input) {
+  ParseGrammarResult parse_result = parse_grammar(string(input));
+  if (!parse_result.error_message.empty()) {
+    return { nullptr, 0, strdup(parse_result.error_message.c_str()),
+             TSCompileErrorTypeInvalidGrammar };
+  }
+
+  auto prepare_grammar_result = prepare_grammar::prepare_grammar(parse_result.grammar);
+  const SyntaxGrammar &syntax_grammar = get<0>(prepare_grammar_result);
+  const LexicalGrammar &lexical_grammar = get<1>(prepare_grammar_result);
+  CompileError error = get<2>(prepare_grammar_result);
+  if (error.type) {
+    return { nullptr, 0, strdup(error.message.c_str()), error.type };
+  }
+
+  if (!syntax_grammar.external_tokens.empty()) {
+    return { nullptr, 0,
+             strdup("Grammars with external tokens can't be compiled to binary"),
+             TSCompileErrorTypeInvalidExternalToken };
+  }
+
+  auto table_build_result =
+    build_tables::build_tables(syntax_grammar, lexical_grammar);
+  const ParseTable &parse_table = get<0>(table_build_result);
+  const LexTable &lex_table = get<1>(table_build_result);
+  error = get<2>(table_build_result);
+  if (error.type) {
+    return { nullptr, 0, strdup(error.message.c_str()), error.type };
+  }
+
+  string data = generate_code::binary(parse_table, lex_table,
+                                      syntax_grammar, lexical_grammar);
+
+  char *result = static_cast<char *>(malloc(data.size()));
+  memcpy(result, data.data(), data.size());
+  return { result, data.size(), nullptr, TSCompileErrorTypeNone };
+}
+
 pair<string, const CompileError> compile(const InputGrammar &grammar,
                                          std::string name) {
   auto prepare_grammar_result = prepare_grammar::prepare_grammar(grammar);
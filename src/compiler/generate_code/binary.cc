@@ -0,0 +1,360 @@
+#include "compiler/generate_code/binary.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "compiler/generate_code/parse_table_layout.h"
+#include "compiler/lex_table.h"
+#include "compiler/parse_table.h"
+#include "compiler/syntax_grammar.h"
+#include "compiler/lexical_grammar.h"
+#include "compiler/rule.h"
+#include "tree_sitter/runtime.h"
+
+namespace tree_sitter {
+namespace generate_code {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+using rules::Symbol;
+
+// These values must match the ones in `src/runtime/binary_language.c`, which
+// also describes the layout of the file.
+static const uint32_t BINARY_LANGUAGE_MAGIC = 0x424c5354;
+static const uint16_t NO_SYMBOL = 0xffff;
+
+enum {
+  SymbolVisible = 1,
+  SymbolNamed = 2,
+  SymbolExtra = 4,
+  SymbolStructural = 8,
+};
+
+enum {
+  ActionTypeShift,
+  ActionTypeReduce,
+  ActionTypeAccept,
+  ActionTypeRecover,
+};
+
+enum {
+  ActionExtra = 1,
+  ActionFragile = 2,
+};
+
+enum {
+  ActionEntryReusable = 1,
+  ActionEntryDependsOnLookahead = 2,
+};
+
+enum {
+  TransitionSkip = 1,
+  TransitionInverted = 2,
+};
+
+class Section {
+ public:
+  string bytes;
+
+  void push_uint8(uint8_t value) {
+    bytes.push_back(static_cast<char>(value));
+  }
+
+  void push_uint16(uint16_t value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  void push_uint32(uint32_t value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  // Every section starts at a four-byte boundary, so that the runtime can
+  // use the tables in place.
+  void pad() {
+    while (bytes.size() % 4 != 0) bytes.push_back(0);
+  }
+};
+
+class BinaryGenerator {
+  ParseTable parse_table;
+  const LexTable lex_table;
+  const SyntaxGrammar syntax_grammar;
+  const LexicalGrammar lexical_grammar;
+  size_t large_state_count;
+  map<Symbol, uint16_t> symbol_ids;
+  vector<pair<size_t, ParseTableEntry>> parse_table_entries;
+  size_t next_parse_action_list_index;
+
+ public:
+  BinaryGenerator(const ParseTable &parse_table, const LexTable &lex_table,
+                  const SyntaxGrammar &syntax_grammar,
+                  const LexicalGrammar &lexical_grammar)
+      : parse_table(parse_table),
+        lex_table(lex_table),
+        syntax_grammar(syntax_grammar),
+        lexical_grammar(lexical_grammar),
+        large_state_count(move_large_states_first(&this->parse_table)),
+        next_parse_action_list_index(0) {
+    uint16_t i = 1;
+    for (const auto &entry : this->parse_table.symbols) {
+      if (entry.first == rules::END_OF_INPUT()) {
+        symbol_ids[entry.first] = 0;
+      } else {
+        symbol_ids[entry.first] = i++;
+      }
+    }
+  }
+
+  string code() {
+    Section symbol_metadata, symbol_names;
+    for (const auto &entry : parse_table.symbols) {
+      uint8_t flags = 0;
+      switch (symbol_type(entry.first)) {
+        case VariableTypeNamed:
+          flags |= SymbolVisible | SymbolNamed;
+          break;
+        case VariableTypeAnonymous:
+          flags |= SymbolVisible;
+          break;
+        case VariableTypeHidden:
+          flags |= SymbolNamed;
+          break;
+        case VariableTypeAuxiliary:
+          break;
+      }
+      if (entry.second.extra) flags |= SymbolExtra;
+      if (entry.second.structural) flags |= SymbolStructural;
+      symbol_metadata.push_uint8(flags);
+
+      symbol_names.bytes += symbol_name(entry.first);
+      symbol_names.push_uint8(0);
+    }
+    size_t symbol_names_size = symbol_names.bytes.size();
+    symbol_metadata.pad();
+    symbol_names.pad();
+
+    add_parse_action_list_id(ParseTableEntry{ {}, false, false });
+
+    Section large_parse_table;
+    for (size_t i = 0; i < large_state_count; i++) {
+      const ParseState &state = parse_table.states[i];
+      vector<uint16_t> row(parse_table.symbols.size(), 0);
+      for (const auto &entry : state.nonterminal_entries) {
+        row[symbol_ids[Symbol::non_terminal(entry.first)]] = entry.second;
+      }
+      for (const auto &entry : state.terminal_entries) {
+        row[symbol_ids[entry.first]] = add_parse_action_list_id(entry.second);
+      }
+      for (uint16_t value : row) large_parse_table.push_uint16(value);
+    }
+
+    Section small_parse_table, small_parse_table_map;
+    for (size_t i = large_state_count; i < parse_table.states.size(); i++) {
+      const ParseState &state = parse_table.states[i];
+      map<size_t, vector<Symbol>> nonterminal_groups, terminal_groups;
+      for (const auto &entry : state.nonterminal_entries) {
+        nonterminal_groups[entry.second].push_back(Symbol::non_terminal(entry.first));
+      }
+      for (const auto &entry : state.terminal_entries) {
+        terminal_groups[add_parse_action_list_id(entry.second)].push_back(entry.first);
+      }
+
+      small_parse_table_map.push_uint32(small_parse_table.bytes.size() / 2);
+      small_parse_table.push_uint16(nonterminal_groups.size() + terminal_groups.size());
+      for (const auto *groups : { &nonterminal_groups, &terminal_groups }) {
+        for (const auto &group : *groups) {
+          small_parse_table.push_uint16(group.first);
+          small_parse_table.push_uint16(group.second.size());
+          for (const Symbol &symbol : group.second) {
+            small_parse_table.push_uint16(symbol_ids[symbol]);
+          }
+        }
+      }
+    }
+    size_t small_parse_table_size = small_parse_table.bytes.size() / 2;
+    large_parse_table.pad();
+    small_parse_table.pad();
+
+    Section parse_actions;
+    for (const auto &pair : parse_table_entries) {
+      const ParseTableEntry &entry = pair.second;
+      uint16_t flags = 0;
+      if (entry.reusable) flags |= ActionEntryReusable;
+      if (entry.depends_on_lookahead) flags |= ActionEntryDependsOnLookahead;
+      parse_actions.push_uint16(entry.actions.size());
+      parse_actions.push_uint16(flags);
+      parse_actions.push_uint16(0);
+      parse_actions.push_uint16(0);
+
+      for (const ParseAction &action : entry.actions) {
+        add_parse_action(&parse_actions, action);
+      }
+    }
+
+    Section lex_modes;
+    for (const ParseState &state : parse_table.states) {
+      lex_modes.push_uint16(state.lex_state_id);
+    }
+    lex_modes.pad();
+
+    Section lex_states, lex_transitions, lex_ranges;
+    size_t transition_count = 0, range_count = 0;
+    for (const LexState &state : lex_table.states) {
+      uint16_t state_transition_count = 0;
+      for (const auto &pair : state.advance_actions) {
+        if (!pair.first.is_empty()) state_transition_count++;
+      }
+
+      lex_states.push_uint16(state.accept_action.is_present()
+        ? symbol_ids[state.accept_action.symbol]
+        : NO_SYMBOL);
+      lex_states.push_uint16(state_transition_count);
+      lex_states.push_uint32(transition_count);
+
+      for (const auto &pair : state.advance_actions) {
+        const rules::CharacterSet &characters = pair.first;
+        if (characters.is_empty()) continue;
+
+        const vector<rules::CharacterRange> &ranges = characters.includes_all
+          ? characters.excluded_chars
+          : characters.included_chars;
+        uint32_t flags = 0;
+        if (!pair.second.in_main_token) flags |= TransitionSkip;
+        if (characters.includes_all) flags |= TransitionInverted;
+
+        lex_transitions.push_uint32(range_count);
+        lex_transitions.push_uint16(ranges.size());
+        lex_transitions.push_uint16(pair.second.state_index);
+        lex_transitions.push_uint32(flags);
+        transition_count++;
+
+        for (const rules::CharacterRange &range : ranges) {
+          lex_ranges.push_uint32(range.min);
+          lex_ranges.push_uint32(range.max);
+          range_count++;
+        }
+      }
+    }
+
+    Section header;
+    header.push_uint32(BINARY_LANGUAGE_MAGIC);
+    header.push_uint32(TREE_SITTER_LANGUAGE_VERSION);
+    header.push_uint32(parse_table.symbols.size());
+    header.push_uint32(token_count());
+    header.push_uint32(parse_table.states.size());
+    header.push_uint32(large_state_count);
+    header.push_uint32(small_parse_table_size);
+    header.push_uint32(next_parse_action_list_index);
+    header.push_uint32(lex_table.states.size());
+    header.push_uint32(transition_count);
+    header.push_uint32(range_count);
+    header.push_uint32(symbol_names_size);
+
+    return
+      header.bytes +
+      symbol_metadata.bytes +
+      symbol_names.bytes +
+      large_parse_table.bytes +
+      small_parse_table.bytes +
+      small_parse_table_map.bytes +
+      parse_actions.bytes +
+      lex_modes.bytes +
+      lex_states.bytes +
+      lex_transitions.bytes +
+      lex_ranges.bytes;
+  }
+
+ private:
+  void add_parse_action(Section *section, const ParseAction &action) {
+    uint16_t type = 0, flags = 0, first_param = 0, second_param = 0;
+    switch (action.type) {
+      case ParseActionTypeShift:
+        type = ActionTypeShift;
+        if (action.extra) {
+          flags |= ActionExtra;
+        } else {
+          first_param = action.state_index;
+        }
+        break;
+      case ParseActionTypeReduce:
+        type = ActionTypeReduce;
+        if (action.fragile) flags |= ActionFragile;
+        first_param = symbol_ids[action.symbol];
+        second_param = action.consumed_symbol_count;
+        break;
+      case ParseActionTypeAccept:
+        type = ActionTypeAccept;
+        break;
+      case ParseActionTypeRecover:
+        type = ActionTypeRecover;
+        first_param = action.state_index;
+        break;
+      default:
+        break;
+    }
+    section->push_uint16(type);
+    section->push_uint16(flags);
+    section->push_uint16(first_param);
+    section->push_uint16(second_param);
+  }
+
+  size_t add_parse_action_list_id(const ParseTableEntry &entry) {
+    for (const auto &pair : parse_table_entries) {
+      if (pair.second == entry) {
+        return pair.first;
+      }
+    }
+
+    size_t result = next_parse_action_list_index;
+    parse_table_entries.push_back({ next_parse_action_list_index, entry });
+    next_parse_action_list_index += 1 + entry.actions.size();
+    return result;
+  }
+
+  size_t token_count() {
+    size_t result = 0;
+    for (const auto &entry : parse_table.symbols) {
+      if (entry.first.is_terminal()) result++;
+    }
+    return result;
+  }
+
+  string symbol_name(const Symbol &symbol) {
+    if (symbol == rules::END_OF_INPUT())
+      return "END";
+    return entry_for_symbol(symbol).first;
+  }
+
+  VariableType symbol_type(const Symbol &symbol) {
+    if (symbol == rules::END_OF_INPUT())
+      return VariableTypeHidden;
+    return entry_for_symbol(symbol).second;
+  }
+
+  pair<string, VariableType> entry_for_symbol(const Symbol &symbol) {
+    if (symbol.is_non_terminal()) {
+      const SyntaxVariable &variable = syntax_grammar.variables[symbol.index];
+      return { variable.name, variable.type };
+    } else {
+      const LexicalVariable &variable = lexical_grammar.variables[symbol.index];
+      return { variable.name, variable.type };
+    }
+  }
+};
+
+string binary(const ParseTable &parse_table, const LexTable &lex_table,
+              const SyntaxGrammar &syntax_grammar,
+              const LexicalGrammar &lexical_grammar) {
+  return BinaryGenerator(
+    parse_table,
+    lex_table,
+    syntax_grammar,
+    lexical_grammar
+  ).code();
+}
+
+}  // namespace generate_code
+}  // namespace tree_sitter
@@ -0,0 +1,23 @@
+#ifndef COMPILER_GENERATE_CODE_BINARY_H_
+#define COMPILER_GENERATE_CODE_BINARY_H_
+
+#include <string>
+
+namespace tree_sitter {
+
+struct LexicalGrammar;
+struct SyntaxGrammar;
+struct LexTable;
+struct ParseTable;
+
+namespace generate_code {
+
+// Serializes the tables in the format read by `ts_language_load`. Grammars
+// with external tokens are not supported, because their scanners are C code.
+std::string binary(const ParseTable &, const LexTable &,
+                   const SyntaxGrammar &, const LexicalGrammar &);
+
+}  // namespace generate_code
+}  // namespace tree_sitter
+
+#endif  // COMPILER_GENERATE_CODE_BINARY_H_
@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <functional>
 #include <map>
 #include <set>
@@ -5,6 +6,7 @@
 #include <utility>
 #include <vector>
 #include "compiler/generate_code/c_code.h"
+#include "compiler/generate_code/parse_table_layout.h"
 #include "compiler/lex_table.h"
 #include "compiler/parse_table.h"
 #include "compiler/syntax_grammar.h"
@@ -68,14 +70,16 @@ class CCodeGenerator {
   size_t indent_level;
 
   const string name;
-  const ParseTable parse_table;
+  ParseTable parse_table;
   const LexTable lex_table;
   const SyntaxGrammar syntax_grammar;
   const LexicalGrammar lexical_grammar;
   map<string, string> sanitized_names;
   vector<pair<size_t, ParseTableEntry>> parse_table_entries;
   vector<set<Symbol::Index>> external_scanner_states;
+  vector<rules::CharacterSet> character_classes;
   size_t next_parse_action_list_index;
+  size_t large_state_count;
 
  public:
   CCodeGenerator(string name, const ParseTable &parse_table,
@@ -87,7 +91,8 @@ class CCodeGenerator {
         lex_table(lex_table),
         syntax_grammar(syntax_grammar),
         lexical_grammar(lexical_grammar),
-        next_parse_action_list_index(0) {}
+        next_parse_action_list_index(0),
+        large_state_count(move_large_states_first(&this->parse_table)) {}
 
   string code() {
     buffer = "";
@@ -98,6 +103,7 @@ class CCodeGenerator {
     add_symbol_enum();
     add_symbol_names_list();
     add_symbol_metadata_list();
+    add_character_classes_list();
     add_lex_function();
     add_lex_modes_list();
 
@@ -141,6 +147,7 @@ class CCodeGenerator {
 
     line("#define LANGUAGE_VERSION " + to_string(TREE_SITTER_LANGUAGE_VERSION));
     line("#define STATE_COUNT " + to_string(parse_table.states.size()));
+    line("#define LARGE_STATE_COUNT " + to_string(large_state_count));
     line("#define SYMBOL_COUNT " + to_string(parse_table.symbols.size()));
     line("#define TOKEN_COUNT " + to_string(token_count));
     line("#define EXTERNAL_TOKEN_COUNT " + to_string(syntax_grammar.external_tokens.size()));
@@ -211,14 +218,58 @@ class CCodeGenerator {
     line();
   }
 
+  void add_character_classes_list() {
+    for (LexStateId i = 0, n = lex_table.states.size(); i < n; i++) {
+      for (const auto &pair : lex_table.states[i].advance_actions) {
+        if (pair.second.state_index == i && !pair.first.is_empty()) {
+          add_character_class(pair.first);
+        }
+      }
+    }
+
+    if (character_classes.empty()) return;
+
+    line("static const TSCharacterClass ts_character_classes[] = {");
+    indent([&]() {
+      for (size_t i = 0; i < character_classes.size(); i++) {
+        const rules::CharacterSet &characters = character_classes[i];
+        uint32_t ascii[4] = {0, 0, 0, 0};
+        for (uint32_t c = 0; c < 128; c++) {
+          if (characters.contains(c)) ascii[c / 32] |= 1u << (c % 32);
+        }
+
+        // Non-ASCII characters are only consumed in bulk if they are all
+        // included. Otherwise, the run ends at the first one and the state's
+        // ordinary conditions decide what to do with it.
+        bool non_ascii = characters.includes_all &&
+          (characters.excluded_chars.empty() || characters.excluded_chars.back().max < 128);
+
+        line(
+          "[" + to_string(i) + "] = {.ascii = {" + _hex(ascii[0]) + ", " +
+          _hex(ascii[1]) + ", " + _hex(ascii[2]) + ", " + _hex(ascii[3]) +
+          "}, .non_ascii = " + _boolean(non_ascii) + "},"
+        );
+      }
+    });
+    line("};");
+    line();
+  }
+
+  size_t add_character_class(const rules::CharacterSet &characters) {
+    for (size_t i = 0; i < character_classes.size(); i++) {
+      if (character_classes[i] == characters) return i;
+    }
+    character_classes.push_back(characters);
+    return character_classes.size() - 1;
+  }
+
   void add_lex_function() {
     line("static bool ts_lex(TSLexer *lexer, TSStateId state) {");
     indent([&]() {
       line("START_LEXER();");
       _switch("state", [&]() {
-        size_t i = 0;
-        for (const LexState &state : lex_table.states) {
-          _case(to_string(i++), [&]() { add_lex_state(state); });
+        for (LexStateId i = 0, n = lex_table.states.size(); i < n; i++) {
+          _case(to_string(i), [&]() { add_lex_state(i, lex_table.states[i]); });
         }
         _default([&]() { line("return false;"); });
       });
@@ -332,11 +383,12 @@ class CCodeGenerator {
     add_parse_action_list_id(ParseTableEntry{ {}, false, false });
 
     size_t state_id = 0;
-    line("static unsigned short ts_parse_table[STATE_COUNT][SYMBOL_COUNT] = {");
+    line("static unsigned short ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {");
 
     indent([&]() {
-      for (const auto &state : parse_table.states) {
-        line("[" + to_string(state_id++) + "] = {");
+      for (; state_id < large_state_count; state_id++) {
+        const ParseState &state = parse_table.states[state_id];
+        line("[" + to_string(state_id) + "] = {");
         indent([&]() {
           for (const auto &entry : state.nonterminal_entries) {
             line("[" + symbol_id(Symbol::non_terminal(entry.first)) + "] = STATE(");
@@ -353,12 +405,72 @@ class CCodeGenerator {
       }
     });
 
+    line("};");
+    line();
+
+    vector<size_t> small_state_indices;
+    size_t small_parse_table_size = 0;
+    line("static unsigned short ts_small_parse_table[] = {");
+
+    indent([&]() {
+      for (; state_id < parse_table.states.size(); state_id++) {
+        const ParseState &state = parse_table.states[state_id];
+        map<size_t, vector<Symbol>> nonterminal_groups, terminal_groups;
+        for (const auto &entry : state.nonterminal_entries) {
+          nonterminal_groups[entry.second].push_back(Symbol::non_terminal(entry.first));
+        }
+        for (const auto &entry : state.terminal_entries) {
+          terminal_groups[add_parse_action_list_id(entry.second)].push_back(entry.first);
+        }
+
+        small_state_indices.push_back(small_parse_table_size);
+        line("[" + to_string(small_parse_table_size) + "] = ");
+        add(to_string(nonterminal_groups.size() + terminal_groups.size()) + ",");
+        small_parse_table_size++;
+
+        indent([&]() {
+          for (const auto &group : nonterminal_groups) {
+            add_small_parse_table_group("STATE", group.first, group.second);
+            small_parse_table_size += 2 + group.second.size();
+          }
+          for (const auto &group : terminal_groups) {
+            add_small_parse_table_group("ACTIONS", group.first, group.second);
+            small_parse_table_size += 2 + group.second.size();
+          }
+        });
+      }
+
+      // An empty initializer list is not valid C.
+      if (small_parse_table_size == 0) line("0,");
+    });
+
+    line("};");
+    line();
+
+    line("static uint32_t ts_small_parse_table_map[] = {");
+    indent([&]() {
+      for (size_t i = 0; i < small_state_indices.size(); i++) {
+        line("[SMALL_STATE(" + to_string(large_state_count + i) + ")] = ");
+        add(to_string(small_state_indices[i]) + ",");
+      }
+      if (small_state_indices.empty()) line("0,");
+    });
+
     line("};");
     line();
     add_parse_action_list();
     line();
   }
 
+  void add_small_parse_table_group(string macro, size_t value, const vector<Symbol> &symbols) {
+    line(macro + "(" + to_string(value) + "), " + to_string(symbols.size()) + ",");
+    indent([&]() {
+      for (const Symbol &symbol : symbols) {
+        line(symbol_id(symbol) + ",");
+      }
+    });
+  }
+
   void add_parser_export() {
     string language_function_name = "tree_sitter_" + name;
     string external_scanner_name = language_function_name + "_external_scanner";
@@ -396,7 +508,7 @@ class CCodeGenerator {
     line();
   }
 
-  void add_lex_state(const LexState &lex_state) {
+  void add_lex_state(LexStateId state_id, const LexState &lex_state) {
     if (lex_state.accept_action.is_present()) {
       add_accept_token_action(lex_state.accept_action);
     }
@@ -404,7 +516,13 @@ class CCodeGenerator {
     for (const auto &pair : lex_state.advance_actions) {
       if (!pair.first.is_empty()) {
         _if([&]() { add_character_set_condition(pair.first); },
-            [&]() { add_advance_action(pair.second); });
+            [&]() {
+              if (pair.second.state_index == state_id) {
+                add_advance_while_action(pair.second, add_character_class(pair.first));
+              } else {
+                add_advance_action(pair.second);
+              }
+            });
       }
     }
 
@@ -458,6 +576,17 @@ class CCodeGenerator {
     }
   }
 
+  // A state that loops back to itself consumes the entire run of characters
+  // that keeps it there with a single call.
+  void add_advance_while_action(const AdvanceAction &action, size_t class_index) {
+    string arguments = "(" + to_string(action.state_index) + ", " + to_string(class_index) + ");";
+    if (action.in_main_token) {
+      line("ADVANCE_WHILE" + arguments);
+    } else {
+      line("SKIP_WHILE" + arguments);
+    }
+  }
+
   void add_accept_token_action(const AcceptTokenAction &action) {
     line("ACCEPT_TOKEN(" + symbol_id(action.symbol) + ");");
   }
@@ -646,6 +775,12 @@ class CCodeGenerator {
     return value ? "true" : "false";
   }
 
+  string _hex(uint32_t value) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "0x%08x", value);
+    return buffer;
+  }
+
   bool has_sanitized_name(string name) {
     for (const auto &pair : sanitized_names)
       if (pair.second == name)
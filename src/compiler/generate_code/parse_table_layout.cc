@@ -0,0 +1,74 @@
+#include "compiler/generate_code/parse_table_layout.h"
+#include <set>
+#include <vector>
+#include "compiler/parse_table.h"
+
+namespace tree_sitter {
+namespace generate_code {
+
+using std::set;
+using std::vector;
+
+static bool is_small_state(const ParseState &state, size_t symbol_count) {
+  set<ParseStateId> nonterminal_values;
+  for (const auto &entry : state.nonterminal_entries) {
+    nonterminal_values.insert(entry.second);
+  }
+
+  vector<const ParseTableEntry *> terminal_values;
+  for (const auto &entry : state.terminal_entries) {
+    bool is_new = true;
+    for (const ParseTableEntry *value : terminal_values) {
+      if (*value == entry.second) {
+        is_new = false;
+        break;
+      }
+    }
+    if (is_new) terminal_values.push_back(&entry.second);
+  }
+
+  // A group count, and a value and a symbol count for each group, then the
+  // symbols themselves, plus one 32-bit entry in the map.
+  size_t group_count = nonterminal_values.size() + terminal_values.size();
+  size_t entry_count = state.nonterminal_entries.size() + state.terminal_entries.size();
+  size_t small_size = 1 + 2 * group_count + entry_count + 2;
+  return small_size < symbol_count;
+}
+
+// States with few distinct entries are stored as lists of groups rather
+// than as rows of the dense table. The runtime tells the two encodings apart
+// by state id, so the states are renumbered to put all of the large states
+// first. The error state and the start state keep their ids, so they are
+// always stored densely.
+size_t move_large_states_first(ParseTable *parse_table) {
+  vector<ParseStateId> large_state_ids, small_state_ids;
+  for (ParseStateId i = 0; i < parse_table->states.size(); i++) {
+    if (i <= 1 || !is_small_state(parse_table->states[i], parse_table->symbols.size())) {
+      large_state_ids.push_back(i);
+    } else {
+      small_state_ids.push_back(i);
+    }
+  }
+
+  vector<ParseStateId> new_state_ids(parse_table->states.size());
+  vector<ParseState> new_states;
+  for (ParseStateId old_id : large_state_ids) {
+    new_state_ids[old_id] = new_states.size();
+    new_states.push_back(parse_table->states[old_id]);
+  }
+  for (ParseStateId old_id : small_state_ids) {
+    new_state_ids[old_id] = new_states.size();
+    new_states.push_back(parse_table->states[old_id]);
+  }
+
+  for (ParseState &state : new_states) {
+    state.each_referenced_state([&](ParseStateId *state_id) {
+      *state_id = new_state_ids[*state_id];
+    });
+  }
+  parse_table->states.swap(new_states);
+  return large_state_ids.size();
+}
+
+}  // namespace generate_code
+}  // namespace tree_sitter
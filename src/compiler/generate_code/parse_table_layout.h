@@ -0,0 +1,19 @@
+#ifndef COMPILER_GENERATE_CODE_PARSE_TABLE_LAYOUT_H_
+#define COMPILER_GENERATE_CODE_PARSE_TABLE_LAYOUT_H_
+
+#include <cstddef>
+
+namespace tree_sitter {
+
+struct ParseTable;
+
+namespace generate_code {
+
+// Renumbers the table's states so that the ones that are stored as rows of
+// the dense table come first, and returns the number of such states.
+size_t move_large_states_first(ParseTable *);
+
+}  // namespace generate_code
+}  // namespace tree_sitter
+
+#endif  // COMPILER_GENERATE_CODE_PARSE_TABLE_LAYOUT_H_
@@ -31,6 +31,13 @@ struct InputGrammar {
   std::vector<rules::Rule> extra_tokens;
   std::vector<std::unordered_set<rules::NamedSymbol>> expected_conflicts;
   std::vector<Variable> external_tokens;
+
+  inline bool operator==(const InputGrammar &other) const {
+    return variables == other.variables &&
+      extra_tokens == other.extra_tokens &&
+      expected_conflicts == other.expected_conflicts &&
+      external_tokens == other.external_tokens;
+  }
 };
 
 }  // namespace tree_sitter
@@ -8,6 +8,7 @@
 #include "compiler/lexical_grammar.h"
 #include "compiler/prepare_grammar/initial_syntax_grammar.h"
 #include "compiler/syntax_grammar.h"
+#include "compiler/util/phase_timer.h"
 
 namespace tree_sitter {
 namespace prepare_grammar {
@@ -15,13 +16,21 @@ namespace prepare_grammar {
 using std::tuple;
 using std::get;
 using std::make_tuple;
+using util::PhaseTimer;
 
 tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(
   const InputGrammar &input_grammar) {
+  return prepare_grammar(input_grammar, nullptr);
+}
+
+tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(
+  const InputGrammar &input_grammar, TSCompileStats *stats) {
   /*
    * Convert all string-based `NamedSymbols` into numerical `Symbols`
    */
+  PhaseTimer intern_timer(stats ? &stats->intern_symbols_micros : nullptr);
   auto intern_result = intern_symbols(input_grammar);
+  intern_timer.stop();
   CompileError error = intern_result.second;
   if (error.type)
     return make_tuple(SyntaxGrammar(), LexicalGrammar(), error);
@@ -29,7 +38,9 @@ tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(
   /*
    * Separate grammar into lexical and syntactic components
    */
+  PhaseTimer extract_timer(stats ? &stats->extract_tokens_micros : nullptr);
   auto extract_result = extract_tokens(intern_result.first);
+  extract_timer.stop();
   error = get<2>(extract_result);
   if (error.type) {
     return make_tuple(SyntaxGrammar(), LexicalGrammar(), error);
@@ -38,7 +49,9 @@ tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(
   /*
    * Replace `Repeat` rules with pairs of recursive rules
    */
+  PhaseTimer expand_timer(stats ? &stats->expand_repeats_micros : nullptr);
   InitialSyntaxGrammar syntax_grammar1 = expand_repeats(get<0>(extract_result));
+  expand_timer.stop();
 
   /*
    * Expand `String` and `Pattern` rules into full rule trees
@@ -53,7 +66,9 @@ tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(
   /*
    * Flatten syntax rules into lists of productions.
    */
+  PhaseTimer flatten_timer(stats ? &stats->flatten_grammar_micros : nullptr);
   auto flatten_result = flatten_grammar(syntax_grammar1);
+  flatten_timer.stop();
   SyntaxGrammar syntax_grammar = flatten_result.first;
   error = flatten_result.second;
   if (error.type)
@@ -62,7 +77,9 @@ tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(
   /*
    * Ensure all lexical rules are in a consistent format.
    */
+  PhaseTimer normalize_timer(stats ? &stats->normalize_rules_micros : nullptr);
   lex_grammar = normalize_rules(lex_grammar);
+  normalize_timer.stop();
 
   return make_tuple(syntax_grammar, lex_grammar, CompileError::none());
 }
@@ -12,6 +12,10 @@ namespace prepare_grammar {
 
 std::tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(const InputGrammar &);
 
+// Records the time taken by each pass in the given stats, if they are present.
+std::tuple<SyntaxGrammar, LexicalGrammar, CompileError> prepare_grammar(
+  const InputGrammar &, TSCompileStats *);
+
 }  // namespace prepare_grammar
 }  // namespace tree_sitter
 
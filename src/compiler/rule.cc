@@ -219,12 +219,14 @@ size_t hash<CharacterSet>::operator()(const CharacterSet &character_set) const {
   size_t result = 0;
   hash_combine(&result, character_set.includes_all);
   hash_combine(&result, character_set.included_chars.size());
-  for (uint32_t c : character_set.included_chars) {
-    hash_combine(&result, c);
+  for (const CharacterRange &range : character_set.included_chars) {
+    hash_combine(&result, range.min);
+    hash_combine(&result, range.max);
   }
   hash_combine(&result, character_set.excluded_chars.size());
-  for (uint32_t c : character_set.excluded_chars) {
-    hash_combine(&result, c);
+  for (const CharacterRange &range : character_set.excluded_chars) {
+    hash_combine(&result, range.min);
+    hash_combine(&result, range.max);
   }
   return result;
 }
@@ -1,4 +1,5 @@
 #include "compiler/rules/character_set.h"
+#include <algorithm>
 
 using std::set;
 using std::vector;
@@ -6,54 +7,98 @@ using std::vector;
 namespace tree_sitter {
 namespace rules {
 
-static void add_range(set<uint32_t> *characters, uint32_t min, uint32_t max) {
-  for (uint32_t c = min; c <= max; c++) {
-    characters->insert(c);
+typedef vector<CharacterRange> RangeList;
+
+static void append_range(RangeList *ranges, uint32_t min, uint32_t max) {
+  if (!ranges->empty() && uint64_t(ranges->back().max) + 1 >= min) {
+    if (max > ranges->back().max) ranges->back().max = max;
+  } else {
+    ranges->push_back(CharacterRange(min, max));
   }
 }
 
-static void remove_range(set<uint32_t> *characters, uint32_t min, uint32_t max) {
-  for (uint32_t c = min; c <= max; c++) {
-    characters->erase(c);
+static RangeList union_ranges(const RangeList &left, const RangeList &right) {
+  RangeList result;
+  auto left_iter = left.begin(), right_iter = right.begin();
+  while (left_iter != left.end() || right_iter != right.end()) {
+    if (right_iter == right.end() ||
+        (left_iter != left.end() && left_iter->min <= right_iter->min)) {
+      append_range(&result, left_iter->min, left_iter->max);
+      ++left_iter;
+    } else {
+      append_range(&result, right_iter->min, right_iter->max);
+      ++right_iter;
+    }
   }
+  return result;
 }
 
-static set<uint32_t> remove_chars(set<uint32_t> *left, const set<uint32_t> &right) {
-  set<uint32_t> result;
-  for (uint32_t c : right) {
-    if (left->erase(c)) {
-      result.insert(c);
+static RangeList intersect_ranges(const RangeList &left, const RangeList &right) {
+  RangeList result;
+  auto left_iter = left.begin(), right_iter = right.begin();
+  while (left_iter != left.end() && right_iter != right.end()) {
+    uint32_t min = std::max(left_iter->min, right_iter->min);
+    uint32_t max = std::min(left_iter->max, right_iter->max);
+    if (min <= max) result.push_back(CharacterRange(min, max));
+    if (left_iter->max < right_iter->max) {
+      ++left_iter;
+    } else {
+      ++right_iter;
     }
   }
   return result;
 }
 
-static set<uint32_t> add_chars(set<uint32_t> *left, const set<uint32_t> &right) {
-  set<uint32_t> result;
-  for (uint32_t c : right) {
-    if (left->insert(c).second) {
-      result.insert(c);
+static RangeList subtract_ranges(const RangeList &left, const RangeList &right) {
+  RangeList result;
+  auto right_iter = right.begin();
+  for (const CharacterRange &range : left) {
+    uint64_t min = range.min;
+    while (right_iter != right.end() && right_iter->max < min) ++right_iter;
+    for (auto iter = right_iter; iter != right.end() && iter->min <= range.max; ++iter) {
+      if (iter->min > min) result.push_back(CharacterRange(min, iter->min - 1));
+      min = uint64_t(iter->max) + 1;
     }
+    if (min <= range.max) result.push_back(CharacterRange(min, range.max));
   }
   return result;
 }
 
-static vector<CharacterRange> consolidate_ranges(const set<uint32_t> &chars) {
+// Compare two lists as if they were sorted sequences of individual
+// characters, without expanding them.
+static int compare_ranges(const RangeList &left, const RangeList &right) {
+  auto left_iter = left.begin(), right_iter = right.begin();
+  uint32_t left_char = left_iter == left.end() ? 0 : left_iter->min;
+  uint32_t right_char = right_iter == right.end() ? 0 : right_iter->min;
+  while (left_iter != left.end() && right_iter != right.end()) {
+    if (left_char != right_char) return left_char < right_char ? -1 : 1;
+    uint32_t shared_max = std::min(left_iter->max, right_iter->max);
+    if (shared_max == left_iter->max && ++left_iter != left.end()) {
+      left_char = left_iter->min;
+    } else {
+      left_char = shared_max + 1;
+    }
+    if (shared_max == right_iter->max && ++right_iter != right.end()) {
+      right_char = right_iter->min;
+    } else {
+      right_char = shared_max + 1;
+    }
+  }
+  if (left_iter != left.end()) return 1;
+  if (right_iter != right.end()) return -1;
+  return 0;
+}
+
+// Runs of three or more characters are rendered as ranges. Shorter runs are
+// rendered as individual characters.
+static vector<CharacterRange> consolidate_ranges(const RangeList &ranges) {
   vector<CharacterRange> result;
-  for (uint32_t c : chars) {
-    auto size = result.size();
-    if (size >= 2 && result[size - 2].max == (c - 2)) {
-      result.pop_back();
-      result.back().max = c;
-    } else if (size >= 1) {
-      CharacterRange &last = result.back();
-      if (last.min < last.max && last.max == (c - 1)) {
-        last.max = c;
-      } else {
-        result.push_back(CharacterRange(c));
-      }
+  for (const CharacterRange &range : ranges) {
+    if (range.max - range.min == 1) {
+      result.push_back(CharacterRange(range.min));
+      result.push_back(CharacterRange(range.max));
     } else {
-      result.push_back(CharacterRange(c));
+      result.push_back(range);
     }
   }
   return result;
@@ -61,7 +106,9 @@ static vector<CharacterRange> consolidate_ranges(const set<uint32_t> &chars) {
 
 CharacterSet::CharacterSet() : includes_all(false) {}
 
-CharacterSet::CharacterSet(const set<uint32_t> &chars) : included_chars(chars), includes_all(false) {}
+CharacterSet::CharacterSet(const set<uint32_t> &chars) : includes_all(false) {
+  for (uint32_t c : chars) append_range(&included_chars, c, c);
+}
 
 bool CharacterSet::operator==(const CharacterSet &other) const {
   return includes_all == other.includes_all &&
@@ -74,33 +121,32 @@ bool CharacterSet::operator<(const CharacterSet &other) const {
     return true;
   if (includes_all && !other.includes_all)
     return false;
-  if (included_chars < other.included_chars)
-    return true;
-  if (other.included_chars < included_chars)
-    return false;
-  return excluded_chars < other.excluded_chars;
+  int comparison = compare_ranges(included_chars, other.included_chars);
+  if (comparison != 0)
+    return comparison < 0;
+  return compare_ranges(excluded_chars, other.excluded_chars) < 0;
 }
 
 CharacterSet &CharacterSet::include_all() {
   includes_all = true;
   included_chars = {};
-  excluded_chars = { 0 };
+  excluded_chars = { CharacterRange(0) };
   return *this;
 }
 
 CharacterSet &CharacterSet::include(uint32_t min, uint32_t max) {
   if (includes_all)
-    remove_range(&excluded_chars, min, max);
+    excluded_chars = subtract_ranges(excluded_chars, { CharacterRange(min, max) });
   else
-    add_range(&included_chars, min, max);
+    included_chars = union_ranges(included_chars, { CharacterRange(min, max) });
   return *this;
 }
 
 CharacterSet &CharacterSet::exclude(uint32_t min, uint32_t max) {
   if (includes_all)
-    add_range(&excluded_chars, min, max);
+    excluded_chars = union_ranges(excluded_chars, { CharacterRange(min, max) });
   else
-    remove_range(&included_chars, min, max);
+    included_chars = subtract_ranges(included_chars, { CharacterRange(min, max) });
   return *this;
 }
 
@@ -116,23 +162,30 @@ bool CharacterSet::is_empty() const {
   return !includes_all && included_chars.empty();
 }
 
+bool CharacterSet::contains(uint32_t c) const {
+  const RangeList &ranges = includes_all ? excluded_chars : included_chars;
+  auto iter = std::upper_bound(
+    ranges.begin(), ranges.end(), c,
+    [](uint32_t c, const CharacterRange &range) { return c < range.min; }
+  );
+  bool in_ranges = iter != ranges.begin() && (iter - 1)->max >= c;
+  return includes_all ? !in_ranges : in_ranges;
+}
+
 void CharacterSet::add_set(const CharacterSet &other) {
   if (includes_all) {
     if (other.includes_all) {
-      excluded_chars = remove_chars(&excluded_chars, other.excluded_chars);
+      excluded_chars = intersect_ranges(excluded_chars, other.excluded_chars);
     } else {
-      remove_chars(&excluded_chars, other.included_chars);
+      excluded_chars = subtract_ranges(excluded_chars, other.included_chars);
     }
   } else {
     if (other.includes_all) {
       includes_all = true;
-      for (uint32_t c : other.excluded_chars)
-        if (!included_chars.count(c))
-          excluded_chars.insert(c);
+      excluded_chars = subtract_ranges(other.excluded_chars, included_chars);
       included_chars.clear();
     } else {
-      for (uint32_t c : other.included_chars)
-        included_chars.insert(c);
+      included_chars = union_ranges(included_chars, other.included_chars);
     }
   }
 }
@@ -142,29 +195,31 @@ CharacterSet CharacterSet::remove_set(const CharacterSet &other) {
   if (includes_all) {
     if (other.includes_all) {
       result.includes_all = true;
-      result.excluded_chars = excluded_chars;
-      included_chars = add_chars(&result.excluded_chars, other.excluded_chars);
+      result.excluded_chars = union_ranges(excluded_chars, other.excluded_chars);
+      included_chars = subtract_ranges(other.excluded_chars, excluded_chars);
       excluded_chars = {};
       includes_all = false;
     } else {
-      result.included_chars = add_chars(&excluded_chars, other.included_chars);
+      result.included_chars = subtract_ranges(other.included_chars, excluded_chars);
+      excluded_chars = union_ranges(excluded_chars, other.included_chars);
     }
   } else {
     if (other.includes_all) {
-      result.included_chars = included_chars;
-      included_chars =
-        remove_chars(&result.included_chars, other.excluded_chars);
+      result.included_chars = subtract_ranges(included_chars, other.excluded_chars);
+      included_chars = intersect_ranges(included_chars, other.excluded_chars);
     } else {
-      result.included_chars =
-        remove_chars(&included_chars, other.included_chars);
+      result.included_chars = intersect_ranges(included_chars, other.included_chars);
+      included_chars = subtract_ranges(included_chars, other.included_chars);
     }
   }
   return result;
 }
 
 bool CharacterSet::intersects(const CharacterSet &other) const {
-  CharacterSet copy(*this);
-  return !copy.remove_set(other).is_empty();
+  if (includes_all && other.includes_all) return true;
+  if (includes_all) return !subtract_ranges(other.included_chars, excluded_chars).empty();
+  if (other.includes_all) return !subtract_ranges(included_chars, other.excluded_chars).empty();
+  return !intersect_ranges(included_chars, other.included_chars).empty();
 }
 
 vector<CharacterRange> CharacterSet::included_ranges() const {
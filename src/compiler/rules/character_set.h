@@ -36,17 +36,20 @@ struct CharacterSet {
   void add_set(const CharacterSet &other);
   CharacterSet remove_set(const CharacterSet &other);
   bool intersects(const CharacterSet &other) const;
+  bool contains(uint32_t c) const;
   bool is_empty() const;
 
   std::vector<CharacterRange> included_ranges() const;
   std::vector<CharacterRange> excluded_ranges() const;
 
-  std::set<uint32_t> included_chars;
-  std::set<uint32_t> excluded_chars;
+  // Both lists are sorted, and their ranges never overlap or touch, so that
+  // equal sets always have equal representations.
+  std::vector<CharacterRange> included_chars;
+  std::vector<CharacterRange> excluded_chars;
   bool includes_all;
 };
 
 }  // namespace rules
 }  // namespace tree_sitter
 
-#endif  // COMPILER_RULES_CHARACTER_SET_H_
\ No newline at end of file
+#endif  // COMPILER_RULES_CHARACTER_SET_H_
@@ -0,0 +1,41 @@
+#ifndef COMPILER_UTIL_PHASE_TIMER_H_
+#define COMPILER_UTIL_PHASE_TIMER_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace tree_sitter {
+namespace util {
+
+// Adds the wall time between its construction and its destruction (or an
+// earlier call to `stop`) to the given counter, in microseconds. A null
+// counter disables the timer.
+class PhaseTimer {
+  uint64_t *counter;
+  std::chrono::steady_clock::time_point start;
+
+ public:
+  explicit PhaseTimer(uint64_t *counter) : counter(counter) {
+    if (counter) start = std::chrono::steady_clock::now();
+  }
+
+  ~PhaseTimer() {
+    stop();
+  }
+
+  void stop() {
+    if (counter) {
+      auto duration = std::chrono::steady_clock::now() - start;
+      *counter += std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+      counter = nullptr;
+    }
+  }
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+};
+
+}  // namespace util
+}  // namespace tree_sitter
+
+#endif  // COMPILER_UTIL_PHASE_TIMER_H_
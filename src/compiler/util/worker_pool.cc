@@ -0,0 +1,84 @@
+#include "compiler/util/worker_pool.h"
+
+namespace tree_sitter {
+namespace util {
+
+using std::function;
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+WorkerPool::WorkerPool(unsigned thread_count)
+    : task(nullptr),
+      task_count(0),
+      next_index(0),
+      batch_id(0),
+      busy_worker_count(0),
+      is_stopping(false) {
+  for (unsigned i = 1; i < thread_count; i++) {
+    workers.emplace_back(&WorkerPool::wait_for_batches, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    lock_guard<mutex> lock(batch_mutex);
+    is_stopping = true;
+  }
+  batch_started.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void WorkerPool::run(size_t count, const function<void(size_t)> &callback) {
+  if (workers.empty() || count <= 1) {
+    for (size_t i = 0; i < count; i++) callback(i);
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(batch_mutex);
+    task = &callback;
+    task_count = count;
+    next_index = 0;
+    busy_worker_count = workers.size();
+    batch_id++;
+  }
+  batch_started.notify_all();
+
+  work_on_batch();
+
+  // Every worker takes part in every batch, so once they have all finished,
+  // none of them can still be calling the function.
+  unique_lock<mutex> lock(batch_mutex);
+  batch_finished.wait(lock, [this]() { return busy_worker_count == 0; });
+  task = nullptr;
+}
+
+void WorkerPool::work_on_batch() {
+  for (size_t i = next_index++; i < task_count; i = next_index++) {
+    (*task)(i);
+  }
+}
+
+void WorkerPool::wait_for_batches() {
+  size_t finished_batch_id = 0;
+  unique_lock<mutex> lock(batch_mutex);
+  for (;;) {
+    batch_started.wait(lock, [&]() {
+      return is_stopping || batch_id != finished_batch_id;
+    });
+    if (is_stopping) return;
+    finished_batch_id = batch_id;
+
+    lock.unlock();
+    work_on_batch();
+    lock.lock();
+
+    if (--busy_worker_count == 0) batch_finished.notify_one();
+  }
+}
+
+}  // namespace util
+}  // namespace tree_sitter
@@ -0,0 +1,48 @@
+#ifndef COMPILER_UTIL_WORKER_POOL_H_
+#define COMPILER_UTIL_WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tree_sitter {
+namespace util {
+
+// A fixed set of threads that run successive batches of tasks, so that the
+// threads are created once rather than for every batch. The calling thread
+// works on each batch too, so a pool of one thread creates no workers.
+class WorkerPool {
+ public:
+  explicit WorkerPool(unsigned thread_count);
+  ~WorkerPool();
+
+  // Calls the given function with each index below the given count, and
+  // returns once all of the calls have finished.
+  void run(size_t count, const std::function<void(size_t)> &);
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+ private:
+  void work_on_batch();
+  void wait_for_batches();
+
+  std::vector<std::thread> workers;
+  std::mutex batch_mutex;
+  std::condition_variable batch_started;
+  std::condition_variable batch_finished;
+  const std::function<void(size_t)> *task;
+  size_t task_count;
+  std::atomic<size_t> next_index;
+  size_t batch_id;
+  unsigned busy_worker_count;
+  bool is_stopping;
+};
+
+}  // namespace util
+}  // namespace tree_sitter
+
+#endif  // COMPILER_UTIL_WORKER_POOL_H_
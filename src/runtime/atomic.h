@@ -0,0 +1,38 @@
+#ifndef RUNTIME_ATOMIC_H_
+#define RUNTIME_ATOMIC_H_
+
+#include <stdint.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+static inline uint32_t atomic_load(const volatile uint32_t *p) {
+  return *p;
+}
+
+static inline uint32_t atomic_inc(volatile uint32_t *p) {
+  return InterlockedIncrement((volatile LONG *)p);
+}
+
+static inline uint32_t atomic_dec(volatile uint32_t *p) {
+  return InterlockedDecrement((volatile LONG *)p);
+}
+
+#else
+
+static inline uint32_t atomic_load(const volatile uint32_t *p) {
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t atomic_inc(volatile uint32_t *p) {
+  return __atomic_add_fetch(p, 1, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t atomic_dec(volatile uint32_t *p) {
+  return __atomic_sub_fetch(p, 1, __ATOMIC_ACQ_REL);
+}
+
+#endif
+
+#endif  // RUNTIME_ATOMIC_H_
@@ -0,0 +1,376 @@
+#include <string.h>
+#include "runtime/binary_language.h"
+#include "runtime/alloc.h"
+#include "tree_sitter/runtime.h"
+
+/*
+ *  A binary language starts with a header of 32-bit integers, followed by
+ *  these sections, each of which is padded to a four-byte boundary:
+ *
+ *  - symbol metadata: one byte of flags per symbol
+ *  - symbol names: a null-terminated string per symbol
+ *  - the dense parse table: `large_state_count` rows of 16-bit values
+ *  - the small parse table: 16-bit values, as in generated parsers
+ *  - the small parse table map: a 32-bit offset per small state
+ *  - parse actions: four 16-bit values per entry
+ *  - lex modes: a 16-bit lex state per parse state
+ *  - lex states, lex transitions and character ranges (see below)
+ *
+ *  Integers are stored in the byte order of the machine that produced the
+ *  data. The magic number catches data produced on a different machine.
+ */
+
+#define BINARY_LANGUAGE_MAGIC 0x424c5354
+#define NO_SYMBOL 0xffff
+
+enum {
+  SymbolVisible = 1,
+  SymbolNamed = 2,
+  SymbolExtra = 4,
+  SymbolStructural = 8,
+};
+
+enum {
+  ActionExtra = 1,
+  ActionFragile = 2,
+};
+
+enum {
+  ActionEntryReusable = 1,
+  ActionEntryDependsOnLookahead = 2,
+};
+
+enum {
+  TransitionSkip = 1,
+  TransitionInverted = 2,
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t symbol_count;
+  uint32_t token_count;
+  uint32_t state_count;
+  uint32_t large_state_count;
+  uint32_t small_parse_table_size;
+  uint32_t parse_action_count;
+  uint32_t lex_state_count;
+  uint32_t lex_transition_count;
+  uint32_t character_range_count;
+  uint32_t symbol_names_size;
+} BinaryHeader;
+
+typedef struct {
+  uint16_t accept_symbol;
+  uint16_t transition_count;
+  uint32_t transition_index;
+} BinaryLexState;
+
+typedef struct {
+  uint32_t range_index;
+  uint16_t range_count;
+  uint16_t state;
+  uint32_t flags;
+} BinaryLexTransition;
+
+typedef struct {
+  uint32_t min;
+  uint32_t max;
+} BinaryCharacterRange;
+
+typedef struct {
+  TSLanguage language;
+  const BinaryLexState *lex_states;
+  const BinaryLexTransition *lex_transitions;
+  const BinaryCharacterRange *character_ranges;
+} BinaryLanguage;
+
+typedef struct {
+  const uint8_t *data;
+  size_t length;
+  size_t position;
+} Reader;
+
+// Returns a pointer to the next `count` elements of the data and skips past
+// them and any padding, or returns NULL if the data is too short.
+static const void *reader_take(Reader *self, size_t count, size_t element_size) {
+  if (element_size && count > (self->length - self->position) / element_size)
+    return NULL;
+  const void *result = self->data + self->position;
+  self->position += count * element_size;
+  self->position += (4 - self->position % 4) % 4;
+  if (self->position > self->length) self->position = self->length;
+  return result;
+}
+
+static bool ranges_contain(const BinaryCharacterRange *ranges, uint32_t count,
+                           int32_t lookahead) {
+  uint32_t c = (uint32_t)lookahead;
+  uint32_t start = 0, end = count;
+  while (start < end) {
+    uint32_t middle = start + (end - start) / 2;
+    if (c < ranges[middle].min) {
+      end = middle;
+    } else if (c > ranges[middle].max) {
+      start = middle + 1;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ts_binary_language_lex(const TSLanguage *language, TSLexer *lexer,
+                            TSStateId state) {
+  const BinaryLanguage *self = (const BinaryLanguage *)language;
+  bool result = false;
+
+  for (;;) {
+    const BinaryLexState *lex_state = &self->lex_states[state];
+
+    if (lex_state->accept_symbol != NO_SYMBOL) {
+      result = true;
+      lexer->result_symbol = lex_state->accept_symbol;
+      lexer->mark_end(lexer);
+    }
+
+    const BinaryLexTransition *transition = NULL;
+    for (uint32_t i = 0; i < lex_state->transition_count; i++) {
+      const BinaryLexTransition *candidate =
+        &self->lex_transitions[lex_state->transition_index + i];
+      bool is_match = ranges_contain(
+        &self->character_ranges[candidate->range_index],
+        candidate->range_count,
+        lexer->lookahead
+      );
+      if (candidate->flags & TransitionInverted) is_match = !is_match;
+      if (is_match) {
+        transition = candidate;
+        break;
+      }
+    }
+
+    if (!transition) return result;
+    lexer->advance(lexer, transition->flags & TransitionSkip);
+    state = transition->state;
+  }
+}
+
+// Terminal values index the parse actions, and must point at the header of
+// an entry rather than at one of the actions that follow it.
+static bool parse_table_value_is_valid(const BinaryHeader *header,
+                                      const bool *action_entry_starts,
+                                      TSSymbol symbol, uint16_t value) {
+  if (symbol < header->token_count) {
+    return value < header->parse_action_count && action_entry_starts[value];
+  } else {
+    return value < header->state_count;
+  }
+}
+
+// Check every index stored in the tables, so that a corrupt file is rejected
+// here rather than crashing the parser later.
+static bool binary_language_is_valid(const BinaryLanguage *self,
+                                     const BinaryHeader *header,
+                                     const bool *action_entry_starts) {
+  const TSLanguage *language = &self->language;
+
+  for (uint32_t state = 0; state < header->large_state_count; state++) {
+    for (uint32_t symbol = 0; symbol < header->symbol_count; symbol++) {
+      uint16_t value = language->parse_table[state * header->symbol_count + symbol];
+      if (!parse_table_value_is_valid(header, action_entry_starts, symbol, value))
+        return false;
+    }
+  }
+
+  for (uint32_t i = 0; i < header->state_count - header->large_state_count; i++) {
+    uint32_t index = language->small_parse_table_map[i];
+    if (index >= header->small_parse_table_size) return false;
+    uint16_t group_count = language->small_parse_table[index++];
+    for (uint16_t j = 0; j < group_count; j++) {
+      if (header->small_parse_table_size - index < 2) return false;
+      uint16_t value = language->small_parse_table[index++];
+      uint16_t symbol_count = language->small_parse_table[index++];
+      if (header->small_parse_table_size - index < symbol_count) return false;
+      for (uint16_t k = 0; k < symbol_count; k++) {
+        TSSymbol symbol = language->small_parse_table[index++];
+        if (symbol >= header->symbol_count) return false;
+        if (!parse_table_value_is_valid(header, action_entry_starts, symbol, value))
+          return false;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < header->parse_action_count;) {
+    uint16_t count = language->parse_actions[i++].count;
+    for (uint16_t j = 0; j < count; j++, i++) {
+      TSParseAction action = language->parse_actions[i].action;
+      if (action.type == TSParseActionTypeReduce) {
+        if (action.params.symbol >= header->symbol_count) return false;
+      } else {
+        if (action.params.to_state >= header->state_count) return false;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < header->state_count; i++) {
+    if (language->lex_modes[i].lex_state >= header->lex_state_count) return false;
+  }
+
+  for (uint32_t i = 0; i < header->lex_state_count; i++) {
+    const BinaryLexState *state = &self->lex_states[i];
+    if (state->accept_symbol != NO_SYMBOL && state->accept_symbol >= header->token_count)
+      return false;
+    if (state->transition_index > header->lex_transition_count ||
+        state->transition_count > header->lex_transition_count - state->transition_index)
+      return false;
+  }
+
+  for (uint32_t i = 0; i < header->lex_transition_count; i++) {
+    const BinaryLexTransition *transition = &self->lex_transitions[i];
+    if (transition->state >= header->lex_state_count) return false;
+    if (transition->range_index > header->character_range_count ||
+        transition->range_count > header->character_range_count - transition->range_index)
+      return false;
+  }
+
+  return true;
+}
+
+const TSLanguage *ts_language_load(const void *data, size_t length) {
+  if ((uintptr_t)data % 4 != 0) return NULL;
+
+  Reader reader = {(const uint8_t *)data, length, 0};
+  const BinaryHeader *header = reader_take(&reader, 1, sizeof(BinaryHeader));
+  if (!header) return NULL;
+  if (header->magic != BINARY_LANGUAGE_MAGIC) return NULL;
+  if (header->version != TREE_SITTER_LANGUAGE_VERSION) return NULL;
+  if (header->large_state_count > header->state_count) return NULL;
+  if (header->token_count > header->symbol_count) return NULL;
+  if (header->state_count < 2) return NULL;
+
+  const uint8_t *symbol_flags = reader_take(&reader, header->symbol_count, 1);
+  const char *symbol_names = reader_take(&reader, header->symbol_names_size, 1);
+  const uint16_t *parse_table = reader_take(
+    &reader, (size_t)header->large_state_count * header->symbol_count, 2
+  );
+  const uint16_t *small_parse_table = reader_take(
+    &reader, header->small_parse_table_size, 2
+  );
+  const uint32_t *small_parse_table_map = reader_take(
+    &reader, header->state_count - header->large_state_count, 4
+  );
+  const uint16_t *parse_actions = reader_take(&reader, header->parse_action_count, 8);
+  const uint16_t *lex_modes = reader_take(&reader, header->state_count, 2);
+  const BinaryLexState *lex_states = reader_take(
+    &reader, header->lex_state_count, sizeof(BinaryLexState)
+  );
+  const BinaryLexTransition *lex_transitions = reader_take(
+    &reader, header->lex_transition_count, sizeof(BinaryLexTransition)
+  );
+  const BinaryCharacterRange *character_ranges = reader_take(
+    &reader, header->character_range_count, sizeof(BinaryCharacterRange)
+  );
+
+  if (!symbol_flags || !symbol_names || !parse_table || !small_parse_table ||
+      !small_parse_table_map || !parse_actions || !lex_modes || !lex_states ||
+      !lex_transitions || !character_ranges)
+    return NULL;
+
+  BinaryLanguage *self = ts_calloc(1, sizeof(BinaryLanguage));
+  TSLanguage *language = &self->language;
+  language->version = header->version;
+  language->symbol_count = header->symbol_count;
+  language->token_count = header->token_count;
+  language->large_state_count = header->large_state_count;
+  language->parse_table = parse_table;
+  language->small_parse_table = small_parse_table;
+  language->small_parse_table_map = small_parse_table_map;
+  language->lex_fn = NULL;
+  self->lex_states = lex_states;
+  self->lex_transitions = lex_transitions;
+  self->character_ranges = character_ranges;
+
+  // Symbol metadata and parse actions use bit fields, whose layout depends
+  // on the compiler, so they are decoded rather than used in place.
+  TSSymbolMetadata *symbol_metadata = ts_calloc(header->symbol_count, sizeof(TSSymbolMetadata));
+  const char **names = ts_calloc(header->symbol_count, sizeof(const char *));
+  TSParseActionEntry *actions = ts_calloc(header->parse_action_count, sizeof(TSParseActionEntry));
+  TSLexMode *modes = ts_calloc(header->state_count, sizeof(TSLexMode));
+  bool *action_entry_starts = ts_calloc(header->parse_action_count + 1, sizeof(bool));
+  language->symbol_metadata = symbol_metadata;
+  language->symbol_names = names;
+  language->parse_actions = actions;
+  language->lex_modes = modes;
+
+  const char *name = symbol_names, *names_end = symbol_names + header->symbol_names_size;
+  for (uint32_t i = 0; i < header->symbol_count; i++) {
+    uint8_t flags = symbol_flags[i];
+    symbol_metadata[i] = (TSSymbolMetadata){
+      .visible = flags & SymbolVisible,
+      .named = flags & SymbolNamed,
+      .extra = flags & SymbolExtra,
+      .structural = flags & SymbolStructural,
+    };
+
+    const char *name_end = name < names_end ? memchr(name, 0, names_end - name) : NULL;
+    if (!name_end)
+      goto error;
+    names[i] = name;
+    name = name_end + 1;
+  }
+
+  for (uint32_t i = 0; i < header->parse_action_count;) {
+    const uint16_t *entry = &parse_actions[i * 4];
+    uint16_t count = entry[0];
+    if (count >= header->parse_action_count - i)
+      goto error;
+
+    action_entry_starts[i] = true;
+    actions[i].count = count;
+    actions[i].reusable = entry[1] & ActionEntryReusable;
+    actions[i].depends_on_lookahead = entry[1] & ActionEntryDependsOnLookahead;
+    i++;
+
+    for (uint16_t j = 0; j < count; j++, i++) {
+      const uint16_t *action = &parse_actions[i * 4];
+      if (action[0] > TSParseActionTypeRecover)
+        goto error;
+
+      TSParseAction *result = &actions[i].action;
+      result->type = action[0];
+      result->extra = action[1] & ActionExtra;
+      result->fragile = action[1] & ActionFragile;
+      if (action[0] == TSParseActionTypeReduce) {
+        result->params.symbol = action[2];
+        result->params.child_count = action[3];
+      } else {
+        result->params.to_state = action[2];
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < header->state_count; i++) {
+    modes[i].lex_state = lex_modes[i];
+  }
+
+  if (!binary_language_is_valid(self, header, action_entry_starts))
+    goto error;
+
+  ts_free(action_entry_starts);
+  return language;
+
+error:
+  ts_free(action_entry_starts);
+  ts_language_free(language);
+  return NULL;
+}
+
+void ts_language_free(const TSLanguage *language) {
+  if (!language || language->lex_fn) return;
+  ts_free((void *)language->symbol_metadata);
+  ts_free((void *)language->symbol_names);
+  ts_free((void *)language->parse_actions);
+  ts_free((void *)language->lex_modes);
+  ts_free((void *)language);
+}
@@ -0,0 +1,18 @@
+#ifndef RUNTIME_BINARY_LANGUAGE_H_
+#define RUNTIME_BINARY_LANGUAGE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tree_sitter/parser.h"
+
+// The lex function of languages loaded with `ts_language_load`. It runs the
+// lex table stored in the binary data rather than generated code.
+bool ts_binary_language_lex(const TSLanguage *, TSLexer *, TSStateId);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RUNTIME_BINARY_LANGUAGE_H_
@@ -0,0 +1,39 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "runtime/clock.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+uint64_t clock_now_micros() {
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)count.QuadPart * 1000000 / (uint64_t)frequency.QuadPart;
+}
+
+uint64_t clock_now_nanos() {
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)((double)count.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+}
+
+#else
+
+#include <time.h>
+
+uint64_t clock_now_micros() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000 + (uint64_t)time.tv_nsec / 1000;
+}
+
+uint64_t clock_now_nanos() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+#endif
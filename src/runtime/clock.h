@@ -0,0 +1,20 @@
+#ifndef RUNTIME_CLOCK_H_
+#define RUNTIME_CLOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Returns the value of a monotonic clock, in microseconds.
+uint64_t clock_now_micros();
+
+// Returns the value of a monotonic clock, in nanoseconds.
+uint64_t clock_now_nanos();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RUNTIME_CLOCK_H_
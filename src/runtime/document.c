@@ -3,8 +3,10 @@
 #include "runtime/tree.h"
 #include "runtime/parser.h"
 #include "runtime/string_input.h"
+#include "runtime/file_input.h"
 #include "runtime/document.h"
 #include "runtime/tree_path.h"
+#include "runtime/tree_cursor.h"
 
 TSDocument *ts_document_new() {
   TSDocument *self = ts_calloc(1, sizeof(TSDocument));
@@ -53,6 +55,55 @@ void ts_document_set_logger(TSDocument *self, TSLogger logger) {
   self->parser.lexer.logger = logger;
 }
 
+TSTraceBuffer *ts_document_trace_buffer(const TSDocument *self) {
+  return self->parser.lexer.trace_buffer;
+}
+
+void ts_document_set_trace_buffer(TSDocument *self, TSTraceBuffer *buffer) {
+  self->parser.lexer.trace_buffer = buffer;
+}
+
+void ts_document_set_arena_enabled(TSDocument *self, bool enabled) {
+  if (enabled && !self->parser.tree_arena) {
+    self->parser.tree_arena = ts_tree_arena_new();
+  } else if (!enabled && self->parser.tree_arena) {
+    ts_tree_arena_delete(self->parser.tree_arena);
+    self->parser.tree_arena = NULL;
+  }
+}
+
+const volatile size_t *ts_document_cancellation_flag(const TSDocument *self) {
+  return self->parser.cancellation_flag;
+}
+
+void ts_document_set_cancellation_flag(TSDocument *self, const volatile size_t *flag) {
+  self->parser.cancellation_flag = flag;
+}
+
+uint64_t ts_document_timeout_micros(const TSDocument *self) {
+  return self->parser.timeout_micros;
+}
+
+void ts_document_set_timeout_micros(TSDocument *self, uint64_t timeout_micros) {
+  self->parser.timeout_micros = timeout_micros;
+}
+
+uint32_t ts_document_version_limit(const TSDocument *self) {
+  return self->parser.version_limit;
+}
+
+void ts_document_set_version_limit(TSDocument *self, uint32_t version_limit) {
+  self->parser.version_limit = version_limit;
+}
+
+uint32_t ts_document_lex_limit(const TSDocument *self) {
+  return self->parser.lex_limit;
+}
+
+void ts_document_set_lex_limit(TSDocument *self, uint32_t lex_limit) {
+  self->parser.lex_limit = lex_limit;
+}
+
 void ts_document_print_debugging_graphs(TSDocument *self, bool should_print) {
   self->parser.print_debugging_graphs = should_print;
 }
@@ -62,10 +113,11 @@ TSInput ts_document_input(TSDocument *self) {
 }
 
 void ts_document_set_input(TSDocument *self, TSInput input) {
-  if (self->owns_input)
-    ts_free(self->input.payload);
+  parser_reset(&self->parser);
+  if (self->free_input)
+    self->free_input(self->input.payload);
   self->input = input;
-  self->owns_input = false;
+  self->free_input = NULL;
 }
 
 void ts_document_set_input_string(TSDocument *self, const char *text) {
@@ -73,7 +125,7 @@ void ts_document_set_input_string(TSDocument *self, const char *text) {
   TSInput input = ts_string_input_make(text);
   ts_document_set_input(self, input);
   if (input.payload) {
-    self->owns_input = true;
+    self->free_input = ts_free;
   }
 }
 
@@ -82,11 +134,24 @@ void ts_document_set_input_string_with_length(TSDocument *self, const char *text
   TSInput input = ts_string_input_make_with_length(text, length);
   ts_document_set_input(self, input);
   if (input.payload) {
-    self->owns_input = true;
+    self->free_input = ts_free;
   }
 }
 
+bool ts_document_set_input_file(TSDocument *self, int fd) {
+  TSInput input = ts_file_input_make(fd);
+  if (!input.payload)
+    return false;
+  ts_document_invalidate(self);
+  ts_document_set_input(self, input);
+  self->free_input = ts_file_input_free;
+  return true;
+}
+
 void ts_document_edit(TSDocument *self, TSInputEdit edit) {
+  // A paused parse has read the old text, so it can't be resumed, even if
+  // there is no tree yet for the edit to apply to.
+  parser_reset(&self->parser);
   if (!self->tree)
     return;
 
@@ -99,19 +164,22 @@ void ts_document_edit(TSDocument *self, TSInputEdit edit) {
   ts_tree_edit(self->tree, &edit);
 }
 
-void ts_document_parse_and_get_changed_ranges(TSDocument *self, TSRange **ranges,
+bool ts_document_parse_and_get_changed_ranges(TSDocument *self, TSRange **ranges,
                                               uint32_t *range_count) {
   if (ranges) *ranges = NULL;
   if (range_count) *range_count = 0;
 
+  self->parser.status = TSParseStatusComplete;
   if (!self->input.read || !self->parser.language)
-    return;
+    return true;
 
   Tree *reusable_tree = self->valid ? self->tree : NULL;
   if (reusable_tree && !reusable_tree->has_changes)
-    return;
+    return true;
 
   Tree *tree = parser_parse(&self->parser, self->input, reusable_tree);
+  if (!tree)
+    return false;
 
   if (self->tree) {
     Tree *old_tree = self->tree;
@@ -130,13 +198,15 @@ void ts_document_parse_and_get_changed_ranges(TSDocument *self, TSRange **ranges
   self->tree = tree;
   self->parse_count++;
   self->valid = true;
+  return true;
 }
 
-void ts_document_parse(TSDocument *self) {
-  ts_document_parse_and_get_changed_ranges(self, NULL, NULL);
+bool ts_document_parse(TSDocument *self) {
+  return ts_document_parse_and_get_changed_ranges(self, NULL, NULL);
 }
 
 void ts_document_invalidate(TSDocument *self) {
+  parser_reset(&self->parser);
   self->valid = false;
 }
 
@@ -147,6 +217,22 @@ TSNode ts_document_root_node(const TSDocument *self) {
   return result;
 }
 
+TSTreeCursor *ts_document_tree_cursor(const TSDocument *self) {
+  return ts_tree_cursor_new(self->tree);
+}
+
 uint32_t ts_document_parse_count(const TSDocument *self) {
   return self->parse_count;
 }
+
+TSParseStatus ts_document_parse_status(const TSDocument *self) {
+  return self->parser.status;
+}
+
+TSParseStats ts_document_parse_stats(const TSDocument *self) {
+  return parser_stats(&self->parser);
+}
+
+void ts_document_set_phase_timing_enabled(TSDocument *self, bool enabled) {
+  self->parser.time_phases = enabled;
+}
@@ -11,7 +11,7 @@ struct TSDocument {
   Tree *tree;
   size_t parse_count;
   bool valid;
-  bool owns_input;
+  void (*free_input)(void *);
 };
 
 #endif
@@ -0,0 +1,115 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "runtime/file_input.h"
+#include "runtime/alloc.h"
+
+#ifndef _WIN32
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The number of pages handed to the lexer in each chunk.
+#define CHUNK_PAGE_COUNT 256
+
+typedef struct {
+  const char *contents;
+  uint32_t length;
+  uint32_t position;
+  uint32_t chunk_size;
+  bool is_sequential;
+} TSFileInput;
+
+const char *ts_file_input_read(void *payload, uint32_t *bytes_read) {
+  TSFileInput *input = (TSFileInput *)payload;
+  if (input->position >= input->length) {
+    *bytes_read = 0;
+    return "";
+  }
+
+  // Chunks end on page boundaries, except that a chunk is extended past its
+  // boundary rather than splitting a multi-byte character.
+  uint32_t chunk_end = (input->position / input->chunk_size + 1) * input->chunk_size;
+  if (chunk_end > input->length || chunk_end < input->position)
+    chunk_end = input->length;
+  while (chunk_end < input->length && (input->contents[chunk_end] & 0xc0) == 0x80)
+    chunk_end++;
+
+  uint32_t previous_position = input->position;
+  input->position = chunk_end;
+  *bytes_read = chunk_end - previous_position;
+  return input->contents + previous_position;
+}
+
+int ts_file_input_seek(void *payload, uint32_t character, uint32_t byte) {
+  TSFileInput *input = (TSFileInput *)payload;
+
+  // The first parse reads the file from start to end, but later parses only
+  // read the regions around edits.
+  if (byte < input->position && input->is_sequential) {
+    posix_madvise((void *)input->contents, input->length, POSIX_MADV_NORMAL);
+    input->is_sequential = false;
+  }
+
+  input->position = byte;
+  return (byte < input->length);
+}
+
+TSInput ts_file_input_make(int fd) {
+  TSFileInput *input = NULL;
+  struct stat file_stat;
+
+  // Only regular files can be mapped. Pipes, sockets and terminals report a
+  // size of zero, so they would otherwise be read as empty files.
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+      file_stat.st_size > UINT32_MAX)
+    goto error;
+
+  input = ts_malloc(sizeof(TSFileInput));
+  if (!input)
+    goto error;
+
+  input->contents = "";
+  input->length = file_stat.st_size;
+  input->position = 0;
+  input->chunk_size = CHUNK_PAGE_COUNT * sysconf(_SC_PAGESIZE);
+  input->is_sequential = false;
+
+  if (input->length > 0) {
+    void *contents = mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (contents == MAP_FAILED)
+      goto error;
+    posix_madvise(contents, input->length, POSIX_MADV_SEQUENTIAL);
+    input->contents = contents;
+    input->is_sequential = true;
+  }
+
+  return (TSInput){
+    .payload = input,
+    .read = ts_file_input_read,
+    .seek = ts_file_input_seek,
+    .encoding = TSInputEncodingUTF8,
+  };
+
+error:
+  if (input)
+    ts_free(input);
+  return (TSInput){ NULL, NULL, NULL, TSInputEncodingUTF8 };
+}
+
+void ts_file_input_free(void *payload) {
+  TSFileInput *input = (TSFileInput *)payload;
+  if (input->length > 0)
+    munmap((void *)input->contents, input->length);
+  ts_free(input);
+}
+
+#else
+
+TSInput ts_file_input_make(int fd) {
+  return (TSInput){ NULL, NULL, NULL, TSInputEncodingUTF8 };
+}
+
+void ts_file_input_free(void *payload) {}
+
+#endif
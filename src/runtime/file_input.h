@@ -0,0 +1,17 @@
+#ifndef RUNTIME_FILE_INPUT_H_
+#define RUNTIME_FILE_INPUT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tree_sitter/runtime.h"
+
+TSInput ts_file_input_make(int fd);
+void ts_file_input_free(void *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RUNTIME_FILE_INPUT_H_
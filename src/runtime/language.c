@@ -20,7 +20,7 @@ void ts_language_table_entry(const TSLanguage *self, TSStateId state,
     action_index = 0;
   } else {
     assert(symbol < self->token_count);
-    action_index = self->parse_table[state * self->symbol_count + symbol];
+    action_index = ts_language_lookup(self, state, symbol);
   }
 
   const TSParseActionEntry *entry = &self->parse_actions[action_index];
@@ -7,6 +7,7 @@ extern "C" {
 
 #include "tree_sitter/parser.h"
 #include "runtime/tree.h"
+#include "runtime/binary_language.h"
 
 typedef struct {
   const TSParseAction *actions;
@@ -23,6 +24,30 @@ static inline bool ts_language_is_symbol_external(const TSLanguage *self, TSSymb
   return 0 < symbol && symbol < self->external_token_count + 1;
 }
 
+// Large states are stored as rows of a dense table, indexed by symbol. Each
+// small state is stored as a list of groups, each consisting of a value, a
+// symbol count and the symbols that map to that value.
+static inline uint16_t ts_language_lookup(const TSLanguage *self,
+                                          TSStateId state, TSSymbol symbol) {
+  if (state < self->large_state_count) {
+    return self->parse_table[state * self->symbol_count + symbol];
+  }
+
+  const uint16_t *data = &self->small_parse_table[
+    self->small_parse_table_map[state - self->large_state_count]
+  ];
+  uint16_t group_count = *(data++);
+  for (unsigned i = 0; i < group_count; i++) {
+    uint16_t value = *(data++);
+    uint16_t symbol_count = *(data++);
+    for (unsigned j = 0; j < symbol_count; j++) {
+      if (data[j] == symbol) return value;
+    }
+    data += symbol_count;
+  }
+  return 0;
+}
+
 static inline const TSParseAction *ts_language_actions(const TSLanguage *self,
                                                        TSStateId state,
                                                        TSSymbol symbol,
@@ -49,7 +74,16 @@ static inline TSStateId ts_language_next_state(const TSLanguage *self,
     }
     return 0;
   } else {
-    return self->parse_table[state * self->symbol_count + symbol];
+    return ts_language_lookup(self, state, symbol);
+  }
+}
+
+static inline bool ts_language_lex(const TSLanguage *self, TSLexer *lexer,
+                                   TSStateId lex_state) {
+  if (self->lex_fn) {
+    return self->lex_fn(lexer, lex_state);
+  } else {
+    return ts_binary_language_lex(self, lexer, lex_state);
   }
 }
 
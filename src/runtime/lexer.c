@@ -1,18 +1,29 @@
-#include <stdio.h>
+#include <string.h>
 #include "runtime/lexer.h"
 #include "runtime/tree.h"
+#include "runtime/trace.h"
 #include "runtime/length.h"
 #include "runtime/utf16.h"
-//#include "utf8proc.h"
+#include "runtime/utf8.h"
 
-#define LOG(...)                                                              \
-  if (self->logger.log) {                                                     \
-    snprintf(self->debug_buffer, TS_DEBUG_BUFFER_SIZE, __VA_ARGS__);          \
-    self->logger.log(self->logger.payload, TSLogTypeLex, self->debug_buffer); \
+static void ts_lexer__log_character(Lexer *self, TSTraceEventType type) {
+  TSTraceEvent event = {
+    .type = type,
+    .byte_offset = self->current_position.bytes,
+    .point = self->current_position.extent,
+    .arguments = {self->data.lookahead, 0},
+  };
+  if (self->trace_buffer)
+    ts_trace_buffer_push(self->trace_buffer, event);
+  if (self->logger.log) {
+    ts_trace_event_format(&event, NULL, self->debug_buffer, TS_DEBUG_BUFFER_SIZE);
+    self->logger.log(self->logger.payload, TSLogTypeLex, self->debug_buffer);
   }
+}
 
-#define LOG_CHARACTER(message, character) \
-  LOG(character < 255 ? message " character:'%c'" : message " character:%d", character)
+#define LOG_CHARACTER(type)                  \
+  if (self->trace_buffer || self->logger.log) \
+    ts_lexer__log_character(self, type)
 
 static const char empty_chunk[2] = { 0, 0 };
 
@@ -27,6 +38,8 @@ static void ts_lexer__get_chunk(Lexer *self) {
 
   self->chunk_start = self->current_position.bytes;
   self->chunk = input.read(input.payload, &self->chunk_size);
+  self->ascii_run_start = 0;
+  self->ascii_run_end = 0;
   if (!self->chunk_size)
     self->chunk = empty_chunk;
 }
@@ -36,13 +49,34 @@ static void ts_lexer__get_lookahead(Lexer *self) {
   const uint8_t *chunk = (const uint8_t *)self->chunk + position_in_chunk;
   uint32_t size = self->chunk_size - position_in_chunk + 1;
 
-  if (self->input.encoding == TSInputEncodingUTF8)
-    exit(0);
-    // I've removed utf8 support
-    //self->lookahead_size =
-    //  utf8proc_iterate(chunk, size, &self->data.lookahead);
-  else
+  if (self->input.encoding == TSInputEncodingUTF8) {
+    // Within a run of bytes already known to be ASCII, each byte is its own
+    // character. When the position leaves the run, in either direction, find
+    // the end of the next one a block at a time, so that only multi-byte
+    // characters need decoding. The lexer can move backwards within a chunk
+    // when it is reset, so the run's start is checked as well as its end.
+    uint32_t remaining = size - 1;
+    bool in_ascii_run = position_in_chunk >= self->ascii_run_start &&
+                        position_in_chunk < self->ascii_run_end;
+    if (!in_ascii_run && remaining > 0) {
+      self->ascii_run_start = position_in_chunk;
+      self->ascii_run_end =
+        position_in_chunk + utf8_ascii_prefix_length(chunk, remaining);
+      in_ascii_run = position_in_chunk < self->ascii_run_end;
+    }
+
+    if (in_ascii_run) {
+      self->data.lookahead = *chunk;
+      self->lookahead_size = 1;
+    } else if (remaining > 0) {
+      self->lookahead_size = utf8_iterate(chunk, remaining, &self->data.lookahead);
+    } else {
+      self->data.lookahead = 0;
+      self->lookahead_size = 1;
+    }
+  } else {
     self->lookahead_size = utf16_iterate(chunk, size, &self->data.lookahead);
+  }
 }
 
 static void ts_lexer__advance(void *payload, bool skip) {
@@ -62,10 +96,10 @@ static void ts_lexer__advance(void *payload, bool skip) {
   }
 
   if (skip) {
-    LOG_CHARACTER("skip", self->data.lookahead);
+    LOG_CHARACTER(TSTraceEventSkipCharacter);
     self->token_start_position = self->current_position;
   } else {
-    LOG_CHARACTER("consume", self->data.lookahead);
+    LOG_CHARACTER(TSTraceEventConsumeCharacter);
   }
 
   if (self->current_position.bytes >= self->chunk_start + self->chunk_size)
@@ -74,26 +108,150 @@ static void ts_lexer__advance(void *payload, bool skip) {
   ts_lexer__get_lookahead(self);
 }
 
+static inline bool ts_lexer__class_contains(const TSCharacterClass *class,
+                                            int32_t character) {
+  if (character < 0)
+    return false;
+  if (character < 128)
+    return class->ascii[character / 32] & (1u << (character % 32));
+  return class->non_ascii;
+}
+
+// Character classes like the bodies of comments often exclude only a single
+// ASCII character. Returns that character, or -1 if there is none.
+static int ts_lexer__class_delimiter(const TSCharacterClass *class) {
+  if (!class->non_ascii)
+    return -1;
+
+  int result = -1;
+  for (int i = 0; i < 4; i++) {
+    uint32_t excluded = ~class->ascii[i];
+    if (!excluded)
+      continue;
+    if (result != -1 || (excluded & (excluded - 1)))
+      return -1;
+    result = i * 32 + __builtin_ctz(excluded);
+  }
+  return result;
+}
+
+// Returns the end of the longest run of UTF8 text starting at `string` whose
+// characters all belong to the given class. Invalid and incomplete sequences
+// end the run, so that they are handled one character at a time.
+static const uint8_t *ts_lexer__scan_class(const TSCharacterClass *class,
+                                           const uint8_t *string,
+                                           const uint8_t *end) {
+  int delimiter = ts_lexer__class_delimiter(class);
+  if (delimiter != -1) {
+    const uint8_t *delimiter_position = memchr(string, delimiter, end - string);
+    if (delimiter_position)
+      end = delimiter_position;
+  }
+
+  while (string < end) {
+    if (*string < 0x80) {
+      if (delimiter != -1) {
+        string += utf8_ascii_prefix_length(string, end - string);
+      } else if (ts_lexer__class_contains(class, *string)) {
+        string++;
+      } else {
+        break;
+      }
+    } else {
+      int32_t code_point;
+      if (!class->non_ascii)
+        break;
+      uint32_t size = utf8_iterate(string, end - string, &code_point);
+      if (code_point < 0)
+        break;
+      string += size;
+    }
+  }
+
+  return string;
+}
+
+static void ts_lexer__advance_over(Lexer *self, const uint8_t *start,
+                                   const uint8_t *end, bool may_contain_newlines) {
+  const uint8_t *line_start = start;
+  if (may_contain_newlines) {
+    const uint8_t *newline;
+    while ((newline = memchr(line_start, '\n', end - line_start))) {
+      self->current_position.extent.row++;
+      line_start = newline + 1;
+    }
+  }
+
+  uint32_t last_line_chars = utf8_char_count(line_start, end - line_start);
+  if (line_start == start) {
+    self->current_position.extent.column += last_line_chars;
+  } else {
+    self->current_position.extent.column = last_line_chars;
+  }
+
+  self->current_position.bytes += end - start;
+  self->current_position.chars +=
+    utf8_char_count(start, line_start - start) + last_line_chars;
+}
+
+static void ts_lexer__advance_while(void *payload, const TSCharacterClass *class,
+                                    bool skip) {
+  Lexer *self = (Lexer *)payload;
+  ts_lexer__advance(self, skip);
+
+  // Scanning in bulk bypasses the per-character log messages and trace
+  // events, and only understands UTF8.
+  if (self->logger.log || self->trace_buffer ||
+      self->input.encoding != TSInputEncodingUTF8) {
+    while (self->chunk != empty_chunk &&
+           ts_lexer__class_contains(class, self->data.lookahead))
+      ts_lexer__advance(self, skip);
+    return;
+  }
+
+  bool may_contain_newlines = ts_lexer__class_contains(class, '\n');
+  while (self->chunk != empty_chunk &&
+         ts_lexer__class_contains(class, self->data.lookahead)) {
+    const uint8_t *chunk = (const uint8_t *)self->chunk;
+    const uint8_t *start = chunk + (self->current_position.bytes - self->chunk_start);
+    const uint8_t *end = ts_lexer__scan_class(class, start, chunk + self->chunk_size);
+    if (end == start) {
+      ts_lexer__advance(self, skip);
+      continue;
+    }
+
+    ts_lexer__advance_over(self, start, end, may_contain_newlines);
+    if (skip)
+      self->token_start_position = self->current_position;
+    if (self->current_position.bytes >= self->chunk_start + self->chunk_size)
+      ts_lexer__get_chunk(self);
+    ts_lexer__get_lookahead(self);
+  }
+}
+
 static void ts_lexer__mark_end(void *payload) {
   Lexer *self = (Lexer *)payload;
   self->token_end_position = self->current_position;
 }
 
 /*
- *  The lexer's advance method is stored as a struct field so that generated
- *  parsers can call it without needing to be linked against this library.
+ *  The lexer's advance methods are stored as struct fields so that generated
+ *  parsers can call them without needing to be linked against this library.
  */
 
 void ts_lexer_init(Lexer *self) {
   *self = (Lexer){
     .data = {
       .advance = ts_lexer__advance,
+      .advance_while = ts_lexer__advance_while,
       .mark_end = ts_lexer__mark_end,
       .lookahead = 0,
       .result_symbol = 0,
     },
     .chunk = NULL,
     .chunk_start = 0,
+    .ascii_run_start = 0,
+    .ascii_run_end = 0,
     .logger = {
       .payload = NULL,
       .log = NULL
@@ -113,6 +271,8 @@ static inline void ts_lexer__reset(Lexer *self, Length position) {
     self->chunk = 0;
     self->chunk_start = 0;
     self->chunk_size = 0;
+    self->ascii_run_start = 0;
+    self->ascii_run_end = 0;
   }
 
   self->lookahead_size = 0;
@@ -121,6 +281,11 @@ static inline void ts_lexer__reset(Lexer *self, Length position) {
 
 void ts_lexer_set_input(Lexer *self, TSInput input) {
   self->input = input;
+  self->chunk = 0;
+  self->chunk_start = 0;
+  self->chunk_size = 0;
+  self->ascii_run_start = 0;
+  self->ascii_run_end = 0;
   ts_lexer__reset(self, length_zero());
   self->last_external_token_state = NULL;
 }
@@ -21,9 +21,12 @@ typedef struct {
   uint32_t chunk_start;
   uint32_t chunk_size;
   uint32_t lookahead_size;
+  uint32_t ascii_run_start;
+  uint32_t ascii_run_end;
 
   TSInput input;
   TSLogger logger;
+  TSTraceBuffer *trace_buffer;
   char debug_buffer[TS_DEBUG_BUFFER_SIZE];
   const TSExternalTokenState *last_external_token_state;
 } Lexer;
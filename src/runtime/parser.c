@@ -10,20 +10,22 @@
 #include "runtime/array.h"
 #include "runtime/language.h"
 #include "runtime/alloc.h"
+#include "runtime/atomic.h"
+#include "runtime/clock.h"
+#include "runtime/trace.h"
 #include "runtime/reduce_action.h"
 #include "runtime/error_costs.h"
 
-#define LOG(...)                                                           \
-  if (self->lexer.logger.log) {                                            \
-    snprintf(self->lexer.debug_buffer, TS_DEBUG_BUFFER_SIZE, __VA_ARGS__); \
-    self->lexer.logger.log(self->lexer.logger.payload, TSLogTypeParse,     \
-                           self->lexer.debug_buffer);                      \
-  }                                                                        \
-  if (self->print_debugging_graphs) {                                      \
-    fprintf(stderr, "graph {\nlabel=\"");                                  \
-    fprintf(stderr, __VA_ARGS__);                                          \
-    fprintf(stderr, "\"\n}\n\n");                                          \
-  }
+// The number of parsing rounds between each check of the clock. Checking the
+// clock is comparatively expensive, so it is not done on every round.
+#define OP_COUNT_PER_TIMEOUT_CHECK 100
+
+#define LOG_EVENT_AT(position, ...)                          \
+  if (self->lexer.trace_buffer || self->lexer.logger.log ||  \
+      self->print_debugging_graphs)                          \
+    parser__log_event(self, position, (TSTraceEvent){__VA_ARGS__})
+
+#define LOG_EVENT(...) LOG_EVENT_AT(self->lexer.current_position, __VA_ARGS__)
 
 #define LOG_STACK()                                                     \
   if (self->print_debugging_graphs) {                                   \
@@ -38,7 +40,35 @@
     fputs("\n", stderr);                                                  \
   }
 
-#define SYM_NAME(symbol) ts_language_symbol_name(self->language, symbol)
+// Every action is recorded as a fixed-size event. The text log and the debug
+// graphs render the same events that are written to the trace buffer, so a
+// trace can be decoded offline into exactly the messages a logger would see.
+static void parser__log_event(Parser *self, Length position, TSTraceEvent event) {
+  event.byte_offset = position.bytes;
+  event.point = position.extent;
+  if (self->lexer.trace_buffer)
+    ts_trace_buffer_push(self->lexer.trace_buffer, event);
+
+  if (self->lexer.logger.log || self->print_debugging_graphs) {
+    ts_trace_event_format(&event, self->language, self->lexer.debug_buffer,
+                          TS_DEBUG_BUFFER_SIZE);
+    if (self->lexer.logger.log)
+      self->lexer.logger.log(self->lexer.logger.payload, TSLogTypeParse,
+                             self->lexer.debug_buffer);
+    if (self->print_debugging_graphs)
+      fprintf(stderr, "graph {\nlabel=\"%s\"\n}\n\n", self->lexer.debug_buffer);
+  }
+}
+
+// Phase timers read the clock only when phase timing is enabled, so that the
+// statistics cost a single predictable branch per phase when it is not.
+static inline uint64_t parser__start_timer(Parser *self) {
+  return self->time_phases ? clock_now_nanos() : 0;
+}
+
+static inline void parser__stop_timer(Parser *self, uint64_t start, uint64_t *total) {
+  if (self->time_phases) *total += clock_now_nanos() - start;
+}
 
 typedef struct {
   Parser *parser;
@@ -96,7 +126,7 @@ static bool parser__breakdown_top_of_stack(Parser *self, StackVersion version) {
         parser__push(self, slice.version, tree, state);
       }
 
-      LOG("breakdown_top_of_stack tree:%s", SYM_NAME(parent->symbol));
+      LOG_EVENT(.type = TSTraceEventBreakdownTopOfStack, .symbol = parent->symbol);
       LOG_STACK();
 
       ts_stack_decrease_push_count(self->stack, slice.version,
@@ -117,7 +147,7 @@ static bool parser__breakdown_lookahead(Parser *self, Tree **lookahead,
          (self->is_split || reusable_node->tree->parse_state != state ||
           reusable_node->tree->fragile_left ||
           reusable_node->tree->fragile_right)) {
-    LOG("state_mismatch sym:%s", SYM_NAME(reusable_node->tree->symbol));
+    LOG_EVENT(.type = TSTraceEventStateMismatch, .symbol = reusable_node->tree->symbol);
     reusable_node_breakdown(reusable_node);
     result = true;
   }
@@ -148,7 +178,42 @@ static bool parser__can_reuse(Parser *self, TSStateId state, Tree *tree,
     return false;
   if (!table_entry->depends_on_lookahead)
     return true;
-  return tree->child_count > 1 && tree->error_cost == 0;
+  return tree->child_count > 1 && ts_tree_error_cost(tree) == 0;
+}
+
+// When the document has a version limit, the versions that are most likely to
+// be discarded anyway are dropped first: those with the greatest error cost and,
+// among those, the ones that have pushed the fewest trees since their last
+// error. Ties are broken by dropping the most recently created version.
+static bool parser__error_status_is_costlier(ErrorStatus a, ErrorStatus b) {
+  if (a.cost != b.cost)
+    return a.cost > b.cost;
+  if (a.count != b.count)
+    return a.count > b.count;
+  return a.push_count <= b.push_count;
+}
+
+static bool parser__prune_versions(Parser *self) {
+  bool result = false;
+  while (self->version_limit > 0 &&
+         ts_stack_version_count(self->stack) > self->version_limit) {
+    StackVersion costliest_version = 0;
+    ErrorStatus costliest_status = ts_stack_error_status(self->stack, 0);
+    for (StackVersion i = 1, n = ts_stack_version_count(self->stack); i < n; i++) {
+      ErrorStatus status = ts_stack_error_status(self->stack, i);
+      if (parser__error_status_is_costlier(status, costliest_status)) {
+        costliest_version = i;
+        costliest_status = status;
+      }
+    }
+
+    LOG_EVENT(.type = TSTraceEventDropVersion,
+              .arguments = {costliest_version, costliest_status.cost});
+    ts_stack_remove_version(self->stack, costliest_version);
+    self->stats.dropped_version_count++;
+    result = true;
+  }
+  return result;
 }
 
 static bool parser__condense_stack(Parser *self) {
@@ -165,6 +230,7 @@ static bool parser__condense_stack(Parser *self) {
 
     for (StackVersion j = 0; j < i; j++) {
       if (ts_stack_merge(self->stack, j, i)) {
+        self->stats.merge_count++;
         result = true;
         i--;
         break;
@@ -186,13 +252,16 @@ static bool parser__condense_stack(Parser *self) {
       }
     }
   }
+
+  if (parser__prune_versions(self))
+    result = true;
   return result;
 }
 
 static void parser__restore_external_scanner(Parser *self, StackVersion version) {
   const TSExternalTokenState *state = ts_stack_external_token_state(self->stack, version);
   if (self->lexer.last_external_token_state != state) {
-    LOG("restore_external_scanner");
+    LOG_EVENT(.type = TSTraceEventRestoreExternalScanner);
     self->lexer.last_external_token_state = state;
     if (state) {
       self->language->external_scanner.deserialize(
@@ -225,10 +294,11 @@ static Tree *parser__lex(Parser *self, StackVersion version) {
     Length current_position = self->lexer.current_position;
 
     if (valid_external_tokens) {
-      LOG("lex_external state:%d, row:%u, column:%u", lex_mode.external_lex_state,
-          current_position.extent.row, current_position.extent.column);
+      LOG_EVENT_AT(current_position, .type = TSTraceEventLexExternal,
+                   .state = lex_mode.external_lex_state);
       parser__restore_external_scanner(self, version);
       ts_lexer_start(&self->lexer);
+      self->stats.external_scan_count++;
       if (self->language->external_scanner.scan(self->external_scanner_payload,
                                                 &self->lexer.data, valid_external_tokens)) {
         found_external_token = true;
@@ -237,15 +307,15 @@ static Tree *parser__lex(Parser *self, StackVersion version) {
       ts_lexer_reset(&self->lexer, current_position);
     }
 
-    LOG("lex_internal state:%d, row:%u, column:%u", lex_mode.lex_state,
-        current_position.extent.row, current_position.extent.column);
+    LOG_EVENT_AT(current_position, .type = TSTraceEventLexInternal,
+                 .state = lex_mode.lex_state);
     ts_lexer_start(&self->lexer);
-    if (self->language->lex_fn(&self->lexer.data, lex_mode.lex_state)) {
+    if (ts_language_lex(self->language, &self->lexer.data, lex_mode.lex_state)) {
       break;
     }
 
     if (!found_error) {
-      LOG("retry_in_error_mode");
+      LOG_EVENT(.type = TSTraceEventRetryInErrorMode);
       found_error = true;
       lex_mode = self->language->lex_modes[ERROR_STATE];
       valid_external_tokens = ts_language_enabled_external_tokens(
@@ -257,7 +327,7 @@ static Tree *parser__lex(Parser *self, StackVersion version) {
     }
 
     if (!skipped_error) {
-      LOG("skip_unrecognized_character");
+      LOG_EVENT(.type = TSTraceEventSkipUnrecognizedCharacter);
       skipped_error = true;
       error_start_position = self->lexer.token_start_position;
       error_end_position = self->lexer.token_start_position;
@@ -279,7 +349,7 @@ static Tree *parser__lex(Parser *self, StackVersion version) {
   if (skipped_error) {
     Length padding = length_sub(error_start_position, start_position);
     Length size = length_sub(error_end_position, error_start_position);
-    result = ts_tree_make_error(size, padding, first_error_character);
+    result = ts_tree_make_error(self->tree_arena, size, padding, first_error_character);
   } else {
     TSSymbol symbol = self->lexer.data.result_symbol;
     if (found_external_token) {
@@ -292,30 +362,27 @@ static Tree *parser__lex(Parser *self, StackVersion version) {
     Length padding = length_sub(self->lexer.token_start_position, start_position);
     Length size = length_sub(self->lexer.token_end_position, self->lexer.token_start_position);
     TSSymbolMetadata metadata = ts_language_symbol_metadata(self->language, symbol);
-    result = ts_tree_make_leaf(symbol, padding, size, metadata);
-
     if (found_external_token) {
-      result->has_external_tokens = true;
-      result->has_external_token_state = true;
+      result = ts_tree_make_external_leaf(self->tree_arena, symbol, padding, size, metadata);
       memset(result->external_token_state, 0, sizeof(TSExternalTokenState));
       self->language->external_scanner.serialize(self->external_scanner_payload, result->external_token_state);
       self->lexer.last_external_token_state = &result->external_token_state;
+    } else {
+      result = ts_tree_make_leaf(self->tree_arena, symbol, padding, size, metadata);
     }
   }
 
   result->bytes_scanned = self->lexer.current_position.bytes - start_position.bytes + 1;
+  self->stats.lex_count++;
+  self->stats.bytes_lexed += self->lexer.current_position.bytes - start_position.bytes;
   result->parse_state = parse_state;
   result->first_leaf.lex_mode = lex_mode;
 
-  LOG("lexed_lookahead sym:%s, size:%u", SYM_NAME(result->symbol), result->size.bytes);
+  LOG_EVENT(.type = TSTraceEventLexedLookahead, .symbol = result->symbol,
+            .arguments = {result->size.bytes});
   return result;
 }
 
-static void parser__clear_cached_token(Parser *self) {
-  ts_tree_release(self->cached_token);
-  self->cached_token = NULL;
-}
-
 static Tree *parser__get_lookahead(Parser *self, StackVersion version,
                                    ReusableNode *reusable_node,
                                    bool *is_fresh) {
@@ -323,20 +390,22 @@ static Tree *parser__get_lookahead(Parser *self, StackVersion version,
 
   while (reusable_node->tree) {
     if (reusable_node->byte_index > position.bytes) {
-      LOG("before_reusable_node sym:%s", SYM_NAME(reusable_node->tree->symbol));
+      LOG_EVENT(.type = TSTraceEventBeforeReusableNode,
+                .symbol = reusable_node->tree->symbol);
       break;
     }
 
     if (reusable_node->byte_index < position.bytes) {
-      LOG("past_reusable sym:%s", SYM_NAME(reusable_node->tree->symbol));
+      LOG_EVENT(.type = TSTraceEventPastReusable,
+                .symbol = reusable_node->tree->symbol);
       reusable_node_pop(reusable_node);
       continue;
     }
 
     if (reusable_node->tree->has_changes) {
-      LOG("cant_reuse_changed tree:%s, size:%u",
-          SYM_NAME(reusable_node->tree->symbol),
-          reusable_node->tree->size.bytes);
+      LOG_EVENT(.type = TSTraceEventCantReuseChanged,
+                .symbol = reusable_node->tree->symbol,
+                .arguments = {reusable_node->tree->size.bytes});
       if (!reusable_node_breakdown(reusable_node)) {
         reusable_node_pop(reusable_node);
         parser__breakdown_top_of_stack(self, version);
@@ -345,9 +414,9 @@ static Tree *parser__get_lookahead(Parser *self, StackVersion version,
     }
 
     if (reusable_node->tree->symbol == ts_builtin_sym_error) {
-      LOG("cant_reuse_error tree:%s, size:%u",
-          SYM_NAME(reusable_node->tree->symbol),
-          reusable_node->tree->size.bytes);
+      LOG_EVENT(.type = TSTraceEventCantReuseError,
+                .symbol = reusable_node->tree->symbol,
+                .arguments = {reusable_node->tree->size.bytes});
       if (!reusable_node_breakdown(reusable_node)) {
         reusable_node_pop(reusable_node);
         parser__breakdown_top_of_stack(self, version);
@@ -358,9 +427,9 @@ static Tree *parser__get_lookahead(Parser *self, StackVersion version,
     if (!ts_external_token_state_eq(
           reusable_node->preceding_external_token_state,
           ts_stack_external_token_state(self->stack, version))) {
-      LOG("cant_reuse_external_tokens tree:%s, size:%u",
-          SYM_NAME(reusable_node->tree->symbol),
-          reusable_node->tree->size.bytes);
+      LOG_EVENT(.type = TSTraceEventCantReuseExternalTokens,
+                .symbol = reusable_node->tree->symbol,
+                .arguments = {reusable_node->tree->size.bytes});
       if (!reusable_node_breakdown(reusable_node)) {
         reusable_node_pop(reusable_node);
         parser__breakdown_top_of_stack(self, version);
@@ -373,13 +442,26 @@ static Tree *parser__get_lookahead(Parser *self, StackVersion version,
     return result;
   }
 
-  if (self->cached_token && position.bytes == self->cached_token_byte_index) {
-    ts_tree_retain(self->cached_token);
-    return self->cached_token;
+  TSLexMode lex_mode = self->language->lex_modes[ts_stack_top_state(self->stack, version)];
+  const TSExternalTokenState *external_token_state =
+    ts_stack_external_token_state(self->stack, version);
+  *is_fresh = true;
+
+  Tree *result = ts_token_cache_get(&self->token_cache, position.bytes,
+                                    lex_mode, external_token_state);
+  if (result) {
+    LOG_EVENT(.type = TSTraceEventCachedLookahead, .symbol = result->symbol,
+              .arguments = {result->size.bytes});
+    ts_tree_retain(result);
+    return result;
   }
 
-  *is_fresh = true;
-  return parser__lex(self, version);
+  uint64_t start_time = parser__start_timer(self);
+  result = parser__lex(self, version);
+  parser__stop_timer(self, start_time, &self->stats.lex_nanos);
+  ts_token_cache_set(&self->token_cache, position.bytes, lex_mode,
+                     external_token_state, result);
+  return result;
 }
 
 static bool parser__select_tree(Parser *self, Tree *left, Tree *right) {
@@ -387,31 +469,31 @@ static bool parser__select_tree(Parser *self, Tree *left, Tree *right) {
     return true;
   if (!right)
     return false;
-  if (right->error_cost < left->error_cost) {
-    LOG("select_smaller_error symbol:%s, over_symbol:%s",
-        SYM_NAME(right->symbol), SYM_NAME(left->symbol));
+  if (ts_tree_error_cost(right) < ts_tree_error_cost(left)) {
+    LOG_EVENT(.type = TSTraceEventSelectSmallerError, .symbol = right->symbol,
+              .other_symbol = left->symbol);
     return true;
   }
-  if (left->error_cost < right->error_cost) {
-    LOG("select_smaller_error symbol:%s, over_symbol:%s",
-        SYM_NAME(left->symbol), SYM_NAME(right->symbol));
+  if (ts_tree_error_cost(left) < ts_tree_error_cost(right)) {
+    LOG_EVENT(.type = TSTraceEventSelectSmallerError, .symbol = left->symbol,
+              .other_symbol = right->symbol);
     return false;
   }
 
   int comparison = ts_tree_compare(left, right);
   switch (comparison) {
     case -1:
-      LOG("select_earlier symbol:%s, over_symbol:%s", SYM_NAME(left->symbol),
-          SYM_NAME(right->symbol));
+      LOG_EVENT(.type = TSTraceEventSelectEarlier, .symbol = left->symbol,
+                .other_symbol = right->symbol);
       return false;
       break;
     case 1:
-      LOG("select_earlier symbol:%s, over_symbol:%s", SYM_NAME(right->symbol),
-          SYM_NAME(left->symbol));
+      LOG_EVENT(.type = TSTraceEventSelectEarlier, .symbol = right->symbol,
+                .other_symbol = left->symbol);
       return true;
     default:
-      LOG("select_existing symbol:%s, over_symbol:%s", SYM_NAME(left->symbol),
-          SYM_NAME(right->symbol));
+      LOG_EVENT(.type = TSTraceEventSelectExisting, .symbol = left->symbol,
+                .other_symbol = right->symbol);
       return false;
   }
 }
@@ -419,7 +501,7 @@ static bool parser__select_tree(Parser *self, Tree *left, Tree *right) {
 static bool parser__better_version_exists(Parser *self, StackVersion version,
                                           ErrorStatus my_error_status) {
   if (self->finished_tree &&
-      self->finished_tree->error_cost <= my_error_status.cost)
+      ts_tree_error_cost(self->finished_tree) <= my_error_status.cost)
     return true;
 
   for (StackVersion i = 0, n = ts_stack_version_count(self->stack); i < n; i++) {
@@ -429,7 +511,7 @@ static bool parser__better_version_exists(Parser *self, StackVersion version,
     switch (error_status_compare(my_error_status,
                                  ts_stack_error_status(self->stack, i))) {
       case -1:
-        LOG("halt_other version:%u", i);
+        LOG_EVENT(.type = TSTraceEventHaltOther, .arguments = {i});
         ts_stack_halt(self->stack, i);
         break;
       case 1:
@@ -442,11 +524,13 @@ static bool parser__better_version_exists(Parser *self, StackVersion version,
 
 static void parser__shift(Parser *self, StackVersion version, TSStateId state,
                           Tree *lookahead, bool extra) {
+  self->stats.shift_count++;
   if (extra != lookahead->extra) {
     TSSymbolMetadata metadata =
       ts_language_symbol_metadata(self->language, lookahead->symbol);
-    if (metadata.structural && ts_stack_version_count(self->stack) > 1) {
-      lookahead = ts_tree_make_copy(lookahead);
+    if (metadata.structural &&
+        (ts_stack_version_count(self->stack) > 1 || atomic_load(&lookahead->ref_count) > 1)) {
+      lookahead = ts_tree_make_copy(self->tree_arena, lookahead);
     } else {
       ts_tree_retain(lookahead);
     }
@@ -477,6 +561,7 @@ static bool parser__switch_children(Parser *self, Tree *tree,
     tree->child_count = self->scratch_tree.child_count;
     tree->named_child_count = self->scratch_tree.named_child_count;
     tree->visible_child_count = self->scratch_tree.visible_child_count;
+    tree->repeat_depth = self->scratch_tree.repeat_depth;
     return true;
   } else {
     return false;
@@ -487,6 +572,7 @@ static StackPopResult parser__reduce(Parser *self, StackVersion version,
                                      TSSymbol symbol, unsigned count,
                                      bool fragile, bool allow_skipping) {
   uint32_t initial_version_count = ts_stack_version_count(self->stack);
+  self->stats.reduce_count++;
 
   StackPopResult pop = ts_stack_pop_count(self->stack, version, count);
   if (pop.stopped_at_error)
@@ -505,7 +591,8 @@ static StackPopResult parser__reduce(Parser *self, StackVersion version,
     while (child_count > 0 && slice.trees.contents[child_count - 1]->extra)
       child_count--;
 
-    Tree *parent = ts_tree_make_node(symbol, child_count, slice.trees.contents, metadata);
+    Tree *parent = ts_tree_make_node(self->tree_arena, symbol, child_count,
+                                     slice.trees.contents, metadata);
 
     // This pop operation may have caused multiple stack versions to collapse
     // into one, because they all diverged from a common state. In that case,
@@ -568,6 +655,7 @@ static StackPopResult parser__reduce(Parser *self, StackVersion version,
   for (StackVersion i = initial_version_count; i < ts_stack_version_count(self->stack); i++) {
     for (StackVersion j = initial_version_count; j < i; j++) {
       if (ts_stack_merge(self->stack, j, i)) {
+        self->stats.merge_count++;
         i--;
         break;
       }
@@ -696,7 +784,8 @@ static StackIterateAction parser__repair_error_callback(
 
 static bool parser__repair_error(Parser *self, StackSlice slice,
                                  TSSymbol lookahead_symbol, TableEntry entry) {
-  LOG("repair_error");
+  LOG_EVENT(.type = TSTraceEventRepairError);
+  self->stats.repair_error_count++;
   ErrorRepairSession session = {
     .parser = self,
     .lookahead_symbol = lookahead_symbol,
@@ -724,7 +813,7 @@ static bool parser__repair_error(Parser *self, StackSlice slice,
     self->stack, slice.version, parser__repair_error_callback, &session);
 
   if (!session.found_repair) {
-    LOG("no_repair_found");
+    LOG_EVENT(.type = TSTraceEventNoRepairFound);
     ts_stack_remove_version(self->stack, slice.version);
     ts_tree_array_delete(&slice.trees);
     return false;
@@ -748,7 +837,7 @@ static bool parser__repair_error(Parser *self, StackSlice slice,
 
   TreeArray skipped_children = ts_tree_array_remove_last_n(&children, skip_count);
   TreeArray trailing_extras = ts_tree_array_remove_trailing_extras(&skipped_children);
-  Tree *error = ts_tree_make_error_node(&skipped_children);
+  Tree *error = ts_tree_make_error_node(self->tree_arena, &skipped_children);
   array_push(&children, error);
   array_push_all(&children, &trailing_extras);
   trailing_extras.size = 0;
@@ -759,28 +848,28 @@ static bool parser__repair_error(Parser *self, StackSlice slice,
   array_delete(&slice.trees);
 
   Tree *parent =
-    ts_tree_make_node(symbol, children.size, children.contents,
+    ts_tree_make_node(self->tree_arena, symbol, children.size, children.contents,
                       ts_language_symbol_metadata(self->language, symbol));
   parser__push(self, slice.version, parent, next_state);
   ts_stack_decrease_push_count(self->stack, slice.version, error->child_count);
 
   ErrorStatus error_status = ts_stack_error_status(self->stack, slice.version);
   if (parser__better_version_exists(self, slice.version, error_status)) {
-    LOG("no_better_repair_found");
+    LOG_EVENT(.type = TSTraceEventNoBetterRepairFound);
     ts_stack_halt(self->stack, slice.version);
     return false;
   } else {
-    LOG("repair_found sym:%s, child_count:%u, cost:%u", SYM_NAME(symbol),
-        repair.count, parent->error_cost);
+    LOG_EVENT(.type = TSTraceEventRepairFound, .symbol = symbol,
+              .arguments = {repair.count, parent->error_cost});
     return true;
   }
 }
 
 static void parser__start(Parser *self, TSInput input, Tree *previous_tree) {
   if (previous_tree) {
-    LOG("parse_after_edit");
+    LOG_EVENT(.type = TSTraceEventParseAfterEdit);
   } else {
-    LOG("new_parse");
+    LOG_EVENT(.type = TSTraceEventNewParse);
   }
 
   if (self->language->external_scanner.reset) {
@@ -790,8 +879,30 @@ static void parser__start(Parser *self, TSInput input, Tree *previous_tree) {
   ts_lexer_set_input(&self->lexer, input);
   ts_stack_clear(self->stack);
   self->reusable_node = reusable_node_new(previous_tree);
-  self->cached_token = NULL;
+  ts_token_cache_clear(&self->token_cache);
+  self->token_cache.hit_count = 0;
+  self->token_cache.miss_count = 0;
   self->finished_tree = NULL;
+  self->in_progress = true;
+  memset(&self->stats, 0, sizeof(self->stats));
+  self->version_count_sum = 0;
+  self->round_count = 0;
+}
+
+static bool parser__is_cancelled(Parser *self) {
+  return self->cancellation_flag && *self->cancellation_flag;
+}
+
+static bool parser__is_out_of_time(Parser *self) {
+  if (self->lex_limit && self->stats.lex_count >= self->end_lex_count)
+    return true;
+
+  if (self->end_micros && ++self->operation_count >= OP_COUNT_PER_TIMEOUT_CHECK) {
+    self->operation_count = 0;
+    return clock_now_micros() >= self->end_micros;
+  }
+
+  return false;
 }
 
 static void parser__accept(Parser *self, StackVersion version,
@@ -813,11 +924,18 @@ static void parser__accept(Parser *self, StackVersion version,
       for (uint32_t j = trees.size - 1; j + 1 > 0; j--) {
         Tree *child = trees.contents[j];
         if (!child->extra) {
-          root = ts_tree_make_copy(child);
+          root = ts_tree_make_copy(self->tree_arena, child);
           root->child_count = 0;
-          for (uint32_t k = 0; k < child->child_count; k++)
-            ts_tree_retain(child->children[k]);
-          array_splice(&trees, j, 1, child->child_count, child->children);
+
+          // The root may be a single token, allocated as a compact tree
+          // without a `children` field.
+          Tree **grandchildren = NULL;
+          if (child->child_count > 0) {
+            grandchildren = child->children;
+            for (uint32_t k = 0; k < child->child_count; k++)
+              ts_tree_retain(grandchildren[k]);
+          }
+          array_splice(&trees, j, 1, child->child_count, grandchildren);
           ts_tree_set_children(root, trees.size, trees.contents);
           ts_tree_release(child);
           break;
@@ -926,7 +1044,7 @@ static bool parser__skip_preceding_trees(Parser *self, StackVersion version,
     }
 
     previous_version = slice.version;
-    Tree *error = ts_tree_make_error_node(&slice.trees);
+    Tree *error = ts_tree_make_error_node(self->tree_arena, &slice.trees);
     error->extra = true;
     TSStateId state = ts_stack_top_state(self->stack, slice.version);
     parser__push(self, slice.version, error, state);
@@ -937,23 +1055,25 @@ static bool parser__skip_preceding_trees(Parser *self, StackVersion version,
 
 static void parser__handle_error(Parser *self, StackVersion version,
                                  TSSymbol lookahead_symbol) {
+  self->stats.handle_error_count++;
+
   // If there are other stack versions that are clearly better than this one,
   // just halt this version.
   ErrorStatus error_status = ts_stack_error_status(self->stack, version);
   error_status.count++;
   if (parser__better_version_exists(self, version, error_status)) {
     ts_stack_halt(self->stack, version);
-    LOG("bail_on_error");
+    LOG_EVENT(.type = TSTraceEventBailOnError);
     return;
   }
 
-  LOG("handle_error");
+  LOG_EVENT(.type = TSTraceEventHandleError);
 
   // If the current lookahead symbol would have been valid in some previous
   // state on the stack, create one stack version that repairs the error
   // immediately by simply skipping all of the trees that came after that state.
   if (parser__skip_preceding_trees(self, version, lookahead_symbol)) {
-    LOG("skip_preceding_trees");
+    LOG_EVENT(.type = TSTraceEventSkipPrecedingTrees);
     LOG_STACK();
   }
 
@@ -975,21 +1095,25 @@ static void parser__handle_error(Parser *self, StackVersion version,
   ts_stack_push(self->stack, version, NULL, false, ERROR_STATE);
   while (ts_stack_version_count(self->stack) > previous_version_count) {
     ts_stack_push(self->stack, previous_version_count, NULL, false, ERROR_STATE);
-    assert(ts_stack_merge(self->stack, version, previous_version_count));
+    bool did_merge = ts_stack_merge(self->stack, version, previous_version_count);
+    assert(did_merge);
+    (void)did_merge;
+    self->stats.merge_count++;
   }
 }
 
 static void parser__recover(Parser *self, StackVersion version, TSStateId state,
                             Tree *lookahead) {
+  self->stats.recover_count++;
   if (lookahead->symbol == ts_builtin_sym_end) {
-    LOG("recover_eof");
+    LOG_EVENT(.type = TSTraceEventRecoverEOF);
     TreeArray children = array_new();
-    Tree *parent = ts_tree_make_error_node(&children);
+    Tree *parent = ts_tree_make_error_node(self->tree_arena, &children);
     parser__push(self, version, parent, 1);
     parser__accept(self, version, lookahead);
   }
 
-  LOG("recover state:%u", state);
+  LOG_EVENT(.type = TSTraceEventRecover, .state = state);
 
   StackVersion new_version = ts_stack_copy_version(self->stack, version);
 
@@ -999,7 +1123,7 @@ static void parser__recover(Parser *self, StackVersion version, TSStateId state,
   ErrorStatus error_status = ts_stack_error_status(self->stack, new_version);
   if (parser__better_version_exists(self, version, error_status)) {
     ts_stack_remove_version(self->stack, new_version);
-    LOG("bail_on_recovery");
+    LOG_EVENT(.type = TSTraceEventBailOnRecovery);
   }
 
   parser__shift(self, version, state, lookahead, false);
@@ -1018,11 +1142,8 @@ static void parser__advance(Parser *self, StackVersion version,
 
     if (!validated_lookahead) {
       if (!parser__can_reuse(self, state, lookahead, &table_entry)) {
-        if (lookahead == reusable_node->tree) {
+        if (lookahead == reusable_node->tree)
           reusable_node_pop_leaf(reusable_node);
-        } else {
-          parser__clear_cached_token(self);
-        }
 
         ts_tree_release(lookahead);
         lookahead = parser__get_lookahead(self, version, reusable_node, &validated_lookahead);
@@ -1030,7 +1151,10 @@ static void parser__advance(Parser *self, StackVersion version,
       }
 
       validated_lookahead = true;
-      LOG("reused_lookahead sym:%s, size:%u", SYM_NAME(lookahead->symbol), lookahead->size.bytes);
+      self->stats.reused_subtree_count++;
+      self->stats.reused_bytes += ts_tree_total_bytes(lookahead);
+      LOG_EVENT(.type = TSTraceEventReusedLookahead, .symbol = lookahead->symbol,
+                .arguments = {lookahead->size.bytes});
     }
 
     bool reduction_stopped_at_error = false;
@@ -1046,10 +1170,10 @@ static void parser__advance(Parser *self, StackVersion version,
 
           if (action.extra) {
             next_state = state;
-            LOG("shift_extra");
+            LOG_EVENT(.type = TSTraceEventShiftExtra);
           } else {
             next_state = action.params.to_state;
-            LOG("shift state:%u", next_state);
+            LOG_EVENT(.type = TSTraceEventShift, .state = next_state);
           }
 
           if (lookahead->child_count > 0) {
@@ -1081,15 +1205,19 @@ static void parser__advance(Parser *self, StackVersion version,
           TSSymbol symbol = action.params.symbol;
           bool fragile = action.fragile;
 
-          LOG("reduce sym:%s, child_count:%u", SYM_NAME(symbol), child_count);
+          LOG_EVENT(.type = TSTraceEventReduce, .symbol = symbol,
+                    .arguments = {child_count});
 
           StackPopResult reduction =
             parser__reduce(self, version, symbol, child_count, fragile, true);
           StackSlice slice = *array_front(&reduction.slices);
           if (reduction.stopped_at_error) {
             reduction_stopped_at_error = true;
-            if (!parser__repair_error(self, slice, lookahead->first_leaf.symbol,
-                                      table_entry))
+            uint64_t start_time = parser__start_timer(self);
+            bool did_repair = parser__repair_error(self, slice, lookahead->first_leaf.symbol,
+                                                   table_entry);
+            parser__stop_timer(self, start_time, &self->stats.error_handling_nanos);
+            if (!did_repair)
               break;
           }
 
@@ -1101,7 +1229,7 @@ static void parser__advance(Parser *self, StackVersion version,
           if (ts_stack_error_status(self->stack, version).count > 0)
             continue;
 
-          LOG("accept");
+          LOG_EVENT(.type = TSTraceEventAccept);
           parser__accept(self, version, lookahead);
           ts_tree_release(lookahead);
           return;
@@ -1115,7 +1243,9 @@ static void parser__advance(Parser *self, StackVersion version,
             ts_tree_retain(lookahead);
           }
 
+          uint64_t start_time = parser__start_timer(self);
           parser__recover(self, version, action.params.to_state, lookahead);
+          parser__stop_timer(self, start_time, &self->stats.error_handling_nanos);
           if (lookahead == reusable_node->tree)
             reusable_node_pop(reusable_node);
           ts_tree_release(lookahead);
@@ -1139,7 +1269,9 @@ static void parser__advance(Parser *self, StackVersion version,
       return;
     }
 
+    uint64_t start_time = parser__start_timer(self);
     parser__handle_error(self, version, lookahead->first_leaf.symbol);
+    parser__stop_timer(self, start_time, &self->stats.error_handling_nanos);
 
     if (ts_stack_is_halted(self->stack, version)) {
       ts_tree_release(lookahead);
@@ -1154,8 +1286,20 @@ bool parser_init(Parser *self) {
   array_init(&self->tree_path1);
   array_init(&self->tree_path2);
   array_grow(&self->reduce_actions, 4);
+  ts_token_cache_init(&self->token_cache);
   self->stack = ts_stack_new();
   self->finished_tree = NULL;
+  self->tree_arena = NULL;
+  self->cancellation_flag = NULL;
+  self->timeout_micros = 0;
+  self->version_limit = 0;
+  self->lex_limit = 0;
+  self->in_progress = false;
+  self->status = TSParseStatusComplete;
+  self->time_phases = false;
+  memset(&self->stats, 0, sizeof(self->stats));
+  self->version_count_sum = 0;
+  self->round_count = 0;
   return true;
 }
 
@@ -1171,7 +1315,24 @@ void parser_set_language(Parser *self, const TSLanguage *language) {
   self->language = language;
 }
 
+void parser_reset(Parser *self) {
+  if (!self->in_progress)
+    return;
+  LOG_EVENT(.type = TSTraceEventReset);
+  ts_stack_clear(self->stack);
+  ts_token_cache_clear(&self->token_cache);
+  if (self->finished_tree) {
+    ts_tree_release(self->finished_tree);
+    self->finished_tree = NULL;
+  }
+  self->in_progress = false;
+}
+
 void parser_destroy(Parser *self) {
+  parser_reset(self);
+  ts_token_cache_clear(&self->token_cache);
+  if (self->tree_arena)
+    ts_tree_arena_delete(self->tree_arena);
   if (self->stack)
     ts_stack_delete(self->stack);
   if (self->reduce_actions.contents)
@@ -1184,13 +1345,47 @@ void parser_destroy(Parser *self) {
 }
 
 Tree *parser_parse(Parser *self, TSInput input, Tree *old_tree) {
-  parser__start(self, input, old_tree);
+  if (self->in_progress) {
+    LOG_EVENT(.type = TSTraceEventResumeParse);
+  } else {
+    parser__start(self, input, old_tree);
+  }
+
+  uint64_t start_time = clock_now_nanos();
+  self->operation_count = 0;
+  self->end_micros = self->timeout_micros
+    ? clock_now_micros() + self->timeout_micros
+    : 0;
+
+  // The lex limit applies to each call, so that a paused parse that resumes
+  // with the same limit always makes progress.
+  self->end_lex_count = self->stats.lex_count + self->lex_limit;
 
   StackVersion version = STACK_VERSION_NONE;
   uint32_t position = 0, last_position = 0;
   ReusableNode reusable_node;
 
   do {
+    if (parser__is_cancelled(self)) {
+      parser_reset(self);
+      self->status = TSParseStatusCancelled;
+      return NULL;
+    }
+
+    if (parser__is_out_of_time(self)) {
+      LOG_EVENT(.type = TSTraceEventPauseParse);
+      self->status = TSParseStatusPaused;
+      self->stats.total_nanos += clock_now_nanos() - start_time;
+      return NULL;
+    }
+
+    // The last round finds no versions left to process, once they have all
+    // been accepted.
+    if (ts_stack_version_count(self->stack) > 0) {
+      self->version_count_sum += ts_stack_version_count(self->stack);
+      self->round_count++;
+    }
+
     for (version = 0; version < ts_stack_version_count(self->stack); version++) {
       reusable_node = self->reusable_node;
       last_position = position;
@@ -1200,11 +1395,10 @@ Tree *parser_parse(Parser *self, TSInput input, Tree *old_tree) {
         if (position > last_position || (version > 0 && position == last_position))
           break;
 
-        LOG("process version:%d, version_count:%u, state:%d, row:%u, col:%u",
-            version, ts_stack_version_count(self->stack),
-            ts_stack_top_state(self->stack, version),
-            ts_stack_top_position(self->stack, version).extent.row,
-            ts_stack_top_position(self->stack, version).extent.column);
+        LOG_EVENT_AT(ts_stack_top_position(self->stack, version),
+                     .type = TSTraceEventProcess,
+                     .state = ts_stack_top_state(self->stack, version),
+                     .arguments = {version, ts_stack_version_count(self->stack)});
 
         parser__advance(self, version, &reusable_node);
         LOG_STACK();
@@ -1213,18 +1407,48 @@ Tree *parser_parse(Parser *self, TSInput input, Tree *old_tree) {
 
     self->reusable_node = reusable_node;
 
+    // Include the versions that were created during this round, before they
+    // are merged or removed.
+    uint32_t version_count = ts_stack_version_count(self->stack);
+    if (version_count > self->stats.max_version_count) {
+      self->stats.max_version_count = version_count;
+    }
+
+    uint64_t condense_start_time = parser__start_timer(self);
     if (parser__condense_stack(self)) {
-      LOG("condense");
+      self->stats.condense_count++;
+      LOG_EVENT(.type = TSTraceEventCondense);
       LOG_STACK();
     }
+    parser__stop_timer(self, condense_start_time, &self->stats.condense_nanos);
 
     self->is_split = (version > 1);
   } while (version != 0);
 
-  LOG("done");
+  LOG_EVENT(.type = TSTraceEventDone);
+  LOG_EVENT(.type = TSTraceEventTokenCache,
+            .arguments = {self->token_cache.hit_count, self->token_cache.miss_count});
   LOG_TREE();
   ts_stack_clear(self->stack);
-  parser__clear_cached_token(self);
+  ts_token_cache_clear(&self->token_cache);
+  self->in_progress = false;
+  self->status = TSParseStatusComplete;
+
+  uint64_t balance_start_time = parser__start_timer(self);
+  ts_tree_balance(self->finished_tree, &self->tree_path1);
   ts_tree_assign_parents(self->finished_tree, &self->tree_path1);
+  parser__stop_timer(self, balance_start_time, &self->stats.balance_nanos);
+
+  self->stats.total_nanos += clock_now_nanos() - start_time;
   return self->finished_tree;
 }
+
+TSParseStats parser_stats(const Parser *self) {
+  TSParseStats result = self->stats;
+  result.token_cache_hit_count = self->token_cache.hit_count;
+  result.token_cache_miss_count = self->token_cache.miss_count;
+  if (self->round_count > 0) {
+    result.average_version_count = (float)self->version_count_sum / self->round_count;
+  }
+  return result;
+}
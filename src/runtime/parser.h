@@ -10,6 +10,7 @@ extern "C" {
 #include "runtime/lexer.h"
 #include "runtime/reusable_node.h"
 #include "runtime/reduce_action.h"
+#include "runtime/token_cache.h"
 
 typedef struct {
   Lexer lexer;
@@ -20,19 +21,34 @@ typedef struct {
   bool is_split;
   bool print_debugging_graphs;
   Tree scratch_tree;
-  Tree *cached_token;
-  uint32_t cached_token_byte_index;
+  TokenCache token_cache;
+  TreeArena *tree_arena;
   ReusableNode reusable_node;
   TreePath tree_path1;
   TreePath tree_path2;
   void *external_scanner_payload;
   Tree *last_external_token;
+  const volatile size_t *cancellation_flag;
+  uint64_t timeout_micros;
+  uint64_t end_micros;
+  uint32_t version_limit;
+  uint32_t lex_limit;
+  uint32_t end_lex_count;
+  unsigned operation_count;
+  bool in_progress;
+  TSParseStatus status;
+  bool time_phases;
+  TSParseStats stats;
+  uint64_t version_count_sum;
+  uint32_t round_count;
 } Parser;
 
 bool parser_init(Parser *);
 void parser_destroy(Parser *);
 Tree *parser_parse(Parser *, TSInput, Tree *);
+void parser_reset(Parser *);
 void parser_set_language(Parser *, const TSLanguage *);
+TSParseStats parser_stats(const Parser *);
 
 #ifdef __cplusplus
 }
@@ -119,7 +119,7 @@ static StackNode *stack_node_new(StackNode *next, Tree *tree, bool is_pending,
 
     if (tree) {
       ts_tree_retain(tree);
-      node->error_cost += tree->error_cost;
+      node->error_cost += ts_tree_error_cost(tree);
 
       if (state == ERROR_STATE) {
         if (!tree->extra) {
@@ -632,7 +632,7 @@ bool ts_stack_print_dot_graph(Stack *self, const char **symbol_names, FILE *f) {
           if (!link.tree->named)
             fprintf(f, "'");
           fprintf(f, "\" labeltooltip=\"error_cost: %u\"",
-                  link.tree->error_cost);
+                  ts_tree_error_cost(link.tree));
         }
 
         fprintf(f, "];\n");
@@ -0,0 +1,99 @@
+#ifndef RUNTIME_TOKEN_CACHE_H_
+#define RUNTIME_TOKEN_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+#include "tree_sitter/parser.h"
+#include "runtime/tree.h"
+
+#define TOKEN_CACHE_SIZE 8
+
+// A token lexed at a given position can be reused by any other stack version
+// that reaches that position in the same lex mode, with the same external
+// scanner state.
+typedef struct {
+  Tree *token;
+  uint32_t byte_index;
+  TSLexMode lex_mode;
+  bool has_external_token_state;
+  TSExternalTokenState external_token_state;
+} TokenCacheEntry;
+
+typedef struct {
+  TokenCacheEntry entries[TOKEN_CACHE_SIZE];
+  uint32_t next_index;
+  uint32_t hit_count;
+  uint32_t miss_count;
+} TokenCache;
+
+static inline bool ts_token_cache_entry_matches(
+  const TokenCacheEntry *self, uint32_t byte_index, TSLexMode lex_mode,
+  const TSExternalTokenState *external_token_state) {
+  if (!self->token ||
+      self->byte_index != byte_index ||
+      self->lex_mode.lex_state != lex_mode.lex_state ||
+      self->lex_mode.external_lex_state != lex_mode.external_lex_state)
+    return false;
+  if (!external_token_state)
+    return !self->has_external_token_state;
+  return self->has_external_token_state &&
+    memcmp(self->external_token_state, *external_token_state,
+           sizeof(TSExternalTokenState)) == 0;
+}
+
+static inline void ts_token_cache_init(TokenCache *self) {
+  memset(self, 0, sizeof(TokenCache));
+}
+
+static inline Tree *ts_token_cache_get(TokenCache *self, uint32_t byte_index,
+                                       TSLexMode lex_mode,
+                                       const TSExternalTokenState *external_token_state) {
+  for (uint32_t i = 0; i < TOKEN_CACHE_SIZE; i++) {
+    TokenCacheEntry *entry = &self->entries[i];
+    if (ts_token_cache_entry_matches(entry, byte_index, lex_mode, external_token_state)) {
+      self->hit_count++;
+      return entry->token;
+    }
+  }
+  self->miss_count++;
+  return NULL;
+}
+
+static inline void ts_token_cache_set(TokenCache *self, uint32_t byte_index,
+                                      TSLexMode lex_mode,
+                                      const TSExternalTokenState *external_token_state,
+                                      Tree *token) {
+  TokenCacheEntry *entry = &self->entries[self->next_index];
+  self->next_index = (self->next_index + 1) % TOKEN_CACHE_SIZE;
+
+  ts_tree_retain(token);
+  if (entry->token)
+    ts_tree_release(entry->token);
+
+  entry->token = token;
+  entry->byte_index = byte_index;
+  entry->lex_mode = lex_mode;
+  entry->has_external_token_state = external_token_state != NULL;
+  if (external_token_state)
+    memcpy(entry->external_token_state, *external_token_state,
+           sizeof(TSExternalTokenState));
+}
+
+static inline void ts_token_cache_clear(TokenCache *self) {
+  for (uint32_t i = 0; i < TOKEN_CACHE_SIZE; i++) {
+    if (self->entries[i].token) {
+      ts_tree_release(self->entries[i].token);
+      self->entries[i].token = NULL;
+    }
+  }
+  self->next_index = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RUNTIME_TOKEN_CACHE_H_
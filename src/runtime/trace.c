@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include "runtime/trace.h"
+#include "runtime/alloc.h"
+#include "runtime/lexer.h"
+
+TSTraceBuffer *ts_trace_buffer_new(uint32_t capacity) {
+  uint32_t rounded_capacity = 1;
+  while (rounded_capacity < capacity && rounded_capacity < (1u << 31))
+    rounded_capacity *= 2;
+
+  TSTraceBuffer *self = ts_malloc(sizeof(TSTraceBuffer));
+  self->events = ts_calloc(rounded_capacity, sizeof(TSTraceEvent));
+  self->mask = rounded_capacity - 1;
+  self->push_count = 0;
+  return self;
+}
+
+void ts_trace_buffer_delete(TSTraceBuffer *self) {
+  ts_free(self->events);
+  ts_free(self);
+}
+
+void ts_trace_buffer_clear(TSTraceBuffer *self) {
+  self->push_count = 0;
+}
+
+uint32_t ts_trace_buffer_event_count(const TSTraceBuffer *self) {
+  uint64_t capacity = (uint64_t)self->mask + 1;
+  return self->push_count < capacity ? self->push_count : capacity;
+}
+
+uint64_t ts_trace_buffer_dropped_event_count(const TSTraceBuffer *self) {
+  return self->push_count - ts_trace_buffer_event_count(self);
+}
+
+// Events are indexed from the oldest one that has not been overwritten.
+const TSTraceEvent *ts_trace_buffer_event(const TSTraceBuffer *self, uint32_t index) {
+  uint32_t count = ts_trace_buffer_event_count(self);
+  if (index >= count)
+    return NULL;
+  uint64_t start = self->push_count - count;
+  return &self->events[(start + index) & self->mask];
+}
+
+void ts_trace_buffer_replay(const TSTraceBuffer *self, const TSLanguage *language,
+                            TSLogger logger) {
+  char buffer[TS_DEBUG_BUFFER_SIZE];
+  for (uint32_t i = 0, n = ts_trace_buffer_event_count(self); i < n; i++) {
+    const TSTraceEvent *event = ts_trace_buffer_event(self, i);
+    ts_trace_event_format(event, language, buffer, TS_DEBUG_BUFFER_SIZE);
+    logger.log(logger.payload, ts_trace_event_log_type(event), buffer);
+  }
+}
+
+TSLogType ts_trace_event_log_type(const TSTraceEvent *event) {
+  switch (event->type) {
+    case TSTraceEventSkipCharacter:
+    case TSTraceEventConsumeCharacter:
+      return TSLogTypeLex;
+    default:
+      return TSLogTypeParse;
+  }
+}
+
+#define FORMAT(...) (uint32_t)snprintf(buffer, size, __VA_ARGS__)
+
+#define SYM_NAME(symbol) ts_language_symbol_name(language, symbol)
+
+#define FORMAT_CHARACTER(message, character)                         \
+  ((int32_t)(character) < 255                                        \
+    ? FORMAT(message " character:'%c'", (int32_t)(character))        \
+    : FORMAT(message " character:%d", (int32_t)(character)))
+
+uint32_t ts_trace_event_format(const TSTraceEvent *event, const TSLanguage *language,
+                               char *buffer, uint32_t size) {
+  const uint32_t *arguments = event->arguments;
+  switch (event->type) {
+    case TSTraceEventNewParse:
+      return FORMAT("new_parse");
+    case TSTraceEventParseAfterEdit:
+      return FORMAT("parse_after_edit");
+    case TSTraceEventResumeParse:
+      return FORMAT("resume_parse");
+    case TSTraceEventPauseParse:
+      return FORMAT("pause_parse");
+    case TSTraceEventReset:
+      return FORMAT("reset");
+    case TSTraceEventProcess:
+      return FORMAT("process version:%d, version_count:%u, state:%d, row:%u, col:%u",
+                    arguments[0], arguments[1], event->state, event->point.row,
+                    event->point.column);
+    case TSTraceEventCondense:
+      return FORMAT("condense");
+    case TSTraceEventDone:
+      return FORMAT("done");
+    case TSTraceEventTokenCache:
+      return FORMAT("token_cache hits:%u, misses:%u", arguments[0], arguments[1]);
+    case TSTraceEventRestoreExternalScanner:
+      return FORMAT("restore_external_scanner");
+    case TSTraceEventLexExternal:
+      return FORMAT("lex_external state:%d, row:%u, column:%u", event->state,
+                    event->point.row, event->point.column);
+    case TSTraceEventLexInternal:
+      return FORMAT("lex_internal state:%d, row:%u, column:%u", event->state,
+                    event->point.row, event->point.column);
+    case TSTraceEventRetryInErrorMode:
+      return FORMAT("retry_in_error_mode");
+    case TSTraceEventSkipUnrecognizedCharacter:
+      return FORMAT("skip_unrecognized_character");
+    case TSTraceEventLexedLookahead:
+      return FORMAT("lexed_lookahead sym:%s, size:%u", SYM_NAME(event->symbol), arguments[0]);
+    case TSTraceEventCachedLookahead:
+      return FORMAT("cached_lookahead sym:%s, size:%u", SYM_NAME(event->symbol), arguments[0]);
+    case TSTraceEventReusedLookahead:
+      return FORMAT("reused_lookahead sym:%s, size:%u", SYM_NAME(event->symbol), arguments[0]);
+    case TSTraceEventBeforeReusableNode:
+      return FORMAT("before_reusable_node sym:%s", SYM_NAME(event->symbol));
+    case TSTraceEventPastReusable:
+      return FORMAT("past_reusable sym:%s", SYM_NAME(event->symbol));
+    case TSTraceEventCantReuseChanged:
+      return FORMAT("cant_reuse_changed tree:%s, size:%u", SYM_NAME(event->symbol), arguments[0]);
+    case TSTraceEventCantReuseError:
+      return FORMAT("cant_reuse_error tree:%s, size:%u", SYM_NAME(event->symbol), arguments[0]);
+    case TSTraceEventCantReuseExternalTokens:
+      return FORMAT("cant_reuse_external_tokens tree:%s, size:%u", SYM_NAME(event->symbol),
+                    arguments[0]);
+    case TSTraceEventBreakdownTopOfStack:
+      return FORMAT("breakdown_top_of_stack tree:%s", SYM_NAME(event->symbol));
+    case TSTraceEventStateMismatch:
+      return FORMAT("state_mismatch sym:%s", SYM_NAME(event->symbol));
+    case TSTraceEventSelectSmallerError:
+      return FORMAT("select_smaller_error symbol:%s, over_symbol:%s", SYM_NAME(event->symbol),
+                    SYM_NAME(event->other_symbol));
+    case TSTraceEventSelectEarlier:
+      return FORMAT("select_earlier symbol:%s, over_symbol:%s", SYM_NAME(event->symbol),
+                    SYM_NAME(event->other_symbol));
+    case TSTraceEventSelectExisting:
+      return FORMAT("select_existing symbol:%s, over_symbol:%s", SYM_NAME(event->symbol),
+                    SYM_NAME(event->other_symbol));
+    case TSTraceEventHaltOther:
+      return FORMAT("halt_other version:%u", arguments[0]);
+    case TSTraceEventShift:
+      return FORMAT("shift state:%u", event->state);
+    case TSTraceEventShiftExtra:
+      return FORMAT("shift_extra");
+    case TSTraceEventReduce:
+      return FORMAT("reduce sym:%s, child_count:%u", SYM_NAME(event->symbol), arguments[0]);
+    case TSTraceEventAccept:
+      return FORMAT("accept");
+    case TSTraceEventBailOnError:
+      return FORMAT("bail_on_error");
+    case TSTraceEventHandleError:
+      return FORMAT("handle_error");
+    case TSTraceEventSkipPrecedingTrees:
+      return FORMAT("skip_preceding_trees");
+    case TSTraceEventRepairError:
+      return FORMAT("repair_error");
+    case TSTraceEventNoRepairFound:
+      return FORMAT("no_repair_found");
+    case TSTraceEventNoBetterRepairFound:
+      return FORMAT("no_better_repair_found");
+    case TSTraceEventRepairFound:
+      return FORMAT("repair_found sym:%s, child_count:%u, cost:%u", SYM_NAME(event->symbol),
+                    arguments[0], arguments[1]);
+    case TSTraceEventRecoverEOF:
+      return FORMAT("recover_eof");
+    case TSTraceEventRecover:
+      return FORMAT("recover state:%u", event->state);
+    case TSTraceEventBailOnRecovery:
+      return FORMAT("bail_on_recovery");
+    case TSTraceEventSkipCharacter:
+      return FORMAT_CHARACTER("skip", arguments[0]);
+    case TSTraceEventConsumeCharacter:
+      return FORMAT_CHARACTER("consume", arguments[0]);
+    case TSTraceEventDropVersion:
+      return FORMAT("drop_version version:%u, cost:%u", arguments[0], arguments[1]);
+    default:
+      return FORMAT("unknown_event type:%u", event->type);
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef RUNTIME_TRACE_H_
+#define RUNTIME_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tree_sitter/runtime.h"
+
+// The capacity of the buffer is a power of two, so that the oldest events
+// can be overwritten by masking the total number of events pushed.
+struct TSTraceBuffer {
+  TSTraceEvent *events;
+  uint32_t mask;
+  uint64_t push_count;
+};
+
+static inline void ts_trace_buffer_push(TSTraceBuffer *self, TSTraceEvent event) {
+  self->events[self->push_count & self->mask] = event;
+  self->push_count++;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RUNTIME_TRACE_H_
@@ -4,29 +4,68 @@
 #include <string.h>
 #include <stdio.h>
 #include "runtime/alloc.h"
+#include "runtime/atomic.h"
 #include "runtime/tree.h"
 #include "runtime/length.h"
 #include "runtime/error_costs.h"
 
 TSStateId TS_TREE_STATE_NONE = USHRT_MAX;
 
-Tree *ts_tree_make_leaf(TSSymbol sym, Length padding, Length size,
-                          TSSymbolMetadata metadata) {
-  Tree *result = ts_malloc(sizeof(Tree));
-  *result = (Tree){
+static inline Tree *ts_tree__alloc(TreeArena *arena, size_t size) {
+  if (arena)
+    return ts_tree_arena_alloc(arena, size);
+  else
+    return ts_malloc(size);
+}
+
+static inline void ts_tree__free(Tree *self) {
+  if (self->in_arena)
+    ts_tree_arena_free(self);
+  else
+    ts_free(self);
+}
+
+static inline Tree ts_tree__leaf(TreeArena *arena, TSSymbol sym, Length padding,
+                                 Length size, TSSymbolMetadata metadata) {
+  return (Tree){
     .ref_count = 1,
     .symbol = sym,
     .size = size,
     .child_count = 0,
-    .visible_child_count = 0,
-    .named_child_count = 0,
-    .children = NULL,
     .padding = padding,
     .visible = metadata.visible,
     .named = metadata.named,
     .has_changes = false,
+    .in_arena = arena != NULL,
     .first_leaf.symbol = sym,
   };
+}
+
+static Tree *ts_tree__make_full_leaf(TreeArena *arena, TSSymbol sym, Length padding,
+                                     Length size, TSSymbolMetadata metadata) {
+  Tree *result = ts_tree__alloc(arena, sizeof(Tree));
+  *result = ts_tree__leaf(arena, sym, padding, size, metadata);
+  return result;
+}
+
+Tree *ts_tree_make_leaf(TreeArena *arena, TSSymbol sym, Length padding,
+                        Length size, TSSymbolMetadata metadata) {
+  // Error leaves store the unexpected character, which compact trees lack.
+  if (sym == ts_builtin_sym_error)
+    return ts_tree__make_full_leaf(arena, sym, padding, size, metadata);
+
+  Tree *result = ts_tree__alloc(arena, TREE_COMPACT_SIZE);
+  Tree leaf = ts_tree__leaf(arena, sym, padding, size, metadata);
+  leaf.compact = true;
+  memcpy(result, &leaf, TREE_COMPACT_SIZE);
+  return result;
+}
+
+Tree *ts_tree_make_external_leaf(TreeArena *arena, TSSymbol sym, Length padding,
+                                 Length size, TSSymbolMetadata metadata) {
+  Tree *result = ts_tree__make_full_leaf(arena, sym, padding, size, metadata);
+  result->has_external_tokens = true;
+  result->has_external_token_state = true;
   return result;
 }
 
@@ -99,21 +138,33 @@ TreeArray ts_tree_array_remove_trailing_extras(TreeArray *self) {
   return result;
 }
 
-Tree *ts_tree_make_error(Length size, Length padding, char lookahead_char) {
-  Tree *result = ts_tree_make_leaf(ts_builtin_sym_error, padding, size,
-                                     (TSSymbolMetadata){
-                                       .visible = true, .named = true,
-                                     });
+Tree *ts_tree_make_error(TreeArena *arena, Length size, Length padding,
+                         char lookahead_char) {
+  Tree *result = ts_tree__make_full_leaf(arena, ts_builtin_sym_error, padding, size,
+                                         (TSSymbolMetadata){
+                                           .visible = true, .named = true,
+                                         });
   result->fragile_left = true;
   result->fragile_right = true;
   result->lookahead_char = lookahead_char;
   return result;
 }
 
-Tree *ts_tree_make_copy(Tree *self) {
-  Tree *result = ts_malloc(sizeof(Tree));
-  *result = *self;
+Tree *ts_tree_make_copy(TreeArena *arena, Tree *self) {
+  Tree *result = ts_tree__alloc(arena, sizeof(Tree));
+  if (self->compact) {
+    memcpy(result, self, TREE_COMPACT_SIZE);
+    result->compact = false;
+    result->error_cost = 0;
+    result->repeat_depth = 0;
+    result->visible_child_count = 0;
+    result->named_child_count = 0;
+    result->children = NULL;
+  } else {
+    *result = *self;
+  }
   result->ref_count = 1;
+  result->in_arena = arena != NULL;
   return result;
 }
 
@@ -137,12 +188,13 @@ void ts_tree_assign_parents(Tree *self, TreePath *path) {
 }
 
 
-void ts_tree_set_children(Tree *self, uint32_t child_count, Tree **children) {
-  if (self->child_count > 0)
-    ts_free(self->children);
+static inline uint32_t ts_tree__repeat_depth(const Tree *self) {
+  return self->compact ? 0 : self->repeat_depth;
+}
 
-  self->children = children;
-  self->child_count = child_count;
+static void ts_tree__summarize_children(Tree *self) {
+  uint32_t child_count = self->child_count;
+  Tree **children = self->children;
   self->named_child_count = 0;
   self->visible_child_count = 0;
   self->error_cost = 0;
@@ -162,7 +214,7 @@ void ts_tree_set_children(Tree *self, uint32_t child_count, Tree **children) {
       self->size = length_add(self->size, ts_tree_total_size(child));
     }
 
-    self->error_cost += child->error_cost;
+    self->error_cost += ts_tree_error_cost(child);
 
     if (child->visible) {
       self->visible_child_count++;
@@ -176,7 +228,14 @@ void ts_tree_set_children(Tree *self, uint32_t child_count, Tree **children) {
     if (child->has_external_tokens) self->has_external_tokens = true;
     if (child->has_external_token_state) self->has_external_token_state = true;
 
-    if (child->symbol == ts_builtin_sym_error) {
+    // A hidden child's children are shown as this node's own children, so an
+    // error anywhere within one makes this node fragile, just as an ERROR
+    // child does. Error recovery can join repetition nodes from either side
+    // of an error, and balancing can then move that node into the middle of
+    // the repetition, where edge fragility would not reach its parent.
+    if (child->symbol == ts_builtin_sym_error ||
+        (!child->visible && child->child_count > 0 && ts_tree_error_cost(child) > 0 &&
+         (child->fragile_left || child->fragile_right))) {
       self->fragile_left = self->fragile_right = true;
       self->parse_state = TS_TREE_STATE_NONE;
     }
@@ -197,17 +256,112 @@ void ts_tree_set_children(Tree *self, uint32_t child_count, Tree **children) {
     if (children[child_count - 1]->fragile_right)
       self->fragile_right = true;
   }
+
+  self->repeat_depth = 0;
+  if (child_count >= 2 && !self->visible && !self->named &&
+      children[0]->symbol == self->symbol &&
+      children[child_count - 1]->symbol == self->symbol) {
+    uint32_t left_depth = ts_tree__repeat_depth(children[0]);
+    uint32_t right_depth = ts_tree__repeat_depth(children[child_count - 1]);
+    self->repeat_depth = (left_depth > right_depth ? left_depth : right_depth) + 1;
+  }
+}
+
+void ts_tree_set_children(Tree *self, uint32_t child_count, Tree **children) {
+  assert(!self->compact);
+  if (self->child_count > 0)
+    ts_free(self->children);
+
+  self->children = children;
+  self->child_count = child_count;
+  ts_tree__summarize_children(self);
+}
+
+static inline bool ts_tree__can_rotate(const Tree *self, TSSymbol symbol) {
+  return self->ref_count == 1 && self->symbol == symbol &&
+         ts_tree__repeat_depth(self) > 0;
+}
+
+// Rotate the given repetition node to the right `count` times along its left
+// spine. The children of every rotated node are reassigned, so their parent
+// links are cleared for `ts_tree_assign_parents` to recompute.
+static void ts_tree__compress(Tree *self, uint32_t count, TreePath *stack) {
+  uint32_t initial_stack_size = stack->size;
+  Tree *tree = self;
+
+  for (uint32_t i = 0; i < count; i++) {
+    Tree *child = tree->children[0];
+    if (!ts_tree__can_rotate(child, tree->symbol))
+      break;
+    Tree *grandchild = child->children[0];
+    if (!ts_tree__can_rotate(grandchild, tree->symbol))
+      break;
+
+    Tree *moved_child = grandchild->children[grandchild->child_count - 1];
+    tree->children[0] = grandchild;
+    child->children[0] = moved_child;
+    grandchild->children[grandchild->child_count - 1] = child;
+
+    // The old child now starts where the moved grandchild starts.
+    if (child->parse_state != TS_TREE_STATE_NONE)
+      child->parse_state = moved_child->parse_state;
+
+    array_push(stack, ((TreePathEntry){tree, length_zero(), 0}));
+    tree = grandchild;
+  }
+
+  while (stack->size > initial_stack_size) {
+    tree = array_pop(stack).tree;
+    Tree *child = tree->children[0];
+    Tree *grandchild = child->children[child->child_count - 1];
+    ts_tree__summarize_children(grandchild);
+    ts_tree__summarize_children(child);
+    ts_tree__summarize_children(tree);
+    for (uint32_t i = 0; i < grandchild->child_count; i++)
+      grandchild->children[i]->context.parent = NULL;
+    for (uint32_t i = 0; i < child->child_count; i++)
+      child->children[i]->context.parent = NULL;
+    tree->children[0]->context.parent = NULL;
+  }
 }
 
-Tree *ts_tree_make_node(TSSymbol symbol, uint32_t child_count,
-                          Tree **children, TSSymbolMetadata metadata) {
+void ts_tree_balance(Tree *self, TreePath *stack) {
+  array_clear(stack);
+  if (self->child_count > 0 && self->ref_count == 1)
+    array_push(stack, ((TreePathEntry){self, length_zero(), 0}));
+
+  while (stack->size > 0) {
+    Tree *tree = array_pop(stack).tree;
+
+    if (tree->repeat_depth > 0) {
+      uint32_t left_depth = ts_tree__repeat_depth(tree->children[0]);
+      uint32_t right_depth = ts_tree__repeat_depth(tree->children[tree->child_count - 1]);
+      if (left_depth > right_depth) {
+        uint32_t n = left_depth - right_depth;
+        for (uint32_t i = n / 2; i > 0; i /= 2) {
+          ts_tree__compress(tree, i, stack);
+          n -= i;
+        }
+      }
+    }
+
+    for (uint32_t i = 0; i < tree->child_count; i++) {
+      Tree *child = tree->children[i];
+      if (child->child_count > 0 && child->ref_count == 1)
+        array_push(stack, ((TreePathEntry){child, length_zero(), 0}));
+    }
+  }
+}
+
+Tree *ts_tree_make_node(TreeArena *arena, TSSymbol symbol, uint32_t child_count,
+                        Tree **children, TSSymbolMetadata metadata) {
   Tree *result =
-    ts_tree_make_leaf(symbol, length_zero(), length_zero(), metadata);
+    ts_tree__make_full_leaf(arena, symbol, length_zero(), length_zero(), metadata);
   ts_tree_set_children(result, child_count, children);
   return result;
 }
 
-Tree *ts_tree_make_error_node(TreeArray *children) {
+Tree *ts_tree_make_error_node(TreeArena *arena, TreeArray *children) {
   for (uint32_t i = 0; i < children->size; i++) {
     Tree *child = children->contents[i];
     if (child->symbol == ts_builtin_sym_error && child->child_count > 0) {
@@ -220,7 +374,7 @@ Tree *ts_tree_make_error_node(TreeArray *children) {
   }
 
   Tree *result = ts_tree_make_node(
-    ts_builtin_sym_error, children->size, children->contents,
+    arena, ts_builtin_sym_error, children->size, children->contents,
     (TSSymbolMetadata){.extra = false, .visible = true, .named = true });
 
   result->fragile_left = true;
@@ -230,7 +384,8 @@ Tree *ts_tree_make_error_node(TreeArray *children) {
 
 void ts_tree_retain(Tree *self) {
   assert(self->ref_count > 0);
-  self->ref_count++;
+  atomic_inc(&self->ref_count);
+  assert(self->ref_count != 0);
 }
 
 void ts_tree_release(Tree *self) {
@@ -239,21 +394,19 @@ void ts_tree_release(Tree *self) {
 
 recur:
   assert(self->ref_count > 0);
-  self->ref_count--;
-
-  if (self->ref_count == 0) {
+  if (atomic_dec(&self->ref_count) == 0) {
     if (self->child_count > 0) {
       for (uint32_t i = 0; i < self->child_count - 1; i++)
         ts_tree_release(self->children[i]);
       Tree *last_child = self->children[self->child_count - 1];
       ts_free(self->children);
-      ts_free(self);
+      ts_tree__free(self);
 
       self = last_child;
       goto recur;
     }
 
-    ts_free(self);
+    ts_tree__free(self);
   }
 }
 
@@ -294,6 +447,8 @@ bool ts_tree_eq(const Tree *self, const Tree *other) {
     return self->lookahead_char == other->lookahead_char;
   if (self->child_count != other->child_count)
     return false;
+  if (self->child_count == 0)
+    return true;
   if (self->visible_child_count != other->visible_child_count)
     return false;
   if (self->named_child_count != other->named_child_count)
@@ -540,7 +695,7 @@ void ts_tree__print_dot_graph(const Tree *self, uint32_t byte_offset,
 
   fprintf(f, ", tooltip=\"range:%u - %u\nstate:%d\nerror-cost:%u\"]\n",
           byte_offset, byte_offset + ts_tree_total_bytes(self), self->parse_state,
-          self->error_cost);
+          ts_tree_error_cost(self));
   for (uint32_t i = 0; i < self->child_count; i++) {
     const Tree *child = self->children[i];
     ts_tree__print_dot_graph(child, byte_offset, language, f);
@@ -6,10 +6,12 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "tree_sitter/parser.h"
 #include "tree_sitter/runtime.h"
 #include "runtime/length.h"
 #include "runtime/array.h"
+#include "runtime/tree_arena.h"
 #include <stdio.h>
 
 extern TSStateId TS_TREE_STATE_NONE;
@@ -21,31 +23,20 @@ typedef struct Tree {
     Length offset;
   } context;
 
-  uint32_t child_count;
-  union {
-    struct {
-      uint32_t visible_child_count;
-      uint32_t named_child_count;
-      struct Tree **children;
-    };
-    TSExternalTokenState external_token_state;
-    int32_t lookahead_char;
-  };
-
   Length padding;
   Length size;
+  uint32_t child_count;
   uint32_t bytes_scanned;
+  uint32_t ref_count;
 
   TSSymbol symbol;
   TSStateId parse_state;
-  unsigned error_cost;
 
   struct {
     TSSymbol symbol;
     TSLexMode lex_mode;
   } first_leaf;
 
-  unsigned short ref_count;
   bool visible : 1;
   bool named : 1;
   bool extra : 1;
@@ -54,8 +45,29 @@ typedef struct Tree {
   bool has_changes : 1;
   bool has_external_tokens : 1;
   bool has_external_token_state : 1;
+  bool in_arena : 1;
+  bool compact : 1;
+
+  /*
+   *  The fields below are not allocated for compact trees: ordinary tokens,
+   *  which have no children, no error cost and no external scanner state.
+   *  Use `ts_tree_error_cost` to read the error cost of any tree.
+   */
+  unsigned error_cost;
+  uint32_t repeat_depth;
+  union {
+    struct {
+      uint32_t visible_child_count;
+      uint32_t named_child_count;
+      struct Tree **children;
+    };
+    TSExternalTokenState external_token_state;
+    int32_t lookahead_char;
+  };
 } Tree;
 
+#define TREE_COMPACT_SIZE offsetof(Tree, error_cost)
+
 typedef struct {
   Tree *tree;
   Length position;
@@ -72,11 +84,12 @@ uint32_t ts_tree_array_essential_count(const TreeArray *);
 TreeArray ts_tree_array_remove_last_n(TreeArray *, uint32_t);
 TreeArray ts_tree_array_remove_trailing_extras(TreeArray *);
 
-Tree *ts_tree_make_leaf(TSSymbol, Length, Length, TSSymbolMetadata);
-Tree *ts_tree_make_node(TSSymbol, uint32_t, Tree **, TSSymbolMetadata);
-Tree *ts_tree_make_copy(Tree *child);
-Tree *ts_tree_make_error_node(TreeArray *);
-Tree *ts_tree_make_error(Length, Length, char);
+Tree *ts_tree_make_leaf(TreeArena *, TSSymbol, Length, Length, TSSymbolMetadata);
+Tree *ts_tree_make_external_leaf(TreeArena *, TSSymbol, Length, Length, TSSymbolMetadata);
+Tree *ts_tree_make_node(TreeArena *, TSSymbol, uint32_t, Tree **, TSSymbolMetadata);
+Tree *ts_tree_make_copy(TreeArena *, Tree *child);
+Tree *ts_tree_make_error_node(TreeArena *, TreeArray *);
+Tree *ts_tree_make_error(TreeArena *, Length, Length, char);
 void ts_tree_retain(Tree *tree);
 void ts_tree_release(Tree *tree);
 bool ts_tree_eq(const Tree *tree1, const Tree *tree2);
@@ -87,6 +100,7 @@ uint32_t ts_tree_start_column(const Tree *self);
 uint32_t ts_tree_end_column(const Tree *self);
 void ts_tree_set_children(Tree *, uint32_t, Tree **);
 void ts_tree_assign_parents(Tree *, TreePath *);
+void ts_tree_balance(Tree *, TreePath *);
 void ts_tree_edit(Tree *, const TSInputEdit *edit);
 char *ts_tree_string(const Tree *, const TSLanguage *, bool include_all);
 void ts_tree_print_dot_graph(const Tree *, const TSLanguage *, FILE *);
@@ -104,6 +118,10 @@ static inline TSPoint ts_tree_total_extent(const Tree *self) {
   return point_add(self->padding.extent, self->size.extent);
 }
 
+static inline unsigned ts_tree_error_cost(const Tree *self) {
+  return self->compact ? 0 : self->error_cost;
+}
+
 static inline bool ts_tree_is_fragile(const Tree *tree) {
   return tree->fragile_left || tree->fragile_right ||
          ts_tree_total_bytes(tree) == 0;
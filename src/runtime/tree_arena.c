@@ -0,0 +1,68 @@
+#include "runtime/tree_arena.h"
+#include "runtime/alloc.h"
+#include "runtime/atomic.h"
+#include <assert.h>
+
+struct TreeArenaBlock {
+  uint32_t ref_count;
+  uint32_t size;
+};
+
+// Every allocation is preceded by a pointer to the block that contains it.
+typedef union {
+  TreeArenaBlock *block;
+  uint64_t alignment;
+} TreeArenaHeader;
+
+#define ALIGN(size) \
+  (((size) + sizeof(TreeArenaHeader) - 1) / sizeof(TreeArenaHeader) * sizeof(TreeArenaHeader))
+
+#define BLOCK_HEADER_SIZE ALIGN(sizeof(TreeArenaBlock))
+
+static void ts_tree_arena_block_release(TreeArenaBlock *block) {
+  assert(block->ref_count > 0);
+  if (atomic_dec(&block->ref_count) == 0)
+    ts_free(block);
+}
+
+TreeArena *ts_tree_arena_new() {
+  TreeArena *self = ts_malloc(sizeof(TreeArena));
+  self->current_block = NULL;
+  self->block_count = 0;
+  return self;
+}
+
+void ts_tree_arena_delete(TreeArena *self) {
+  if (self->current_block)
+    ts_tree_arena_block_release(self->current_block);
+  ts_free(self);
+}
+
+void *ts_tree_arena_alloc(TreeArena *self, size_t size) {
+  size_t allocation_size = sizeof(TreeArenaHeader) + ALIGN(size);
+  assert(BLOCK_HEADER_SIZE + allocation_size <= TREE_ARENA_BLOCK_SIZE);
+
+  TreeArenaBlock *block = self->current_block;
+  if (!block || block->size + allocation_size > TREE_ARENA_BLOCK_SIZE) {
+    // The arena holds one reference to its current block, so that the block
+    // is not freed while there is still room in it.
+    if (block)
+      ts_tree_arena_block_release(block);
+    block = ts_malloc(TREE_ARENA_BLOCK_SIZE);
+    block->ref_count = 1;
+    block->size = BLOCK_HEADER_SIZE;
+    self->current_block = block;
+    self->block_count++;
+  }
+
+  TreeArenaHeader *header = (TreeArenaHeader *)((char *)block + block->size);
+  header->block = block;
+  block->size += allocation_size;
+  atomic_inc(&block->ref_count);
+  return header + 1;
+}
+
+void ts_tree_arena_free(void *pointer) {
+  TreeArenaHeader *header = (TreeArenaHeader *)pointer - 1;
+  ts_tree_arena_block_release(header->block);
+}
@@ -0,0 +1,39 @@
+#ifndef RUNTIME_TREE_ARENA_H_
+#define RUNTIME_TREE_ARENA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define TREE_ARENA_BLOCK_SIZE (64 * 1024)
+
+// Trees allocated in an arena are carved out of large blocks instead of being
+// allocated individually. Each block counts the allocations that are still
+// live within it, and is freed once they have all been freed and the arena
+// has moved on to a newer block. Trees that are reused by later parses
+// therefore keep only their own blocks alive.
+//
+// Releasing a tree still visits each of its nodes, because nodes can be
+// shared with other trees and their children arrays live on the heap. The
+// arena only turns each node's call to free into a decrement of its block's
+// count, so that memory is returned to the allocator a block at a time.
+typedef struct TreeArenaBlock TreeArenaBlock;
+
+typedef struct {
+  TreeArenaBlock *current_block;
+  uint32_t block_count;
+} TreeArena;
+
+TreeArena *ts_tree_arena_new();
+void ts_tree_arena_delete(TreeArena *);
+void *ts_tree_arena_alloc(TreeArena *, size_t);
+void ts_tree_arena_free(void *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RUNTIME_TREE_ARENA_H_
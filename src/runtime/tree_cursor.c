@@ -0,0 +1,118 @@
+#include "tree_sitter/runtime.h"
+#include "runtime/alloc.h"
+#include "runtime/tree_cursor.h"
+#include "runtime/node.h"
+
+static inline bool ts_tree_cursor__has_visible_children(const Tree *tree) {
+  return tree->child_count > 0 && tree->visible_child_count > 0;
+}
+
+TSTreeCursor *ts_tree_cursor_new(const Tree *tree) {
+  TSTreeCursor *self = ts_malloc(sizeof(TSTreeCursor));
+  array_init(&self->stack);
+  if (tree) {
+    array_push(&self->stack, ((TreeCursorEntry){
+      .tree = tree,
+      .position = length_zero(),
+      .child_index = 0,
+    }));
+    if (!tree->visible)
+      ts_tree_cursor_goto_first_child(self);
+  }
+  return self;
+}
+
+void ts_tree_cursor_delete(TSTreeCursor *self) {
+  array_delete(&self->stack);
+  ts_free(self);
+}
+
+bool ts_tree_cursor_goto_first_child(TSTreeCursor *self) {
+  if (self->stack.size == 0)
+    return false;
+
+  TreeCursorEntry *entry = array_back(&self->stack);
+  if (!ts_tree_cursor__has_visible_children(entry->tree))
+    return false;
+
+  const Tree *tree = entry->tree;
+  Length position = entry->position;
+
+  bool did_descend;
+  do {
+    did_descend = false;
+    for (uint32_t i = 0; i < tree->child_count; i++) {
+      const Tree *child = tree->children[i];
+      if (child->visible || ts_tree_cursor__has_visible_children(child)) {
+        array_push(&self->stack, ((TreeCursorEntry){
+          .tree = child,
+          .position = position,
+          .child_index = i,
+        }));
+        if (child->visible)
+          return true;
+        tree = child;
+        did_descend = true;
+        break;
+      }
+      position = length_add(position, ts_tree_total_size(child));
+    }
+  } while (did_descend);
+
+  return false;
+}
+
+bool ts_tree_cursor_goto_next_sibling(TSTreeCursor *self) {
+  if (self->stack.size < 2)
+    return false;
+
+  TreeCursorEntry *child_entry = array_back(&self->stack);
+  for (uint32_t j = self->stack.size - 2; j + 1 > 0; j--) {
+    TreeCursorEntry *parent_entry = &self->stack.contents[j];
+    const Tree *parent = parent_entry->tree;
+    Length position =
+      length_add(child_entry->position, ts_tree_total_size(child_entry->tree));
+
+    for (uint32_t i = child_entry->child_index + 1; i < parent->child_count; i++) {
+      const Tree *child = parent->children[i];
+      if (child->visible || ts_tree_cursor__has_visible_children(child)) {
+        self->stack.contents[j + 1] = (TreeCursorEntry){
+          .tree = child,
+          .position = position,
+          .child_index = i,
+        };
+        self->stack.size = j + 2;
+        return child->visible || ts_tree_cursor_goto_first_child(self);
+      }
+      position = length_add(position, ts_tree_total_size(child));
+    }
+
+    if (parent->visible)
+      break;
+    child_entry = parent_entry;
+  }
+
+  return false;
+}
+
+bool ts_tree_cursor_goto_parent(TSTreeCursor *self) {
+  if (self->stack.size == 0)
+    return false;
+
+  for (uint32_t i = self->stack.size - 1; i > 0; i--) {
+    if (self->stack.contents[i - 1].tree->visible) {
+      self->stack.size = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+TSNode ts_tree_cursor_current_node(const TSTreeCursor *self) {
+  if (self->stack.size == 0)
+    return ts_node_make(NULL, 0, 0, 0);
+
+  TreeCursorEntry *entry = array_back(&self->stack);
+  return ts_node_make(entry->tree, entry->position.chars, entry->position.bytes,
+                      entry->position.extent.row);
+}
@@ -0,0 +1,18 @@
+#ifndef RUNTIME_TREE_CURSOR_H_
+#define RUNTIME_TREE_CURSOR_H_
+
+#include "runtime/tree.h"
+
+typedef struct {
+  const Tree *tree;
+  Length position;
+  uint32_t child_index;
+} TreeCursorEntry;
+
+struct TSTreeCursor {
+  Array(TreeCursorEntry) stack;
+};
+
+TSTreeCursor *ts_tree_cursor_new(const Tree *);
+
+#endif  // RUNTIME_TREE_CURSOR_H_
@@ -0,0 +1,77 @@
+#include "runtime/utf8.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline uint32_t utf8__ascii_prefix_in_word(uint64_t word) {
+  uint64_t high_bits = word & 0x8080808080808080ULL;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_clzll(high_bits) / 8;
+#else
+  return __builtin_ctzll(high_bits) / 8;
+#endif
+}
+
+uint32_t utf8_ascii_prefix_length(const uint8_t *string, uint32_t length) {
+  uint32_t i = 0;
+
+  // Most lookups start on a multi-byte character, right after the previous
+  // ASCII run ended, so check the first byte before touching whole blocks.
+  if (length == 0 || string[0] >= 0x80)
+    return 0;
+
+#if defined(__AVX2__)
+  for (; i + 32 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(string + i));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(block);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+
+#if defined(__SSE2__) || defined(__AVX2__)
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(string + i));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(block);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, string + i, sizeof(word));
+    if (word & 0x8080808080808080ULL)
+      return i + utf8__ascii_prefix_in_word(word);
+  }
+
+  for (; i < length; i++)
+    if (string[i] >= 0x80)
+      return i;
+
+  return length;
+}
+
+uint32_t utf8_char_count(const uint8_t *string, uint32_t length) {
+  uint32_t i = 0, continuation_count = 0;
+
+  // A continuation byte has its high bit set and its second-highest bit
+  // clear. Shifting the word left by one lines each byte's second-highest bit
+  // up with its high bit.
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, string + i, sizeof(word));
+    uint64_t continuation_bits = word & ~(word << 1) & 0x8080808080808080ULL;
+    continuation_count += __builtin_popcountll(continuation_bits);
+  }
+
+  for (; i < length; i++)
+    if ((string[i] & 0xc0) == 0x80)
+      continuation_count++;
+
+  return length - continuation_count;
+}
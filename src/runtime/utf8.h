@@ -0,0 +1,83 @@
+#ifndef RUNTIME_UTF8_H_
+#define RUNTIME_UTF8_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Returns the number of leading bytes in `string` that are ASCII. The input is
+// examined a whole vector register at a time where the target supports it.
+uint32_t utf8_ascii_prefix_length(const uint8_t *string, uint32_t length);
+
+// Returns the number of characters in `string`, which must already be known
+// to be valid UTF8, by counting the bytes that are not continuation bytes.
+uint32_t utf8_char_count(const uint8_t *string, uint32_t length);
+
+// Analogous to utf16_iterate. Reads one code point from the given string and
+// stores it in the location pointed to by `code_point`. Returns the number of
+// bytes in `string` that were read. Malformed sequences (truncated, overlong,
+// surrogate or out-of-range) produce a code point of -1 and consume one byte.
+static inline int utf8_iterate(const uint8_t *string, size_t length,
+                               int32_t *code_point) {
+  if (length == 0) {
+    *code_point = 0;
+    return 0;
+  }
+
+  uint8_t first = string[0];
+  if (first < 0x80) {
+    *code_point = first;
+    return 1;
+  }
+
+  uint32_t result;
+  uint32_t min_value;
+  size_t size;
+  if (first < 0xc2) {
+    goto invalid;
+  } else if (first < 0xe0) {
+    result = first & 0x1f;
+    min_value = 0x80;
+    size = 2;
+  } else if (first < 0xf0) {
+    result = first & 0x0f;
+    min_value = 0x800;
+    size = 3;
+  } else if (first < 0xf5) {
+    result = first & 0x07;
+    min_value = 0x10000;
+    size = 4;
+  } else {
+    goto invalid;
+  }
+
+  if (length < size)
+    goto invalid;
+
+  for (size_t i = 1; i < size; i++) {
+    uint8_t byte = string[i];
+    if ((byte & 0xc0) != 0x80)
+      goto invalid;
+    result = (result << 6) | (byte & 0x3f);
+  }
+
+  if (result < min_value || result > 0x10ffff ||
+      (result >= 0xd800 && result < 0xe000))
+    goto invalid;
+
+  *code_point = result;
+  return size;
+
+invalid:
+  *code_point = -1;
+  return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RUNTIME_UTF8_H_
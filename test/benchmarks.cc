@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "bandit/bandit.h"
+#include "tree_sitter/runtime.h"
+#include "runtime/alloc.h"
+#include "helpers/file_helpers.h"
+#include "helpers/load_language.h"
+#include "helpers/read_test_entries.h"
+#include "helpers/record_alloc.h"
+#include "helpers/spy_input.h"
+
+using std::string;
+using std::vector;
+using std::sort;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+static const char *LANGUAGES[] = {
+  "javascript",
+  "json",
+  "c",
+  "cpp",
+  "python",
+};
+
+struct BenchmarkOptions {
+  bool json_output;
+  const char *language;
+  unsigned repetition_count;
+  size_t synthetic_size;
+  size_t edit_count;
+  unsigned seed;
+};
+
+struct BenchmarkResult {
+  string language;
+  string input_name;
+  size_t input_count;
+  size_t byte_count;
+  size_t token_count;
+  size_t error_count;
+  size_t allocation_count;
+  uint64_t nanoseconds;
+  unsigned repetition_count;
+  size_t peak_rss_bytes;
+};
+
+enum EditKind {
+  EditKindInsertCharacter,
+  EditKindDeleteCharacter,
+  EditKindPasteLine,
+  EditKindDeleteBlock,
+};
+
+struct Edit {
+  EditKind kind;
+  size_t start_byte;
+  size_t bytes_removed;
+  string text_inserted;
+};
+
+struct EditBenchmarkResult {
+  string language;
+  size_t byte_count;
+  size_t edit_count;
+  uint64_t initial_parse_nanoseconds;
+  uint64_t p50_nanoseconds;
+  uint64_t p99_nanoseconds;
+  uint64_t max_nanoseconds;
+  uint64_t total_nanoseconds;
+  size_t bytes_lexed;
+  size_t reused_subtree_count;
+  size_t reused_bytes;
+  size_t changed_range_count;
+};
+
+static size_t peak_rss_bytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024;
+#endif
+}
+
+static size_t count_tokens(const TSDocument *document, bool *has_error) {
+  TSTreeCursor *cursor = ts_document_tree_cursor(document);
+  size_t result = 0;
+  *has_error = false;
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(cursor);
+    if (strcmp(ts_node_type(node, document), "ERROR") == 0) {
+      *has_error = true;
+    }
+    if (ts_tree_cursor_goto_first_child(cursor)) continue;
+    result++;
+    while (!ts_tree_cursor_goto_next_sibling(cursor)) {
+      if (!ts_tree_cursor_goto_parent(cursor)) {
+        ts_tree_cursor_delete(cursor);
+        return result;
+      }
+    }
+  }
+}
+
+static TSDocument *parse(const TSLanguage *language, const string &input) {
+  TSDocument *document = ts_document_new();
+  ts_document_set_language(document, language);
+  ts_document_set_input_string_with_length(document, input.data(), input.size());
+  ts_document_parse(document);
+  return document;
+}
+
+// Builds one large input out of the valid corpus entries, repeating them until
+// the input reaches the given size. JSON documents can't simply be
+// concatenated, so in that case the entries become the elements of one large
+// array.
+static string synthesize_input(const string &language, const vector<TestEntry> &entries,
+                               size_t size) {
+  vector<const TestEntry *> valid_entries;
+  for (const TestEntry &entry : entries) {
+    if (entry.tree_string.find("ERROR") == string::npos) {
+      valid_entries.push_back(&entry);
+    }
+  }
+  if (valid_entries.empty()) return "";
+
+  bool is_json = language == "json";
+  string result = is_json ? "[\n" : "";
+  while (result.size() < size) {
+    for (const TestEntry *entry : valid_entries) {
+      if (is_json && result.size() > 2) result += ",\n";
+      result += entry->input;
+      result += "\n";
+    }
+  }
+  if (is_json) result += "]\n";
+  return result;
+}
+
+static size_t line_start(const string &content, size_t byte) {
+  size_t newline = byte == 0 ? string::npos : content.rfind('\n', byte - 1);
+  return newline == string::npos ? 0 : newline + 1;
+}
+
+static size_t line_end(const string &content, size_t byte) {
+  size_t newline = content.find('\n', byte);
+  return newline == string::npos ? content.size() : newline + 1;
+}
+
+// Records a sequence of edits resembling those made in an editor: typing or
+// deleting single characters, pasting a copy of a line, and deleting blocks
+// of whole lines. Each edit is computed against the content produced by the
+// edits before it, so the sequence must be replayed in order.
+static vector<Edit> record_edits(string content, size_t count) {
+  static const char TYPED_CHARACTERS[] = "abcdefghijklmnopqrstuvwxyz0123456789 (){}[]:;,.\"\n";
+
+  vector<Edit> result;
+  while (result.size() < count && !content.empty()) {
+    Edit edit = {};
+    edit.kind = static_cast<EditKind>(random() % 4);
+    size_t position = random() % content.size();
+
+    switch (edit.kind) {
+      case EditKindInsertCharacter:
+        edit.start_byte = position;
+        edit.text_inserted = string(1, TYPED_CHARACTERS[random() % (sizeof(TYPED_CHARACTERS) - 1)]);
+        break;
+
+      case EditKindDeleteCharacter:
+        edit.start_byte = position;
+        edit.bytes_removed = 1;
+        break;
+
+      case EditKindPasteLine: {
+        size_t source_start = line_start(content, random() % content.size());
+        size_t source_end = line_end(content, source_start);
+        edit.start_byte = line_start(content, position);
+        edit.text_inserted = content.substr(source_start, source_end - source_start);
+        break;
+      }
+
+      case EditKindDeleteBlock: {
+        edit.start_byte = line_start(content, position);
+        size_t end = edit.start_byte;
+        for (unsigned line_count = 1 + random() % 10; line_count > 0; line_count--) {
+          end = line_end(content, end);
+        }
+        edit.bytes_removed = end - edit.start_byte;
+        break;
+      }
+    }
+
+    content.replace(edit.start_byte, edit.bytes_removed, edit.text_inserted);
+    result.push_back(edit);
+  }
+  return result;
+}
+
+// Replays the edits against the given input, measuring the latency of each
+// reparse and collecting the work that it did from the parse stats.
+static EditBenchmarkResult run_edit_benchmark(const string &language_name,
+                                              const TSLanguage *language,
+                                              const string &content,
+                                              const vector<Edit> &edits) {
+  EditBenchmarkResult result = {};
+  result.language = language_name;
+  result.byte_count = content.size();
+  result.edit_count = edits.size();
+
+  vector<uint64_t> latencies;
+  SpyInput input(content, 1024);
+  TSDocument *document = ts_document_new();
+  ts_document_set_language(document, language);
+  ts_document_set_input(document, input.input());
+
+  auto start = steady_clock::now();
+  ts_document_parse(document);
+  result.initial_parse_nanoseconds = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+  for (const Edit &edit : edits) {
+    ts_document_edit(document, input.replace(edit.start_byte, edit.bytes_removed, edit.text_inserted));
+    input.strings_read.assign(1, "");
+
+    TSRange *ranges;
+    uint32_t range_count;
+    auto start = steady_clock::now();
+    ts_document_parse_and_get_changed_ranges(document, &ranges, &range_count);
+    uint64_t latency = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    ts_free(ranges);
+
+    latencies.push_back(latency);
+    result.total_nanoseconds += latency;
+    result.changed_range_count += range_count;
+
+    TSParseStats stats = ts_document_parse_stats(document);
+    result.bytes_lexed += stats.bytes_lexed;
+    result.reused_subtree_count += stats.reused_subtree_count;
+    result.reused_bytes += stats.reused_bytes;
+  }
+
+  ts_document_free(document);
+
+  sort(latencies.begin(), latencies.end());
+  if (!latencies.empty()) {
+    result.p50_nanoseconds = latencies[latencies.size() / 2];
+    result.p99_nanoseconds = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    result.max_nanoseconds = latencies.back();
+  }
+
+  return result;
+}
+
+static BenchmarkResult run_benchmark(const string &language_name, const TSLanguage *language,
+                                     const string &input_name, const vector<string> &inputs,
+                                     unsigned repetition_count) {
+  BenchmarkResult result = {};
+  result.language = language_name;
+  result.input_name = input_name;
+  result.input_count = inputs.size();
+  result.repetition_count = repetition_count;
+
+  for (unsigned i = 0; i < repetition_count; i++) {
+    for (const string &input : inputs) {
+      auto start = steady_clock::now();
+      TSDocument *document = parse(language, input);
+      result.nanoseconds += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+      ts_document_free(document);
+    }
+  }
+
+  // The peak RSS is measured for the whole process, so it includes the
+  // memory used by any earlier benchmarks.
+  result.peak_rss_bytes = peak_rss_bytes();
+
+  // Measure the allocations and the size of the trees in a separate pass, so
+  // that the bookkeeping doesn't count toward the parse time or the RSS.
+  for (const string &input : inputs) {
+    record_alloc::start();
+    TSDocument *document = parse(language, input);
+    record_alloc::stop();
+    result.allocation_count += record_alloc::allocation_count();
+    result.byte_count += input.size();
+    bool has_error;
+    result.token_count += count_tokens(document, &has_error);
+    if (has_error) result.error_count++;
+    ts_document_free(document);
+  }
+
+  return result;
+}
+
+static double bytes_per_second(const BenchmarkResult &result) {
+  if (result.nanoseconds == 0) return 0;
+  return result.byte_count * result.repetition_count * 1e9 / result.nanoseconds;
+}
+
+static double nanoseconds_per_token(const BenchmarkResult &result) {
+  if (result.token_count == 0) return 0;
+  return static_cast<double>(result.nanoseconds) / (result.token_count * result.repetition_count);
+}
+
+static double allocations_per_kilobyte(const BenchmarkResult &result) {
+  if (result.byte_count == 0) return 0;
+  return result.allocation_count * 1024.0 / result.byte_count;
+}
+
+static void print_text(const vector<BenchmarkResult> &results,
+                       const vector<EditBenchmarkResult> &edit_results) {
+  printf("%-12s %-10s %10s %10s %14s %12s %12s %14s\n", "language", "input", "bytes",
+         "tokens", "bytes/sec", "ns/token", "allocs/KB", "peak RSS (KB)");
+  for (const BenchmarkResult &result : results) {
+    printf("%-12s %-10s %10lu %10lu %14.0f %12.1f %12.2f %14lu\n",
+           result.language.c_str(), result.input_name.c_str(),
+           (unsigned long)result.byte_count, (unsigned long)result.token_count,
+           bytes_per_second(result), nanoseconds_per_token(result),
+           allocations_per_kilobyte(result), (unsigned long)(result.peak_rss_bytes / 1024));
+    if (result.error_count > 0) {
+      printf("  warning: %lu of %lu inputs contained errors\n",
+             (unsigned long)result.error_count, (unsigned long)result.input_count);
+    }
+  }
+
+  if (edit_results.empty()) return;
+  printf("\n%-12s %10s %8s %12s %12s %12s %14s %12s %14s\n", "language", "bytes", "edits",
+         "p50 (us)", "p99 (us)", "max (us)", "bytes lexed", "reused", "reused bytes");
+  for (const EditBenchmarkResult &result : edit_results) {
+    printf("%-12s %10lu %8lu %12.1f %12.1f %12.1f %14lu %12lu %14lu\n",
+           result.language.c_str(), (unsigned long)result.byte_count,
+           (unsigned long)result.edit_count, result.p50_nanoseconds / 1000.0,
+           result.p99_nanoseconds / 1000.0, result.max_nanoseconds / 1000.0,
+           (unsigned long)result.bytes_lexed, (unsigned long)result.reused_subtree_count,
+           (unsigned long)result.reused_bytes);
+  }
+}
+
+static void print_json(const vector<BenchmarkResult> &results,
+                       const vector<EditBenchmarkResult> &edit_results) {
+  printf("{\n  \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult &result = results[i];
+    printf(i > 0 ? ",\n" : "\n");
+    printf("    {\n");
+    printf("      \"language\": \"%s\",\n", result.language.c_str());
+    printf("      \"input\": \"%s\",\n", result.input_name.c_str());
+    printf("      \"input_count\": %lu,\n", (unsigned long)result.input_count);
+    printf("      \"error_count\": %lu,\n", (unsigned long)result.error_count);
+    printf("      \"repetition_count\": %u,\n", result.repetition_count);
+    printf("      \"bytes\": %lu,\n", (unsigned long)result.byte_count);
+    printf("      \"tokens\": %lu,\n", (unsigned long)result.token_count);
+    printf("      \"nanoseconds\": %llu,\n", (unsigned long long)result.nanoseconds);
+    printf("      \"bytes_per_second\": %.0f,\n", bytes_per_second(result));
+    printf("      \"nanoseconds_per_token\": %.2f,\n", nanoseconds_per_token(result));
+    printf("      \"allocations\": %lu,\n", (unsigned long)result.allocation_count);
+    printf("      \"allocations_per_kilobyte\": %.3f,\n", allocations_per_kilobyte(result));
+    printf("      \"peak_rss_bytes\": %lu\n", (unsigned long)result.peak_rss_bytes);
+    printf("    }");
+  }
+  printf("\n  ],\n  \"edit_benchmarks\": [");
+  for (size_t i = 0; i < edit_results.size(); i++) {
+    const EditBenchmarkResult &result = edit_results[i];
+    printf(i > 0 ? ",\n" : "\n");
+    printf("    {\n");
+    printf("      \"language\": \"%s\",\n", result.language.c_str());
+    printf("      \"bytes\": %lu,\n", (unsigned long)result.byte_count);
+    printf("      \"edit_count\": %lu,\n", (unsigned long)result.edit_count);
+    printf("      \"initial_parse_nanoseconds\": %llu,\n",
+           (unsigned long long)result.initial_parse_nanoseconds);
+    printf("      \"p50_nanoseconds\": %llu,\n", (unsigned long long)result.p50_nanoseconds);
+    printf("      \"p99_nanoseconds\": %llu,\n", (unsigned long long)result.p99_nanoseconds);
+    printf("      \"max_nanoseconds\": %llu,\n", (unsigned long long)result.max_nanoseconds);
+    printf("      \"total_nanoseconds\": %llu,\n", (unsigned long long)result.total_nanoseconds);
+    printf("      \"bytes_lexed\": %lu,\n", (unsigned long)result.bytes_lexed);
+    printf("      \"reused_subtree_count\": %lu,\n", (unsigned long)result.reused_subtree_count);
+    printf("      \"reused_bytes\": %lu,\n", (unsigned long)result.reused_bytes);
+    printf("      \"changed_range_count\": %lu\n", (unsigned long)result.changed_range_count);
+    printf("    }");
+  }
+  printf("\n  ]\n}\n");
+}
+
+static bool parse_options(int argc, char *argv[], BenchmarkOptions *options) {
+  options->json_output = false;
+  options->language = nullptr;
+  options->repetition_count = 5;
+  options->synthetic_size = 1024 * 1024;
+  options->edit_count = 100;
+  options->seed = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--json") == 0) {
+      options->json_output = true;
+    } else if (strncmp(arg, "--language=", 11) == 0) {
+      options->language = arg + 11;
+    } else if (strncmp(arg, "--repetitions=", 14) == 0) {
+      options->repetition_count = atoi(arg + 14);
+    } else if (strncmp(arg, "--synthetic-size=", 17) == 0) {
+      options->synthetic_size = atol(arg + 17);
+    } else if (strncmp(arg, "--edits=", 8) == 0) {
+      options->edit_count = atol(arg + 8);
+    } else if (strncmp(arg, "--seed=", 7) == 0) {
+      options->seed = atoi(arg + 7);
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return false;
+    }
+  }
+
+  if (options->repetition_count == 0) options->repetition_count = 1;
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  BenchmarkOptions options;
+  if (!parse_options(argc, argv, &options)) {
+    fprintf(stderr, "Usage: %s [--json] [--language=NAME] [--repetitions=N] "
+                    "[--synthetic-size=BYTES] [--edits=N] [--seed=N]\n", argv[0]);
+    return 1;
+  }
+
+  vector<BenchmarkResult> results;
+  vector<EditBenchmarkResult> edit_results;
+
+  for (const char *language_name : LANGUAGES) {
+    if (options.language && strcmp(options.language, language_name) != 0) continue;
+
+    string corpus_directory = string("test/fixtures/grammars/") + language_name + "/grammar_test";
+    if (!file_exists(corpus_directory)) {
+      fprintf(stderr, "Skipping %s: no corpus found. Run script/fetch-fixtures.\n", language_name);
+      continue;
+    }
+
+    vector<TestEntry> entries = read_real_language_corpus(language_name);
+    if (entries.empty()) {
+      fprintf(stderr, "Skipping %s: no corpus found. Run script/fetch-fixtures.\n", language_name);
+      continue;
+    }
+
+    // The language helpers report failures as assertions.
+    const TSLanguage *language = nullptr;
+    try {
+      language = load_real_language(language_name);
+    } catch (const snowhouse::AssertionException &exception) {
+      fprintf(stderr, "%s\n", exception.GetMessage().c_str());
+    }
+    if (!language) {
+      fprintf(stderr, "Skipping %s: the parser could not be loaded.\n", language_name);
+      continue;
+    }
+
+    vector<string> corpus_inputs;
+    for (const TestEntry &entry : entries) corpus_inputs.push_back(entry.input);
+    results.push_back(run_benchmark(
+      language_name, language, "corpus", corpus_inputs, options.repetition_count
+    ));
+
+    string synthetic_input = synthesize_input(language_name, entries, options.synthetic_size);
+    if (!synthetic_input.empty()) {
+      results.push_back(run_benchmark(
+        language_name, language, "synthetic", {synthetic_input}, options.repetition_count
+      ));
+
+      // The edit stream depends only on the seed and the input, so runs of
+      // the benchmark with the same seed can be compared with each other.
+      if (options.edit_count > 0) {
+        srandom(options.seed);
+        vector<Edit> edits = record_edits(synthetic_input, options.edit_count);
+        edit_results.push_back(run_edit_benchmark(
+          language_name, language, synthetic_input, edits
+        ));
+      }
+    }
+  }
+
+  if (options.json_output) {
+    print_json(results, edit_results);
+  } else {
+    print_text(results, edit_results);
+  }
+
+  return results.empty() ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#include "test_helper.h"
+#include "compiler/build_tables/build_parse_table.h"
+#include "compiler/prepare_grammar/prepare_grammar.h"
+#include "compiler/parse_grammar.h"
+#include "compiler/syntax_grammar.h"
+#include "compiler/lexical_grammar.h"
+#include "helpers/file_helpers.h"
+#include "helpers/stream_methods.h"
+
+using namespace build_tables;
+using namespace rules;
+
+START_TEST
+
+describe("build_parse_table", []() {
+  it("produces the same parse table regardless of the number of threads", [&]() {
+    ParseGrammarResult parse_result = parse_grammar(
+      read_file("test/fixtures/grammars/json/src/grammar.json")
+    );
+    AssertThat(parse_result.error_message, IsEmpty());
+
+    auto prepare_result = prepare_grammar::prepare_grammar(parse_result.grammar);
+    const SyntaxGrammar &syntax_grammar = get<0>(prepare_result);
+    const LexicalGrammar &lexical_grammar = get<1>(prepare_result);
+
+    auto serial_result = build_parse_table(syntax_grammar, lexical_grammar, 1);
+    AssertThat(serial_result.second, Equals(CompileError::none()));
+    AssertThat(serial_result.first.states.size(), IsGreaterThan(1u));
+
+    for (unsigned thread_count : vector<unsigned>({ 2, 3, 8 })) {
+      auto parallel_result = build_parse_table(syntax_grammar, lexical_grammar, thread_count);
+      AssertThat(parallel_result.second, Equals(CompileError::none()));
+      AssertThat(parallel_result.first.states.size(), Equals(serial_result.first.states.size()));
+      AssertThat(parallel_result.first.states == serial_result.first.states, IsTrue());
+    }
+  });
+});
+
+describe("merge_equivalent_parse_states", []() {
+  Symbol x = Symbol::terminal(0);
+  Symbol y = Symbol::terminal(1);
+  Symbol z = Symbol::terminal(2);
+  ParseTable table;
+
+  before_each([&]() {
+    table = ParseTable();
+  });
+
+  auto add_state = [&]() {
+    table.states.push_back(ParseState());
+    table.states.back().shift_actions_signature = 0;
+    return table.states.size() - 1;
+  };
+
+  it("merges states that refer to each other in cycles", [&]() {
+    ParseStateId start_state = add_state();
+    ParseStateId state1 = add_state();
+    ParseStateId state2 = add_state();
+    table.add_terminal_action(start_state, y, ParseAction::Shift(state1));
+    table.add_terminal_action(start_state, x, ParseAction::Shift(state2));
+    table.add_terminal_action(state1, x, ParseAction::Shift(state2));
+    table.add_terminal_action(state1, END_OF_INPUT(), ParseAction::Accept());
+    table.add_terminal_action(state2, x, ParseAction::Shift(state1));
+    table.add_terminal_action(state2, END_OF_INPUT(), ParseAction::Accept());
+
+    // Each state's shift refers to the other one, so merging pairs of identical
+    // states would never merge them.
+    AssertThat(table.states[state1] == table.states[state2], IsFalse());
+
+    set<ParseStateId> deleted_states;
+    merge_equivalent_parse_states(&table, &deleted_states);
+    AssertThat(deleted_states, Equals(set<ParseStateId>({ state2 })));
+    AssertThat(table.states[start_state].terminal_entries[x].actions[0].state_index, Equals(state1));
+    AssertThat(table.states[start_state].terminal_entries[y].actions[0].state_index, Equals(state1));
+    AssertThat(table.states[state1].terminal_entries[x].actions[0].state_index, Equals(state1));
+  });
+
+  it("does not merge states whose successors differ", [&]() {
+    ParseStateId start_state = add_state();
+    ParseStateId state1 = add_state();
+    ParseStateId state2 = add_state();
+    ParseStateId state3 = add_state();
+    ParseStateId state4 = add_state();
+    table.add_terminal_action(start_state, y, ParseAction::Shift(state1));
+    table.add_terminal_action(start_state, z, ParseAction::Shift(state2));
+    table.add_terminal_action(state1, x, ParseAction::Shift(state3));
+    table.add_terminal_action(state2, x, ParseAction::Shift(state4));
+    table.add_terminal_action(state3, x, ParseAction::Shift(state1));
+    table.add_terminal_action(state4, x, ParseAction::Shift(state2));
+    table.add_terminal_action(state4, END_OF_INPUT(), ParseAction::Accept());
+
+    // The first cycle's states are equivalent to each other, but the second
+    // cycle's states differ from them, because one of them can accept.
+    set<ParseStateId> deleted_states;
+    merge_equivalent_parse_states(&table, &deleted_states);
+    AssertThat(deleted_states, Equals(set<ParseStateId>({ state3 })));
+    AssertThat(table.states[state1].terminal_entries[x].actions[0].state_index, Equals(state1));
+    AssertThat(table.states[state2].terminal_entries[x].actions[0].state_index, Equals(state4));
+  });
+});
+
+END_TEST
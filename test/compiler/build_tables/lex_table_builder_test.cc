@@ -0,0 +1,48 @@
+#include "test_helper.h"
+#include "compiler/build_tables/lex_table_builder.h"
+#include "compiler/lexical_grammar.h"
+#include "compiler/parse_table.h"
+#include "compiler/rule.h"
+#include "helpers/stream_methods.h"
+
+using namespace rules;
+using namespace build_tables;
+
+START_TEST
+
+describe("LexTableBuilder", []() {
+  describe("build(parse_table)", [&]() {
+    it("merges lex states that are equivalent but were reached through different items", [&]() {
+      LexicalGrammar grammar{{
+        LexicalVariable{"token_0", VariableTypeNamed, Rule::choice({
+          Rule::seq({
+            CharacterSet{{ 'a' }},
+            Metadata::prec(1, Rule::seq({ CharacterSet{{ 'c' }}, CharacterSet{{ 'd' }} })),
+          }),
+          Rule::seq({
+            CharacterSet{{ 'b' }},
+            Metadata::prec(2, Rule::seq({ CharacterSet{{ 'c' }}, CharacterSet{{ 'd' }} })),
+          }),
+        }), false},
+      }, {}};
+
+      ParseTable parse_table;
+      parse_table.states.push_back(ParseState());
+      parse_table.states[0].terminal_entries[Symbol::terminal(0)];
+
+      LexTable lex_table = LexTableBuilder::create(grammar)->build(&parse_table);
+
+      // The start state, the state after 'a' or 'b', the state after 'c' and
+      // the accepting state.
+      AssertThat(lex_table.states.size(), Equals(4u));
+      AssertThat(parse_table.states[0].lex_state_id, Equals(0));
+
+      const LexState &start_state = lex_table.states[0];
+      AssertThat(start_state.advance_actions.size(), Equals(2u));
+      for (const auto &entry : start_state.advance_actions)
+        AssertThat(entry.second.state_index, Equals(1));
+    });
+  });
+});
+
+END_TEST
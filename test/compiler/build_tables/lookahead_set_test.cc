@@ -0,0 +1,92 @@
+#include "test_helper.h"
+#include "compiler/build_tables/lookahead_set.h"
+#include "compiler/rule.h"
+#include "helpers/stream_methods.h"
+
+using namespace rules;
+using namespace build_tables;
+
+START_TEST
+
+describe("LookaheadSet", []() {
+  auto symbols_in = [](const LookaheadSet &lookaheads) {
+    vector<Symbol> result;
+    lookaheads.for_each([&](const Symbol &symbol) { result.push_back(symbol); });
+    return result;
+  };
+
+  describe("insert(symbol)", [&]() {
+    it("adds terminals, external tokens and the end-of-input symbol", [&]() {
+      LookaheadSet lookaheads;
+      AssertThat(lookaheads.empty(), IsTrue());
+
+      AssertThat(lookaheads.insert(Symbol::terminal(200)), IsTrue());
+      AssertThat(lookaheads.insert(Symbol::external(3)), IsTrue());
+      AssertThat(lookaheads.insert(END_OF_INPUT()), IsTrue());
+      AssertThat(lookaheads.insert(Symbol::terminal(200)), IsFalse());
+
+      AssertThat(lookaheads.empty(), IsFalse());
+      AssertThat(lookaheads.contains(Symbol::terminal(200)), IsTrue());
+      AssertThat(lookaheads.contains(Symbol::terminal(199)), IsFalse());
+      AssertThat(lookaheads.contains(Symbol::terminal(3)), IsFalse());
+      AssertThat(lookaheads.contains(Symbol::external(3)), IsTrue());
+      AssertThat(lookaheads.contains(Symbol::external(300)), IsFalse());
+      AssertThat(lookaheads.contains(END_OF_INPUT()), IsTrue());
+    });
+  });
+
+  describe("for_each(callback)", [&]() {
+    it("visits the symbols in the same order as a std::set", [&]() {
+      set<Symbol> symbols({
+        Symbol::terminal(0),
+        Symbol::terminal(63),
+        Symbol::terminal(64),
+        Symbol::terminal(130),
+        Symbol::external(1),
+        Symbol::external(70),
+        END_OF_INPUT(),
+      });
+
+      AssertThat(symbols_in(LookaheadSet(symbols)), Equals(vector<Symbol>(symbols.begin(), symbols.end())));
+    });
+  });
+
+  describe("insert_all(other)", [&]() {
+    it("returns true only if new symbols were added", [&]() {
+      LookaheadSet lookaheads({ Symbol::terminal(1), Symbol::terminal(100) });
+
+      AssertThat(lookaheads.insert_all(LookaheadSet({ Symbol::terminal(1) })), IsFalse());
+      AssertThat(lookaheads.insert_all(LookaheadSet()), IsFalse());
+      AssertThat(lookaheads.insert_all(LookaheadSet({
+        Symbol::terminal(1),
+        Symbol::terminal(300),
+      })), IsTrue());
+
+      AssertThat(lookaheads, Equals(LookaheadSet({
+        Symbol::terminal(1),
+        Symbol::terminal(100),
+        Symbol::terminal(300),
+      })));
+    });
+  });
+
+  describe("operator==(other) and hash()", [&]() {
+    it("compares sets by their contents", [&]() {
+      LookaheadSet lookaheads1({ Symbol::terminal(1), Symbol::terminal(500) });
+      LookaheadSet lookaheads2({ Symbol::terminal(1) });
+      size_t original_hash = lookaheads2.hash();
+
+      AssertThat(lookaheads2, !Equals(lookaheads1));
+      lookaheads2.insert_all(lookaheads1);
+      AssertThat(lookaheads2, Equals(lookaheads1));
+      AssertThat(lookaheads2.hash(), Equals(lookaheads1.hash()));
+      AssertThat(lookaheads2.hash(), !Equals(original_hash));
+
+      LookaheadSet lookaheads3({ Symbol::terminal(1), Symbol::external(500) });
+      AssertThat(lookaheads3, !Equals(lookaheads1));
+      AssertThat(lookaheads3.hash(), !Equals(lookaheads1.hash()));
+    });
+  });
+});
+
+END_TEST
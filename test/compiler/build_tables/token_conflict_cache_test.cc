@@ -0,0 +1,95 @@
+#include "test_helper.h"
+#include "compiler/build_tables/build_parse_table.h"
+#include "compiler/build_tables/token_conflict_cache.h"
+#include "compiler/prepare_grammar/prepare_grammar.h"
+#include "compiler/parse_grammar.h"
+#include "compiler/syntax_grammar.h"
+#include "compiler/lexical_grammar.h"
+#include "helpers/file_helpers.h"
+#include "helpers/stream_methods.h"
+
+using namespace rules;
+using namespace build_tables;
+
+START_TEST
+
+describe("TokenConflictCache", []() {
+  SyntaxGrammar syntax_grammar;
+  LexicalGrammar lexical_grammar;
+
+  before_each([&]() {
+    ParseGrammarResult parse_result = parse_grammar(
+      read_file("test/fixtures/grammars/json/src/grammar.json")
+    );
+    auto prepare_result = prepare_grammar::prepare_grammar(parse_result.grammar);
+    syntax_grammar = get<0>(prepare_result);
+    lexical_grammar = get<1>(prepare_result);
+  });
+
+  auto build = [&](TokenConflictCache *cache, TSCompileStats *stats) {
+    *stats = TSCompileStats();
+    return build_parse_table(syntax_grammar, lexical_grammar, 1, stats, cache);
+  };
+
+  it("reuses the results for unchanged pairs of tokens across compilations", [&]() {
+    TokenConflictCache cache;
+    TSCompileStats stats;
+    uint32_t token_count = lexical_grammar.variables.size();
+    uint32_t pair_count = token_count * (token_count - 1);
+
+    auto first_result = build(&cache, &stats);
+    AssertThat(stats.token_conflict_cache_miss_count, Equals(pair_count));
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(0u));
+
+    auto second_result = build(&cache, &stats);
+    AssertThat(stats.token_conflict_cache_miss_count, Equals(0u));
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(pair_count));
+    AssertThat(second_result.first.states == first_result.first.states, IsTrue());
+
+    // Only the pairs that include the edited token are checked again.
+    lexical_grammar.variables[1].rule = CharacterSet{{ '~' }};
+    auto edited_result = build(&cache, &stats);
+    AssertThat(stats.token_conflict_cache_miss_count, Equals(2 * (token_count - 1)));
+
+    auto uncached_result = build(nullptr, &stats);
+    AssertThat(stats.token_conflict_cache_miss_count, Equals(pair_count));
+    AssertThat(uncached_result.first.states == edited_result.first.states, IsTrue());
+  });
+
+  it("keeps its results when it is serialized and deserialized", [&]() {
+    TokenConflictCache cache;
+    TSCompileStats stats;
+    auto first_result = build(&cache, &stats);
+    uint32_t pair_count = stats.token_conflict_cache_miss_count;
+
+    TokenConflictCache loaded_cache;
+    AssertThat(loaded_cache.deserialize(cache.serialize()), IsTrue());
+    auto second_result = build(&loaded_cache, &stats);
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(pair_count));
+    AssertThat(stats.token_conflict_cache_miss_count, Equals(0u));
+    AssertThat(second_result.first.states == first_result.first.states, IsTrue());
+    AssertThat(loaded_cache.serialize(), Equals(cache.serialize()));
+  });
+
+  it("ignores malformed serialized data", [&]() {
+    TokenConflictCache cache;
+    TSCompileStats stats;
+    build(&cache, &stats);
+    string data = cache.serialize();
+
+    TokenConflictCache loaded_cache;
+    for (size_t length = 0; length < data.size(); length += 7) {
+      AssertThat(loaded_cache.deserialize(data.substr(0, length)), IsFalse());
+    }
+    AssertThat(loaded_cache.deserialize(data + '\0'), IsFalse());
+
+    string other_version = data;
+    other_version[0]++;
+    AssertThat(loaded_cache.deserialize(other_version), IsFalse());
+
+    build(&loaded_cache, &stats);
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(0u));
+  });
+});
+
+END_TEST
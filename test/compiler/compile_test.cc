@@ -0,0 +1,133 @@
+#include "test_helper.h"
+#include "helpers/file_helpers.h"
+#include "tree_sitter/compiler.h"
+
+START_TEST
+
+describe("ts_compile_grammar_with_stats(grammar, stats)", []() {
+  string grammar_json;
+
+  before_each([&]() {
+    grammar_json = read_file("test/fixtures/grammars/json/src/grammar.json");
+  });
+
+  it("generates the same code as ts_compile_grammar", [&]() {
+    TSCompileStats stats;
+    TSCompileResult result = ts_compile_grammar_with_stats(grammar_json.c_str(), &stats);
+    TSCompileResult expected = ts_compile_grammar(grammar_json.c_str());
+    AssertThat(result.error_message, Equals<const char *>(nullptr));
+    AssertThat(string(result.code), Equals(string(expected.code)));
+    free(result.code);
+    free(expected.code);
+  });
+
+  it("records the number of item sets and states", [&]() {
+    TSCompileStats stats;
+    TSCompileResult result = ts_compile_grammar_with_stats(grammar_json.c_str(), &stats);
+    free(result.code);
+
+    AssertThat(stats.parse_state_count, IsGreaterThan(0u));
+    AssertThat(stats.item_set_count >= stats.parse_state_count, IsTrue());
+    AssertThat(stats.closure_expansion_count, IsGreaterThan(0u));
+    AssertThat(stats.lex_state_count, IsGreaterThan(0u));
+    AssertThat(stats.lex_item_set_count >= stats.lex_state_count, IsTrue());
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(0u));
+    AssertThat(stats.token_conflict_cache_miss_count, IsGreaterThan(0u));
+    AssertThat(stats.peak_memory_bytes, IsGreaterThan(0u));
+  });
+
+  it("doesn't reuse results between compilations without a cache", [&]() {
+    TSCompileStats stats;
+    free(ts_compile_grammar_with_stats(grammar_json.c_str(), &stats).code);
+    uint32_t miss_count = stats.token_conflict_cache_miss_count;
+
+    free(ts_compile_grammar_with_stats(grammar_json.c_str(), &stats).code);
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(0u));
+    AssertThat(stats.token_conflict_cache_miss_count, Equals(miss_count));
+  });
+
+  it("records token conflict cache hits on subsequent compilations with a cache", [&]() {
+    TSCompileCache *cache = ts_compile_cache_new();
+    TSCompileStats stats;
+    TSCompileResult first_result = ts_compile_grammar_with_cache(grammar_json.c_str(), cache, &stats);
+    uint32_t miss_count = stats.token_conflict_cache_miss_count;
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(0u));
+
+    // The results survive serialization, so they can be reused by another process.
+    size_t length;
+    char *data = ts_compile_cache_serialize(cache, &length);
+    ts_compile_cache_free(cache);
+    cache = ts_compile_cache_load(data, length);
+    AssertThat(cache, !Equals<TSCompileCache *>(nullptr));
+    AssertThat(ts_compile_cache_load(data, length - 1), Equals<TSCompileCache *>(nullptr));
+    free(data);
+
+    TSCompileResult second_result = ts_compile_grammar_with_cache(grammar_json.c_str(), cache, &stats);
+    AssertThat(stats.token_conflict_cache_hit_count, Equals(miss_count));
+    AssertThat(stats.token_conflict_cache_miss_count, Equals(0u));
+    AssertThat(string(second_result.code), Equals(string(first_result.code)));
+
+    free(first_result.code);
+    free(second_result.code);
+    ts_compile_cache_free(cache);
+  });
+
+  it("reuses the prepared grammar when the next grammar has the same rules", [&]() {
+    TSCompileCache *cache = ts_compile_cache_new();
+    TSCompileStats stats;
+    TSCompileResult first_result = ts_compile_grammar_with_cache(grammar_json.c_str(), cache, &stats);
+    AssertThat(stats.prepared_grammar_cache_hit_count, Equals(0u));
+
+    // Formatting isn't part of the grammar's content.
+    string reformatted_json = grammar_json;
+    reformatted_json.insert(1, "\n\n");
+    TSCompileResult second_result = ts_compile_grammar_with_cache(reformatted_json.c_str(), cache, &stats);
+    AssertThat(stats.prepared_grammar_cache_hit_count, Equals(1u));
+    AssertThat(string(second_result.code), Equals(string(first_result.code)));
+
+    string edited_json = grammar_json;
+    string null_rule = "\"value\": \"null\"";
+    size_t index = edited_json.find(null_rule);
+    AssertThat(index, !Equals(string::npos));
+    edited_json.replace(index, null_rule.size(), "\"value\": \"nil\"");
+    TSCompileResult third_result = ts_compile_grammar_with_cache(edited_json.c_str(), cache, &stats);
+    AssertThat(third_result.error_message, Equals<const char *>(nullptr));
+    AssertThat(stats.prepared_grammar_cache_hit_count, Equals(0u));
+    AssertThat(string(third_result.code), !Equals(string(first_result.code)));
+
+    free(first_result.code);
+    free(second_result.code);
+    free(third_result.code);
+    ts_compile_cache_free(cache);
+  });
+
+  it("records a total time that covers each phase", [&]() {
+    TSCompileStats stats;
+    free(ts_compile_grammar_with_stats(grammar_json.c_str(), &stats).code);
+
+    uint64_t phase_total =
+      stats.parse_grammar_micros +
+      stats.intern_symbols_micros +
+      stats.extract_tokens_micros +
+      stats.expand_repeats_micros +
+      stats.flatten_grammar_micros +
+      stats.normalize_rules_micros +
+      stats.item_set_closure_micros +
+      stats.add_actions_micros +
+      stats.unmergable_token_pairs_micros +
+      stats.merge_parse_states_micros +
+      stats.lex_table_micros +
+      stats.code_generation_micros;
+    AssertThat(stats.total_micros, IsGreaterThan(0u));
+    AssertThat(stats.total_micros >= phase_total, IsTrue());
+  });
+
+  it("resets the stats before each compilation", [&]() {
+    TSCompileStats stats;
+    memset(&stats, 0xff, sizeof(stats));
+    free(ts_compile_grammar_with_stats(grammar_json.c_str(), &stats).code);
+    AssertThat(stats.total_micros < 60u * 1000 * 1000, IsTrue());
+  });
+});
+
+END_TEST
@@ -0,0 +1,57 @@
+#include "test_helper.h"
+#include "compiler/generate_code/parse_table_layout.h"
+#include "compiler/parse_table.h"
+
+using namespace rules;
+using generate_code::move_large_states_first;
+
+START_TEST
+
+describe("move_large_states_first", []() {
+  ParseTable table;
+
+  before_each([&]() {
+    table = ParseTable();
+    for (Symbol::Index i = 0; i < 7; i++) {
+      table.symbols[Symbol::terminal(i)] = ParseTableSymbolMetadata();
+    }
+    table.states.resize(5);
+  });
+
+  it("puts the large states first, and renumbers the states that refer to them", [&]() {
+    // States with a single entry are cheaper to store as lists of groups, but
+    // states with several distinct entries are not.
+    table.add_terminal_action(1, Symbol::terminal(0), ParseAction::Shift(2));
+    table.add_terminal_action(2, Symbol::terminal(1), ParseAction::Shift(4));
+    table.add_terminal_action(3, Symbol::terminal(0), ParseAction::Shift(2));
+    table.add_terminal_action(3, Symbol::terminal(1), ParseAction::Shift(3));
+    table.add_terminal_action(3, Symbol::terminal(2), ParseAction::Shift(4));
+    table.set_nonterminal_action(4, 0, 3);
+
+    AssertThat(move_large_states_first(&table), Equals(3u));
+    AssertThat(table.states.size(), Equals(5u));
+
+    // The error state and the start state keep their ids, even though they are small.
+    AssertThat(table.states[0].terminal_entries, IsEmpty());
+    AssertThat(table.states[1].terminal_entries[Symbol::terminal(0)].actions[0].state_index, Equals(3u));
+
+    // Old state 3 is large, so it becomes state 2, and the small states follow it.
+    AssertThat(table.states[2].terminal_entries.size(), Equals(3u));
+    AssertThat(table.states[2].terminal_entries[Symbol::terminal(0)].actions[0].state_index, Equals(3u));
+    AssertThat(table.states[2].terminal_entries[Symbol::terminal(1)].actions[0].state_index, Equals(2u));
+    AssertThat(table.states[2].terminal_entries[Symbol::terminal(2)].actions[0].state_index, Equals(4u));
+    AssertThat(table.states[3].terminal_entries[Symbol::terminal(1)].actions[0].state_index, Equals(4u));
+    AssertThat(table.states[4].nonterminal_entries[0], Equals(2u));
+  });
+
+  it("keeps the ids of states that are already in place", [&]() {
+    table.add_terminal_action(2, Symbol::terminal(0), ParseAction::Shift(3));
+    table.add_terminal_action(3, Symbol::terminal(0), ParseAction::Shift(4));
+
+    AssertThat(move_large_states_first(&table), Equals(2u));
+    AssertThat(table.states[2].terminal_entries[Symbol::terminal(0)].actions[0].state_index, Equals(3u));
+    AssertThat(table.states[3].terminal_entries[Symbol::terminal(0)].actions[0].state_index, Equals(4u));
+  });
+});
+
+END_TEST
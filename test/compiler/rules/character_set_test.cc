@@ -304,6 +304,75 @@ describe("CharacterSet", []() {
     });
   });
 
+  describe("::contains", [&]() {
+    it("returns true for characters within the set's ranges", [&]() {
+      CharacterSet set1 = CharacterSet()
+        .include('a', 'f')
+        .include(0x4e00, 0x9fff);
+
+      AssertThat(set1.contains('a'), IsTrue());
+      AssertThat(set1.contains('f'), IsTrue());
+      AssertThat(set1.contains('g'), IsFalse());
+      AssertThat(set1.contains(0x4e00), IsTrue());
+      AssertThat(set1.contains(0x7000), IsTrue());
+      AssertThat(set1.contains(0xa000), IsFalse());
+    });
+
+    it("returns false for characters that a full set excludes", [&]() {
+      CharacterSet set1 = CharacterSet()
+        .include_all()
+        .exclude('0', '9');
+
+      AssertThat(set1.contains('5'), IsFalse());
+      AssertThat(set1.contains('a'), IsTrue());
+      AssertThat(set1.contains(0x10ffff), IsTrue());
+    });
+  });
+
+  describe("with large ranges of characters", [&]() {
+    it("performs set operations without enumerating the characters", [&]() {
+      CharacterSet letters = CharacterSet()
+        .include('a', 'z')
+        .include(0x100, 0x10ffff);
+
+      CharacterSet other = CharacterSet()
+        .include(0x80, 0x10ffff);
+
+      AssertThat(letters.intersects(other), IsTrue());
+
+      CharacterSet intersection = letters.remove_set(other);
+      AssertThat(intersection, Equals(CharacterSet().include(0x100, 0x10ffff)));
+      AssertThat(letters, Equals(CharacterSet().include('a', 'z')));
+      AssertThat(letters.intersects(other), IsFalse());
+
+      letters.add_set(other);
+      AssertThat(letters, Equals(CharacterSet()
+        .include('a', 'z')
+        .include(0x80, 0x10ffff)));
+      AssertThat(letters.included_ranges(), Equals(vector<CharacterRange>({
+        CharacterRange{'a', 'z'},
+        CharacterRange{0x80, 0x10ffff},
+      })));
+    });
+  });
+
+  describe("::operator<", [&]() {
+    it("orders sets by their sequences of characters", [&]() {
+      CharacterSet set1 = CharacterSet().include('a', 'c');
+      CharacterSet set2 = CharacterSet().include('a', 'b').include('d');
+      CharacterSet set3 = CharacterSet().include('a', 'd');
+      CharacterSet set4 = CharacterSet().include('b');
+
+      AssertThat(set1 < set2, IsTrue());
+      AssertThat(set2 < set1, IsFalse());
+      AssertThat(set1 < set3, IsTrue());
+      AssertThat(set3 < set2, IsTrue());
+      AssertThat(set2 < set4, IsTrue());
+      AssertThat(set1 < set1, IsFalse());
+      AssertThat(set4 < CharacterSet().include_all(), IsTrue());
+    });
+  });
+
   describe("::included_ranges", [&]() {
     it("consolidates sequences of 3 or more consecutive characters into ranges", [&]() {
       CharacterSet set1 = CharacterSet()
@@ -0,0 +1,22 @@
+#include "test_helper.h"
+#include "compiler/util/worker_pool.h"
+
+using util::WorkerPool;
+
+START_TEST
+
+describe("WorkerPool", []() {
+  it("calls the function once with each index, in every batch", [&]() {
+    for (unsigned thread_count : vector<unsigned>({ 1, 2, 4 })) {
+      WorkerPool pool(thread_count);
+
+      for (size_t count : vector<size_t>({ 0, 1, 3, 50, 7 })) {
+        vector<int> call_counts(count, 0);
+        pool.run(count, [&](size_t i) { call_counts[i]++; });
+        AssertThat(call_counts, Equals(vector<int>(count, 1)));
+      }
+    }
+  });
+});
+
+END_TEST
@@ -21,12 +21,24 @@ map<string, const TSLanguage *> loaded_languages;
 int libcompiler_mtime = -1;
 int compile_result_count = 0;
 
-const char *libcompiler_path =
+static string build_type() {
+  const char *result = getenv("BUILDTYPE");
+  return result ? result : "Test";
+}
+
+// Builds other than the tests, such as the benchmarks, compile the parsers
+// with optimizations, so they keep their own copies of the shared libraries.
+static bool is_optimized_build() {
+  return build_type() != "Test";
+}
+
+static string libcompiler_path() {
 #if defined(__linux)
-  "out/Test/obj.target/libcompiler.a";
+  return "out/" + build_type() + "/obj.target/libcompiler.a";
 #else
-  "out/Test/libcompiler.a";
+  return "out/" + build_type() + "/libcompiler.a";
 #endif
+}
 
 static std::string run_command(const char *cmd, const char *args[]) {
   int child_pid = fork();
@@ -80,6 +92,10 @@ static const TSLanguage *load_language(const string &source_filename,
       source_filename.c_str()
     };
 
+    if (is_optimized_build()) {
+      compile_args.push_back("-O2");
+    }
+
     if (!external_scanner_filename.empty()) {
       compile_args.push_back("-g");
       string extension = external_scanner_filename.substr(external_scanner_filename.rfind("."));
@@ -157,7 +173,7 @@ const TSLanguage *load_real_language(const string &language_name) {
     return nullptr;
 
   if (libcompiler_mtime == -1) {
-    libcompiler_mtime = get_modified_time(libcompiler_path);
+    libcompiler_mtime = get_modified_time(libcompiler_path());
     if (!libcompiler_mtime)
       return nullptr;
   }
@@ -165,7 +181,7 @@ const TSLanguage *load_real_language(const string &language_name) {
   int parser_mtime = get_modified_time(parser_filename);
 
   if (parser_mtime <= grammar_mtime || parser_mtime <= libcompiler_mtime) {
-    printf("\n" "Regenerating the %s parser...\n", language_name.c_str());
+    fprintf(stderr, "\n" "Regenerating the %s parser...\n", language_name.c_str());
 
     string grammar_json = read_file(grammar_filename);
     TSCompileResult result = ts_compile_grammar(grammar_json.c_str());
@@ -178,7 +194,8 @@ const TSLanguage *load_real_language(const string &language_name) {
   }
 
   mkdir("out/tmp", 0777);
-  string lib_filename = "out/tmp/" + language_name + ".so";
+  string lib_filename = "out/tmp/" + language_name +
+    (is_optimized_build() ? "-" + build_type() : "") + ".so";
   const TSLanguage *language = load_language(parser_filename, lib_filename, language_name, external_scanner_filename);
   loaded_languages[language_name] = language;
   return language;
@@ -175,6 +175,12 @@ ostream &operator<<(ostream &stream, const LexItemSet &item_set) {
   return stream << item_set.entries;
 }
 
+ostream &operator<<(ostream &stream, const LookaheadSet &lookaheads) {
+  stream << "(LookaheadSet";
+  lookaheads.for_each([&](const Symbol &symbol) { stream << " " << symbol; });
+  return stream << ")";
+}
+
 ostream &operator<<(ostream &stream, const LexItemSet::Transition &transition) {
   return stream << "(Transition " << transition.destination << " prec:" << transition.precedence << ")";
 }
@@ -8,6 +8,9 @@
 #include "helpers/stderr_logger.h"
 #include "helpers/spy_input.h"
 #include "helpers/load_language.h"
+#include "helpers/file_helpers.h"
+#include <fcntl.h>
+#include <unistd.h>
 
 TSPoint point(size_t row, size_t column) {
   return TSPoint{static_cast<uint32_t>(row), static_cast<uint32_t>(column)};
@@ -72,6 +75,99 @@ describe("Document", [&]() {
         "(array (true) (false))");
     });
 
+    it("decodes multi-byte UTF8 characters", [&]() {
+      ts_document_set_input_string(document, "[\"\xce\xb1\xce\xb2\", \"\xf0\x9f\x98\x80\"]");
+      ts_document_parse(document);
+
+      root = ts_document_root_node(document);
+      assert_node_string_equals(
+        root,
+        "(array (string) (string))");
+
+      TSNode first_string = ts_node_named_child(root, 0);
+      TSNode second_string = ts_node_named_child(root, 1);
+      AssertThat(ts_node_end_byte(first_string), Equals<size_t>(7));
+      AssertThat(ts_node_end_char(first_string), Equals<size_t>(5));
+      AssertThat(ts_node_start_char(second_string), Equals<size_t>(7));
+      AssertThat(ts_node_end_char(second_string), Equals<size_t>(10));
+      AssertThat(ts_node_end_char(root), Equals<size_t>(11));
+    });
+
+    it("tracks positions across long runs of characters that span chunks", [&]() {
+      spy_input->content = "[\"abcdefgh\",\n\n   \"\xce\xb1\xce\xb2\xce\xb3\", 12345]";
+
+      ts_document_set_input(document, spy_input->input());
+      ts_document_invalidate(document);
+      ts_document_parse(document);
+
+      root = ts_document_root_node(document);
+      assert_node_string_equals(
+        root,
+        "(array (string) (string) (number))");
+
+      TSNode first_string = ts_node_named_child(root, 0);
+      TSNode second_string = ts_node_named_child(root, 1);
+      TSNode number = ts_node_named_child(root, 2);
+      AssertThat(ts_node_end_point(first_string), Equals<TSPoint>({0, 11}));
+      AssertThat(ts_node_start_point(second_string), Equals<TSPoint>({2, 3}));
+      AssertThat(ts_node_end_point(second_string), Equals<TSPoint>({2, 8}));
+      AssertThat(ts_node_start_byte(second_string), Equals<size_t>(17));
+      AssertThat(ts_node_end_byte(second_string), Equals<size_t>(25));
+      AssertThat(ts_node_start_point(number), Equals<TSPoint>({2, 10}));
+      AssertThat(ts_node_end_point(number), Equals<TSPoint>({2, 15}));
+      AssertThat(ts_node_end_char(number), Equals<size_t>(29));
+    });
+
+    it("parses inputs whose root is a single token", [&]() {
+      ts_document_set_input_string(document, " 123 ");
+      ts_document_parse(document);
+      root = ts_document_root_node(document);
+      assert_node_string_equals(root, "(number)");
+      AssertThat(ts_node_start_byte(root), Equals<size_t>(1));
+      AssertThat(ts_node_end_byte(root), Equals<size_t>(4));
+
+      ts_document_set_input_string(document, "123 @");
+      ts_document_parse(document);
+      root = ts_document_root_node(document);
+      AssertThat(ts_node_end_byte(root), Equals<size_t>(5));
+    });
+
+    it("decodes multi-byte UTF8 characters after the lexer moves backwards", [&]() {
+      TSCompileResult compile_result = ts_compile_grammar(R"JSON({
+        "name": "multi_byte_relex",
+        "rules": {
+          "program": {
+            "type": "REPEAT",
+            "content": {
+              "type": "CHOICE",
+              "members": [
+                {"type": "STRING", "value": "éa"},
+                {"type": "SYMBOL", "name": "word"}
+              ]
+            }
+          },
+          "word": {"type": "PATTERN", "value": "[b-z]+"}
+        }
+      })JSON");
+      ts_document_set_language(document, load_test_language("multi_byte_relex", compile_result));
+
+      // Lexing 'é' fails and is retried in error mode from the same position.
+      ts_document_set_input_string(document, "\xc3\xa9" "b");
+      ts_document_parse(document);
+      root = ts_document_root_node(document);
+      AssertThat(ts_node_end_char(root), Equals<size_t>(2));
+      AssertThat(ts_node_end_byte(root), Equals<size_t>(3));
+      char *node_string = ts_node_string(root, document);
+      AssertThat(string(node_string), !Contains("0xC3"));
+      ts_free(node_string);
+
+      ts_document_set_input_string(document, "b\xc3\xa9" "b");
+      ts_document_parse(document);
+      root = ts_document_root_node(document);
+      AssertThat(ts_node_end_char(root), Equals<size_t>(3));
+      AssertThat(ts_node_end_byte(root), Equals<size_t>(4));
+    });
+
     it("allows columns to be measured in either bytes or characters", [&]() {
       const char16_t content[] = u"[true, false]";
       spy_input->content = string((const char *)content, sizeof(content));
@@ -127,6 +223,45 @@ describe("Document", [&]() {
         "(number)");
     });
 
+    it("allows the input to be read from a memory-mapped file", [&]() {
+      mkdir("out/tmp", 0777);
+      write_file("out/tmp/document-input.json", "[\"\xce\xb1\", {\"a\": null}]");
+      int fd = open("out/tmp/document-input.json", O_RDONLY);
+
+      AssertThat(ts_document_set_input_file(document, fd), IsTrue());
+      close(fd);
+      ts_document_parse(document);
+      assert_node_string_equals(
+        ts_document_root_node(document),
+        "(array (string) (object (pair (string) (null))))");
+
+      // Reparse after an edit that doesn't change the file's contents.
+      TSInputEdit edit = {};
+      edit.start_point.column = edit.start_byte = strlen("[\"\xce\xb1\", {\"a\": ");
+      edit.extent_added.column = edit.bytes_added = 4;
+      edit.extent_removed.column = edit.bytes_removed = 4;
+      ts_document_edit(document, edit);
+      ts_document_parse(document);
+      assert_node_string_equals(
+        ts_document_root_node(document),
+        "(array (string) (object (pair (string) (null))))");
+
+      AssertThat(ts_document_set_input_file(document, -1), IsFalse());
+    });
+
+    it("rejects files that aren't regular files", [&]() {
+      int fds[2];
+      AssertThat(pipe(fds), Equals(0));
+      AssertThat(write(fds[1], "[1]", 3), Equals(3));
+      AssertThat(ts_document_set_input_file(document, fds[0]), IsFalse());
+      close(fds[0]);
+      close(fds[1]);
+
+      int fd = open("test", O_RDONLY);
+      AssertThat(ts_document_set_input_file(document, fd), IsFalse());
+      close(fd);
+    });
+
     it("reads from the new input correctly when the old input was blank", [&]() {
       ts_document_set_input_string(document, "");
       ts_document_parse(document);
@@ -231,6 +366,542 @@ describe("Document", [&]() {
     });
   });
 
+  describe("set_trace_buffer(TSTraceBuffer *)", [&]() {
+    SpyLogger *logger;
+    SpyLogger *replay_logger;
+    TSTraceBuffer *buffer;
+
+    before_each([&]() {
+      logger = new SpyLogger();
+      replay_logger = new SpyLogger();
+      buffer = nullptr;
+      ts_document_set_language(document, load_real_language("json"));
+      ts_document_set_input_string(document, "[1, 2]");
+    });
+
+    after_each([&]() {
+      if (buffer) ts_trace_buffer_delete(buffer);
+      delete logger;
+      delete replay_logger;
+    });
+
+    it("records an event for each message that would be logged", [&]() {
+      buffer = ts_trace_buffer_new(1024);
+      ts_document_set_trace_buffer(document, buffer);
+      ts_document_set_logger(document, logger->logger());
+      ts_document_parse(document);
+
+      AssertThat(ts_document_trace_buffer(document), Equals(buffer));
+      AssertThat(ts_trace_buffer_event_count(buffer), Equals(logger->messages.size()));
+      AssertThat(ts_trace_buffer_dropped_event_count(buffer), Equals(0u));
+
+      const TSTraceEvent *first_event = ts_trace_buffer_event(buffer, 0);
+      AssertThat(first_event->type, Equals(TSTraceEventNewParse));
+      AssertThat(ts_trace_event_log_type(first_event), Equals(TSLogTypeParse));
+      AssertThat(ts_trace_buffer_event(buffer, ts_trace_buffer_event_count(buffer)), IsNull());
+    });
+
+    it("can be decoded into the same messages that the logger receives", [&]() {
+      buffer = ts_trace_buffer_new(1024);
+      ts_document_set_trace_buffer(document, buffer);
+      ts_document_set_logger(document, logger->logger());
+      ts_document_parse(document);
+
+      ts_trace_buffer_replay(buffer, ts_document_language(document), replay_logger->logger());
+      AssertThat(replay_logger->messages, Equals(logger->messages));
+      AssertThat(replay_logger->messages, Contains("consume character:'['"));
+      AssertThat(replay_logger->messages, Contains("reduce sym:array, child_count:4"));
+    });
+
+    it("records every character in long runs when no logger is attached", [&]() {
+      string input_string = "[\"" + string(100, 'a') + "\"," + string(100, ' ') + "1]";
+      ts_document_set_input_string(document, input_string.c_str());
+
+      buffer = ts_trace_buffer_new(4096);
+      ts_document_set_trace_buffer(document, buffer);
+      ts_document_parse(document);
+      ts_document_set_trace_buffer(document, nullptr);
+
+      ts_document_set_logger(document, logger->logger());
+      ts_document_invalidate(document);
+      ts_document_parse(document);
+
+      ts_trace_buffer_replay(buffer, ts_document_language(document), replay_logger->logger());
+      AssertThat(ts_trace_buffer_dropped_event_count(buffer), Equals(0u));
+      AssertThat(replay_logger->messages, Equals(logger->messages));
+    });
+
+    it("records the position of each event", [&]() {
+      buffer = ts_trace_buffer_new(1024);
+      ts_document_set_trace_buffer(document, buffer);
+      ts_document_parse(document);
+
+      vector<uint32_t> consumed_byte_offsets;
+      for (uint32_t i = 0; i < ts_trace_buffer_event_count(buffer); i++) {
+        const TSTraceEvent *event = ts_trace_buffer_event(buffer, i);
+        if (event->type == TSTraceEventConsumeCharacter) {
+          AssertThat(ts_trace_event_log_type(event), Equals(TSLogTypeLex));
+          consumed_byte_offsets.push_back(event->byte_offset);
+        }
+      }
+
+      AssertThat(consumed_byte_offsets, Equals(vector<uint32_t>({1, 2, 3, 5, 6})));
+    });
+
+    it("keeps only the most recent events once the buffer is full", [&]() {
+      buffer = ts_trace_buffer_new(5);
+      ts_document_set_trace_buffer(document, buffer);
+      ts_document_set_logger(document, logger->logger());
+      ts_document_parse(document);
+
+      AssertThat(ts_trace_buffer_event_count(buffer), Equals(8u));
+      AssertThat(ts_trace_buffer_dropped_event_count(buffer), Equals(logger->messages.size() - 8));
+
+      ts_trace_buffer_replay(buffer, ts_document_language(document), replay_logger->logger());
+      AssertThat(replay_logger->messages, Equals(vector<string>(
+        logger->messages.end() - 8,
+        logger->messages.end()
+      )));
+    });
+
+    it("records nothing once the buffer is cleared and removed", [&]() {
+      buffer = ts_trace_buffer_new(1024);
+      ts_document_set_trace_buffer(document, buffer);
+      ts_document_parse(document);
+      AssertThat(ts_trace_buffer_event_count(buffer), IsGreaterThan(0u));
+
+      ts_trace_buffer_clear(buffer);
+      ts_document_set_trace_buffer(document, nullptr);
+      ts_document_invalidate(document);
+      ts_document_parse(document);
+      AssertThat(ts_trace_buffer_event_count(buffer), Equals(0u));
+    });
+  });
+
+  describe("set_arena_enabled(bool)", [&]() {
+    before_each([&]() {
+      ts_document_set_arena_enabled(document, true);
+      ts_document_set_language(document, load_real_language("json"));
+      ts_document_set_input_string(document, "{\"key\": [1, 2]}");
+      ts_document_parse(document);
+    });
+
+    it("allocates the document's trees in an arena", [&]() {
+      root = ts_document_root_node(document);
+      assert_node_string_equals(
+        root,
+        "(object (pair (string) (array (number) (number))))");
+      AssertThat(((const Tree *)root.data)->in_arena, IsTrue());
+    });
+
+    it("keeps reused trees alive after the arena is disabled", [&]() {
+      SpyInput input("{\"key\": [1, null]}", 3);
+      ts_document_set_arena_enabled(document, false);
+      ts_document_set_input(document, input.input());
+
+      TSInputEdit edit = {};
+      edit.start_point.column = edit.start_byte = strlen("{\"key\": [1, ");
+      edit.extent_added.column = edit.bytes_added = 4;
+      edit.extent_removed.column = edit.bytes_removed = 1;
+      ts_document_edit(document, edit);
+      ts_document_parse(document);
+
+      root = ts_document_root_node(document);
+      assert_node_string_equals(
+        root,
+        "(object (pair (string) (array (number) (null))))");
+      AssertThat(((const Tree *)root.data)->in_arena, IsFalse());
+      TSNode key = ts_node_named_child(ts_node_named_child(root, 0), 0);
+      AssertThat(((const Tree *)key.data)->in_arena, IsTrue());
+    });
+  });
+
+  describe("set_cancellation_flag(flag)", [&]() {
+    size_t cancellation_flag = 0;
+
+    before_each([&]() {
+      cancellation_flag = 0;
+      ts_document_set_language(document, load_real_language("json"));
+      ts_document_set_input_string(document, "{\"key\": [1, 2]}");
+      ts_document_set_cancellation_flag(document, &cancellation_flag);
+    });
+
+    it("allows the flag to be retrieved later", [&]() {
+      AssertThat(ts_document_cancellation_flag(document), Equals(&cancellation_flag));
+    });
+
+    it("stops parsing when the flag is set", [&]() {
+      cancellation_flag = 1;
+      ts_document_parse(document);
+      AssertThat(ts_document_parse_count(document), Equals(0u));
+      AssertThat(ts_document_root_node(document).data, Equals<void *>(nullptr));
+
+      cancellation_flag = 0;
+      ts_document_parse(document);
+      AssertThat(ts_document_parse_count(document), Equals(1u));
+      assert_node_string_equals(
+        ts_document_root_node(document),
+        "(object (pair (string) (array (number) (number))))");
+    });
+
+    it("leaves the previous tree intact when a reparse is cancelled", [&]() {
+      ts_document_parse(document);
+
+      TSInputEdit edit = {};
+      edit.start_point.column = edit.start_byte = strlen("{\"key\": [1, ");
+      edit.extent_added.column = edit.bytes_added = 1;
+      edit.extent_removed.column = edit.bytes_removed = 1;
+      ts_document_set_input_string(document, "{\"key\": [1, 3]}");
+      ts_document_edit(document, edit);
+
+      cancellation_flag = 1;
+      TSRange *ranges;
+      uint32_t range_count;
+      ts_document_parse_and_get_changed_ranges(document, &ranges, &range_count);
+      AssertThat(range_count, Equals(0u));
+      AssertThat(ts_document_parse_count(document), Equals(1u));
+      assert_node_string_equals(
+        ts_document_root_node(document),
+        "(object (pair (string) (array (number) (number))))");
+
+      cancellation_flag = 0;
+      ts_document_parse(document);
+      AssertThat(ts_document_parse_count(document), Equals(2u));
+      assert_node_string_equals(
+        ts_document_root_node(document),
+        "(object (pair (string) (array (number) (number))))");
+    });
+  });
+
+  describe("set_timeout_micros(timeout)", [&]() {
+    string long_array = "[0";
+    for (unsigned i = 1; i < 20000; i++)
+      long_array += ", " + to_string(i);
+    long_array += "]";
+
+    before_each([&]() {
+      ts_document_set_language(document, load_real_language("json"));
+      ts_document_set_input_string(document, long_array.c_str());
+    });
+
+    it("allows the timeout to be retrieved later", [&]() {
+      AssertThat(ts_document_timeout_micros(document), Equals(0u));
+      ts_document_set_timeout_micros(document, 1000);
+      AssertThat(ts_document_timeout_micros(document), Equals(1000u));
+    });
+
+    it("stops parsing when the timeout expires", [&]() {
+      ts_document_set_timeout_micros(document, 1);
+      ts_document_parse(document);
+      AssertThat(ts_document_parse_count(document), Equals(0u));
+      AssertThat(ts_document_root_node(document).data, Equals<void *>(nullptr));
+
+      ts_document_set_timeout_micros(document, 0);
+      ts_document_parse(document);
+      AssertThat(ts_document_parse_count(document), Equals(1u));
+      AssertThat(ts_node_named_child_count(ts_document_root_node(document)), Equals(20000u));
+    });
+
+    it("resumes a paused parse where it left off", [&]() {
+      SpyInput input(long_array, 1024);
+      ts_document_set_input(document, input.input());
+      ts_document_set_timeout_micros(document, 1);
+
+      size_t call_count = 1;
+      while (!ts_document_parse(document)) {
+        AssertThat(ts_document_parse_count(document), Equals(0u));
+        call_count++;
+      }
+
+      AssertThat(call_count, IsGreaterThan(1u));
+      AssertThat(ts_document_parse_count(document), Equals(1u));
+      AssertThat(ts_node_named_child_count(ts_document_root_node(document)), Equals(20000u));
+
+      size_t bytes_read = 0;
+      for (const string &chunk : input.strings_read)
+        bytes_read += chunk.size();
+      AssertThat(bytes_read, IsLessThan(long_array.size() + 2048));
+    });
+
+    it("discards a paused parse when the input changes", [&]() {
+      ts_document_set_timeout_micros(document, 1);
+      AssertThat(ts_document_parse(document), IsFalse());
+
+      ts_document_set_input_string(document, "[1, 2]");
+      AssertThat(ts_document_parse(document), IsTrue());
+      assert_node_string_equals(
+        ts_document_root_node(document),
+        "(array (number) (number))");
+    });
+
+    it("discards a paused parse when the input is edited", [&]() {
+      SpyInput input(long_array, 1024);
+      ts_document_set_input(document, input.input());
+      ts_document_set_timeout_micros(document, 1);
+      AssertThat(ts_document_parse(document), IsFalse());
+
+      // There is no tree yet, but the paused parse has read the old text.
+      ts_document_edit(document, input.replace(long_array.size(), 0, "}"));
+      ts_document_edit(document, input.replace(0, 0, "{\"a\": "));
+      ts_document_set_timeout_micros(document, 0);
+      AssertThat(ts_document_parse(document), IsTrue());
+
+      TSNode root_node = ts_document_root_node(document);
+      AssertThat(ts_node_type(root_node, document), Equals("object"));
+      TSNode array_node = ts_node_named_child(ts_node_named_child(root_node, 0), 1);
+      AssertThat(ts_node_type(array_node, document), Equals("array"));
+      AssertThat(ts_node_named_child_count(array_node), Equals(20000u));
+    });
+
+    it("reports whether a parse was paused or cancelled", [&]() {
+      AssertThat(ts_document_parse_status(document), Equals(TSParseStatusComplete));
+
+      ts_document_set_timeout_micros(document, 1);
+      AssertThat(ts_document_parse(document), IsFalse());
+      AssertThat(ts_document_parse_status(document), Equals(TSParseStatusPaused));
+
+      size_t cancellation_flag = 1;
+      ts_document_set_cancellation_flag(document, &cancellation_flag);
+      AssertThat(ts_document_parse(document), IsFalse());
+      AssertThat(ts_document_parse_status(document), Equals(TSParseStatusCancelled));
+
+      ts_document_set_cancellation_flag(document, nullptr);
+      ts_document_set_timeout_micros(document, 0);
+      AssertThat(ts_document_parse(document), IsTrue());
+      AssertThat(ts_document_parse_status(document), Equals(TSParseStatusComplete));
+    });
+  });
+
+  describe("set_lex_limit(limit)", [&]() {
+    string long_array = "[0";
+    for (unsigned i = 1; i < 1000; i++)
+      long_array += ", " + to_string(i);
+    long_array += "]";
+
+    before_each([&]() {
+      ts_document_set_language(document, load_real_language("json"));
+      ts_document_set_input_string(document, long_array.c_str());
+    });
+
+    it("allows the limit to be retrieved later", [&]() {
+      AssertThat(ts_document_lex_limit(document), Equals(0u));
+      ts_document_set_lex_limit(document, 100);
+      AssertThat(ts_document_lex_limit(document), Equals(100u));
+    });
+
+    it("pauses each parse after about the given number of lex calls", [&]() {
+      ts_document_set_lex_limit(document, 100);
+
+      size_t call_count = 1;
+      uint32_t lex_count = 0;
+      while (!ts_document_parse(document)) {
+        AssertThat(ts_document_parse_status(document), Equals(TSParseStatusPaused));
+        uint32_t new_lex_count = ts_document_parse_stats(document).lex_count;
+        AssertThat(new_lex_count - lex_count, IsGreaterThan(99u));
+        AssertThat(new_lex_count - lex_count, IsLessThan(110u));
+        lex_count = new_lex_count;
+        call_count++;
+      }
+
+      AssertThat(call_count, IsGreaterThan(10u));
+      AssertThat(ts_node_named_child_count(ts_document_root_node(document)), Equals(1000u));
+    });
+  });
+
+  describe("parse()", [&]() {
+    auto max_repeat_height = [](const Tree *tree) {
+      uint32_t result = 0;
+      vector<pair<const Tree *, uint32_t>> stack({{tree, 0}});
+      while (!stack.empty()) {
+        auto entry = stack.back();
+        stack.pop_back();
+        if (entry.second > result) result = entry.second;
+        for (uint32_t i = 0; i < entry.first->child_count; i++) {
+          const Tree *child = entry.first->children[i];
+          bool is_repeat = child->symbol == entry.first->symbol && !child->visible;
+          stack.push_back({child, is_repeat ? entry.second + 1 : 0});
+        }
+      }
+      return result;
+    };
+
+    string long_array = "[0";
+    for (unsigned i = 1; i < 1000; i++)
+      long_array += ", " + to_string(i);
+    long_array += "]";
+
+    before_each([&]() {
+      ts_document_set_language(document, load_real_language("json"));
+    });
+
+    it("stores long repetitions as balanced trees", [&]() {
+      ts_document_set_input_string(document, long_array.c_str());
+      ts_document_parse(document);
+
+      root = ts_document_root_node(document);
+      AssertThat(ts_node_named_child_count(root), Equals(1000u));
+      AssertThat(max_repeat_height((const Tree *)root.data), IsLessThan(20u));
+    });
+
+    it("keeps long repetitions balanced when they are edited", [&]() {
+      SpyInput input(long_array, 64);
+      ts_document_set_input(document, input.input());
+      ts_document_parse(document);
+
+      size_t index = long_array.find(", 500,") + 2;
+      ts_document_edit(document, input.replace(index, 3, "null"));
+      input.clear();
+      ts_document_parse(document);
+
+      size_t bytes_read = 0;
+      for (const string &chunk : input.strings_read)
+        bytes_read += chunk.size();
+      AssertThat(bytes_read, IsLessThan(200u));
+
+      root = ts_document_root_node(document);
+      AssertThat(ts_node_named_child_count(root), Equals(1000u));
+      TSNode edited_node = ts_node_named_child(root, 500);
+      AssertThat(ts_node_type(edited_node, document), Equals("null"));
+      AssertThat(ts_node_start_byte(edited_node), Equals(index));
+      AssertThat(ts_node_start_byte(ts_node_named_child(root, 999)),
+                 Equals(long_array.size() + 1 - 4));
+      AssertThat(max_repeat_height((const Tree *)root.data), IsLessThan(20u));
+    });
+
+    it("doesn't reuse repetitions that error recovery joined across an error", [&]() {
+      string text = "\n{ \"key1\": { \"key2\": 1, 2 }, [, \"key3\": 3 }\n";
+      SpyInput input(text, 3);
+      ts_document_set_input(document, input.input());
+
+      // With the inserted text, error recovery places the outer object's
+      // last pair in the inner object's repetition.
+      ts_document_edit(document, input.replace(0, 0, "alwq ptpsqf)"));
+      ts_document_parse(document);
+      ts_document_edit(document, input.undo());
+      ts_document_parse(document);
+
+      assert_node_string_equals(
+        ts_document_root_node(document),
+        "(object "
+          "(pair (string) (object (pair (string) (number)) (ERROR (number)))) "
+          "(ERROR) "
+          "(pair (string) (number)))");
+    });
+  });
+
+  describe("parse_stats()", [&]() {
+    string long_array = "[0";
+    for (unsigned i = 1; i < 1000; i++)
+      long_array += ", " + to_string(i);
+    long_array += "]";
+
+    before_each([&]() {
+      ts_document_set_language(document, load_real_language("json"));
+    });
+
+    it("counts the work done by the most recent parse", [&]() {
+      ts_document_set_input_string(document, long_array.c_str());
+      ts_document_parse(document);
+
+      TSParseStats stats = ts_document_parse_stats(document);
+      AssertThat(stats.lex_count, IsGreaterThan(2000u));
+      AssertThat(stats.bytes_lexed, Equals(long_array.size()));
+      // Every token is shifted except for the end of the input.
+      AssertThat(stats.shift_count, Equals(stats.lex_count - 1));
+      AssertThat(stats.reduce_count, IsGreaterThan(1000u));
+      AssertThat(stats.max_version_count, Equals(1u));
+      AssertThat(stats.average_version_count, Equals(1.0f));
+      AssertThat(stats.handle_error_count, Equals(0u));
+      AssertThat(stats.repair_error_count, Equals(0u));
+      AssertThat(stats.recover_count, Equals(0u));
+      AssertThat(stats.reused_subtree_count, Equals(0u));
+      AssertThat(stats.total_nanos, IsGreaterThan(0u));
+    });
+
+    it("counts the subtrees reused after an edit", [&]() {
+      SpyInput input(long_array, 64);
+      ts_document_set_input(document, input.input());
+      ts_document_parse(document);
+
+      size_t index = long_array.find(", 500,") + 2;
+      ts_document_edit(document, input.replace(index, 3, "null"));
+      ts_document_parse(document);
+
+      TSParseStats stats = ts_document_parse_stats(document);
+      AssertThat(stats.reused_subtree_count, IsGreaterThan(0u));
+      AssertThat(stats.reused_bytes, IsGreaterThan(long_array.size() / 2));
+      AssertThat(stats.bytes_lexed, IsLessThan(100u));
+    });
+
+    it("counts the invocations of error recovery", [&]() {
+      ts_document_set_input_string(document, "[1, , 2, @@@, 3]");
+      ts_document_parse(document);
+
+      TSParseStats stats = ts_document_parse_stats(document);
+      AssertThat(stats.handle_error_count, IsGreaterThan(0u));
+      AssertThat(stats.max_version_count, IsGreaterThan(1u));
+      AssertThat(stats.merge_count + stats.condense_count, IsGreaterThan(0u));
+      AssertThat(stats.dropped_version_count, Equals(0u));
+    });
+
+    it("measures the time spent in each phase when phase timing is enabled", [&]() {
+      ts_document_set_input_string(document, long_array.c_str());
+      ts_document_parse(document);
+
+      TSParseStats stats = ts_document_parse_stats(document);
+      AssertThat(stats.lex_nanos, Equals(0u));
+      AssertThat(stats.balance_nanos, Equals(0u));
+
+      ts_document_set_phase_timing_enabled(document, true);
+      ts_document_invalidate(document);
+      ts_document_parse(document);
+
+      stats = ts_document_parse_stats(document);
+      AssertThat(stats.lex_nanos, IsGreaterThan(0u));
+      AssertThat(stats.balance_nanos, IsGreaterThan(0u));
+      AssertThat(stats.lex_nanos + stats.condense_nanos + stats.balance_nanos,
+                 IsLessThan(stats.total_nanos));
+    });
+  });
+
+  describe("set_version_limit(uint32_t)", [&]() {
+    const char *invalid_input = "[1, , 2, @@@, 3]";
+
+    before_each([&]() {
+      ts_document_set_language(document, load_real_language("json"));
+      ts_document_set_input_string(document, invalid_input);
+    });
+
+    it("does not limit the number of versions by default", [&]() {
+      AssertThat(ts_document_version_limit(document), Equals(0u));
+    });
+
+    it("drops the costliest versions when there are more than the limit", [&]() {
+      SpyLogger logger;
+      ts_document_set_logger(document, logger.logger());
+      ts_document_set_version_limit(document, 1);
+      AssertThat(ts_document_version_limit(document), Equals(1u));
+      ts_document_parse(document);
+
+      TSParseStats stats = ts_document_parse_stats(document);
+      AssertThat(stats.dropped_version_count, IsGreaterThan(0u));
+      AssertThat(stats.average_version_count, Equals(1.0f));
+      AssertThat(logger.messages, Contains("drop_version version:1, cost:10"));
+
+      root = ts_document_root_node(document);
+      AssertThat(ts_node_end_byte(root), Equals(strlen(invalid_input)));
+    });
+
+    it("does not drop any versions when the limit is not reached", [&]() {
+      ts_document_set_version_limit(document, 100);
+      ts_document_parse(document);
+
+      TSParseStats stats = ts_document_parse_stats(document);
+      AssertThat(stats.dropped_version_count, Equals(0u));
+      AssertThat(stats.max_version_count, IsGreaterThan(1u));
+    });
+  });
+
   describe("parse_and_get_changed_ranges()", [&]() {
     SpyInput *input;
 
@@ -0,0 +1,230 @@
+#include "test_helper.h"
+#include "runtime/alloc.h"
+#include "runtime/language.h"
+#include "helpers/record_alloc.h"
+#include "helpers/load_language.h"
+#include "helpers/file_helpers.h"
+#include "tree_sitter/compiler.h"
+
+START_TEST
+
+describe("Language", [&]() {
+  describe("ts_language_load(data, length)", [&]() {
+    TSBinaryCompileResult compile_result;
+    vector<uint32_t> data;
+
+    before_each([&]() {
+      compile_result = ts_compile_grammar_binary(
+        read_file("test/fixtures/grammars/json/src/grammar.json").c_str()
+      );
+      AssertThat(compile_result.error_message, Equals<const char *>(nullptr));
+
+      // Languages are loaded in place, so the data must be aligned.
+      data.resize(compile_result.size / sizeof(uint32_t) + 1);
+      memcpy(data.data(), compile_result.data, compile_result.size);
+      free(compile_result.data);
+
+      record_alloc::start();
+    });
+
+    after_each([&]() {
+      record_alloc::stop();
+      AssertThat(record_alloc::outstanding_allocation_indices(), IsEmpty());
+    });
+
+    auto parse = [&](const TSLanguage *language, const char *input) {
+      TSDocument *document = ts_document_new();
+      ts_document_set_language(document, language);
+      ts_document_set_input_string(document, input);
+      ts_document_parse(document);
+      char *node_string = ts_node_string(ts_document_root_node(document), document);
+      string result(node_string);
+      ts_free(node_string);
+      ts_document_free(document);
+      return result;
+    };
+
+    it("produces a language that parses like the generated parser", [&]() {
+      const TSLanguage *language = ts_language_load(data.data(), compile_result.size);
+      AssertThat(language, !Equals<const TSLanguage *>(nullptr));
+      AssertThat(ts_language_version(language), Equals<uint32_t>(TREE_SITTER_LANGUAGE_VERSION));
+      AssertThat(
+        ts_language_symbol_count(language),
+        Equals(ts_language_symbol_count(load_real_language("json")))
+      );
+
+      for (const char *input : {
+        "{\"key\": [1, 2.5, true, null, \"\\u03b1\"]}",
+        "  [\n  {}, [], \"\xce\xb1\xce\xb2\"\n]  ",
+        "[1, @@@, {\"a\" 2}, 3]",
+      }) {
+        AssertThat(parse(language, input), Equals(parse(load_real_language("json"), input)));
+      }
+
+      ts_language_free(language);
+    });
+
+    it("returns NULL for truncated or unaligned data", [&]() {
+      for (size_t length = 0; length < compile_result.size; length += 7) {
+        AssertThat(ts_language_load(data.data(), length), Equals<const TSLanguage *>(nullptr));
+      }
+
+      const char *unaligned = reinterpret_cast<const char *>(data.data()) + 1;
+      AssertThat(ts_language_load(unaligned, compile_result.size - 1), Equals<const TSLanguage *>(nullptr));
+    });
+
+    it("returns NULL for data that doesn't match its header", [&]() {
+      // The header's fields after the magic number and the version are counts.
+      vector<uint32_t> corrupt_data = data;
+      corrupt_data[4] = 1000;
+      AssertThat(ts_language_load(corrupt_data.data(), compile_result.size), Equals<const TSLanguage *>(nullptr));
+
+      corrupt_data = data;
+      corrupt_data[1] = TREE_SITTER_LANGUAGE_VERSION + 1;
+      AssertThat(ts_language_load(corrupt_data.data(), compile_result.size), Equals<const TSLanguage *>(nullptr));
+    });
+
+    it("returns NULL for parse table values that point into an action list", [&]() {
+      // Locate the tables that follow the header. Each one is padded to a
+      // multiple of four bytes.
+      const uint32_t *header = data.data();
+      uint32_t symbol_count = header[2];
+      uint32_t token_count = header[3];
+      uint32_t state_count = header[4];
+      uint32_t large_state_count = header[5];
+      uint32_t small_parse_table_size = header[6];
+      uint32_t symbol_names_size = header[11];
+      auto padded = [](size_t size) { return (size + 3) / 4 * 4; };
+      size_t small_parse_table_offset =
+        12 * sizeof(uint32_t) +
+        padded(symbol_count) +
+        padded(symbol_names_size) +
+        padded(large_state_count * symbol_count * sizeof(uint16_t));
+      size_t small_parse_table_map_offset =
+        small_parse_table_offset + padded(small_parse_table_size * sizeof(uint16_t));
+      size_t parse_actions_offset =
+        small_parse_table_map_offset + padded((state_count - large_state_count) * sizeof(uint32_t));
+
+      vector<uint32_t> corrupt_data = data;
+      char *bytes = reinterpret_cast<char *>(corrupt_data.data());
+      uint16_t *small_parse_table = reinterpret_cast<uint16_t *>(bytes + small_parse_table_offset);
+      const uint32_t *small_parse_table_map =
+        reinterpret_cast<const uint32_t *>(bytes + small_parse_table_map_offset);
+      const uint16_t *parse_actions = reinterpret_cast<const uint16_t *>(bytes + parse_actions_offset);
+
+      // Find a group of terminals whose value is an entry with at least one
+      // action, and point the value at that entry's first action instead.
+      uint16_t *corrupted_value = nullptr;
+      for (uint32_t i = 0; i < state_count - large_state_count && !corrupted_value; i++) {
+        uint32_t index = small_parse_table_map[i];
+        uint16_t group_count = small_parse_table[index++];
+        for (uint16_t j = 0; j < group_count && !corrupted_value; j++) {
+          uint16_t *value = &small_parse_table[index++];
+          uint16_t group_symbol_count = small_parse_table[index++];
+          bool all_terminals = true;
+          for (uint16_t k = 0; k < group_symbol_count; k++) {
+            if (small_parse_table[index++] >= token_count) all_terminals = false;
+          }
+          if (all_terminals && parse_actions[*value * 4] > 0) corrupted_value = value;
+        }
+      }
+
+      AssertThat(corrupted_value, !Equals<uint16_t *>(nullptr));
+      (*corrupted_value)++;
+      AssertThat(ts_language_load(corrupt_data.data(), compile_result.size), Equals<const TSLanguage *>(nullptr));
+    });
+  });
+
+  describe("ts_language_lookup(language, state, symbol)", [&]() {
+    // Symbols 0 to 2 are tokens, and symbols 3 and 4 are non-terminals. States
+    // 0 and 1 are stored densely, and states 2 and 3 as lists of groups.
+    const unsigned symbol_count = 5;
+    const unsigned LARGE_STATE_COUNT = 2;
+    TSParseActionEntry parse_actions[5];
+    uint16_t parse_table[LARGE_STATE_COUNT * symbol_count] = {
+      0, 0, 0, 0, 0,
+      0, 1, 0, 2, 0,
+    };
+    uint16_t small_parse_table[] = {
+      2,
+      3, 2, 1, 2,
+      3, 1, 4,
+      1,
+      1, 1, 0,
+    };
+    uint32_t small_parse_table_map[2];
+    TSLanguage language;
+
+    before_each([&]() {
+      memset(parse_actions, 0, sizeof(parse_actions));
+      parse_actions[1].count = 1;
+      parse_actions[2].action.type = TSParseActionTypeShift;
+      parse_actions[2].action.params.to_state = 3;
+      parse_actions[3].count = 1;
+      parse_actions[4].action.type = TSParseActionTypeShift;
+      parse_actions[4].action.params.to_state = 2;
+
+      small_parse_table_map[SMALL_STATE(2)] = 0;
+      small_parse_table_map[SMALL_STATE(3)] = 8;
+
+      memset(&language, 0, sizeof(language));
+      language.symbol_count = symbol_count;
+      language.token_count = 3;
+      language.large_state_count = LARGE_STATE_COUNT;
+      language.parse_table = parse_table;
+      language.small_parse_table = small_parse_table;
+      language.small_parse_table_map = small_parse_table_map;
+      language.parse_actions = parse_actions;
+    });
+
+    it("reads the rows of large states, including the error and start states", [&]() {
+      for (TSSymbol symbol = 0; symbol < symbol_count; symbol++) {
+        AssertThat(ts_language_lookup(&language, 0, symbol), Equals(0));
+      }
+      AssertThat(ts_language_lookup(&language, 1, 1), Equals(1));
+      AssertThat(ts_language_lookup(&language, 1, 3), Equals(2));
+      AssertThat(ts_language_lookup(&language, 1, 4), Equals(0));
+    });
+
+    it("finds each symbol's group in small states", [&]() {
+      AssertThat(ts_language_lookup(&language, 2, 1), Equals(3));
+      AssertThat(ts_language_lookup(&language, 2, 2), Equals(3));
+      AssertThat(ts_language_lookup(&language, 2, 4), Equals(3));
+      AssertThat(ts_language_lookup(&language, 3, 0), Equals(1));
+    });
+
+    it("returns 0 for symbols that are missing from small states", [&]() {
+      AssertThat(ts_language_lookup(&language, 2, 0), Equals(0));
+      AssertThat(ts_language_lookup(&language, 2, 3), Equals(0));
+      AssertThat(ts_language_lookup(&language, 3, 1), Equals(0));
+      AssertThat(ts_language_lookup(&language, 3, 4), Equals(0));
+    });
+
+    it("returns states for non-terminals and actions for tokens from ts_language_next_state", [&]() {
+      AssertThat(ts_language_next_state(&language, 1, 3), Equals(2));
+      AssertThat(ts_language_next_state(&language, 2, 4), Equals(3));
+      AssertThat(ts_language_next_state(&language, 1, 1), Equals(3));
+      AssertThat(ts_language_next_state(&language, 2, 1), Equals(2));
+      AssertThat(ts_language_next_state(&language, 3, 0), Equals(3));
+      AssertThat(ts_language_next_state(&language, 2, 0), Equals(0));
+    });
+  });
+
+  describe("ts_compile_grammar_binary(grammar)", [&]() {
+    it("rejects grammars with external tokens", [&]() {
+      TSBinaryCompileResult result = ts_compile_grammar_binary(R"JSON({
+        "name": "external_tokens",
+        "externals": [{"type": "SYMBOL", "name": "string"}],
+        "rules": {
+          "program": {"type": "SYMBOL", "name": "string"}
+        }
+      })JSON");
+
+      AssertThat(result.data, Equals<char *>(nullptr));
+      AssertThat(result.error_type, Equals(TSCompileErrorTypeInvalidExternalToken));
+      free(result.error_message);
+    });
+  });
+});
+
+END_TEST
@@ -431,6 +431,73 @@ describe("Node", []() {
       AssertThat(ts_node_end_point(node2), Equals<TSPoint>({ 6, 13 }));
     });
   });
+  describe("tree cursor", [&]() {
+    TSTreeCursor *cursor;
+
+    before_each([&]() {
+      cursor = ts_document_tree_cursor(document);
+    });
+
+    after_each([&]() {
+      ts_tree_cursor_delete(cursor);
+    });
+
+    it("starts at the root node", [&]() {
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(array_node));
+      AssertThat(ts_tree_cursor_goto_parent(cursor), IsFalse());
+      AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsFalse());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(array_node));
+    });
+
+    it("visits the same nodes as child() and next_sibling()", [&]() {
+      AssertThat(ts_tree_cursor_goto_first_child(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(ts_node_child(array_node, 0)));
+
+      for (uint32_t i = 1; i < ts_node_child_count(array_node); i++) {
+        AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsTrue());
+        AssertThat(ts_tree_cursor_current_node(cursor), Equals(ts_node_child(array_node, i)));
+      }
+      AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsFalse());
+
+      AssertThat(ts_tree_cursor_goto_parent(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(array_node));
+    });
+
+    it("descends into nested nodes and reports their positions", [&]() {
+      TSNode object_node = ts_node_child(array_node, 5);
+      TSNode pair_node = ts_node_child(object_node, 1);
+
+      AssertThat(ts_tree_cursor_goto_first_child(cursor), IsTrue());
+      for (uint32_t i = 0; i < 5; i++)
+        AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(object_node));
+
+      AssertThat(ts_tree_cursor_goto_first_child(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(pair_node));
+
+      AssertThat(ts_tree_cursor_goto_first_child(cursor), IsTrue());
+      TSNode string_node = ts_tree_cursor_current_node(cursor);
+      AssertThat(ts_node_type(string_node, document), Equals("string"));
+      AssertThat(ts_node_start_byte(string_node), Equals(string_index));
+      AssertThat(ts_node_end_byte(string_node), Equals(string_end_index));
+      AssertThat(ts_node_start_point(string_node), Equals<TSPoint>({ 6, 4 }));
+      AssertThat(ts_tree_cursor_goto_first_child(cursor), IsFalse());
+
+      AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsTrue());
+      TSNode null_node = ts_tree_cursor_current_node(cursor);
+      AssertThat(ts_node_start_byte(null_node), Equals(null_index));
+      AssertThat(ts_node_end_byte(null_node), Equals(null_end_index));
+
+      AssertThat(ts_tree_cursor_goto_parent(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(pair_node));
+      AssertThat(ts_tree_cursor_goto_parent(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(object_node));
+      AssertThat(ts_tree_cursor_goto_next_sibling(cursor), IsTrue());
+      AssertThat(ts_tree_cursor_current_node(cursor), Equals(ts_node_child(array_node, 6)));
+    });
+  });
 });
 
 END_TEST
@@ -91,15 +91,15 @@ describe("Parser", [&]() {
 
         TSNode error = ts_node_named_child(root, 1);
         AssertThat(ts_node_type(error, document), Equals("ERROR"));
-        AssertThat(get_node_text(error), Equals(",  @@@@@"));
+        AssertThat(get_node_text(error), Equals("@@@@@,"));
         AssertThat(ts_node_child_count(error), Equals<size_t>(2));
 
-        TSNode comma = ts_node_child(error, 0);
-        AssertThat(get_node_text(comma), Equals(","));
-
-        TSNode garbage = ts_node_child(error, 1);
+        TSNode garbage = ts_node_child(error, 0);
         AssertThat(get_node_text(garbage), Equals("@@@@@"));
 
+        TSNode comma = ts_node_child(error, 1);
+        AssertThat(get_node_text(comma), Equals(","));
+
         TSNode node_after_error = ts_node_named_child(root, 2);
         AssertThat(ts_node_type(node_after_error, document), Equals("true"));
         AssertThat(get_node_text(node_after_error), Equals("true"));
@@ -118,14 +118,14 @@ describe("Parser", [&]() {
         AssertThat(ts_node_type(error, document), Equals("ERROR"));
         AssertThat(ts_node_child_count(error), Equals<size_t>(2));
 
-        TSNode comma = ts_node_child(error, 0);
-        AssertThat(ts_node_type(comma, document), Equals(","));
-        AssertThat(get_node_text(comma), Equals(","));
-
-        TSNode garbage = ts_node_child(error, 1);
+        TSNode garbage = ts_node_child(error, 0);
         AssertThat(ts_node_type(garbage, document), Equals("ERROR"));
         AssertThat(get_node_text(garbage), Equals("faaaaalse"));
 
+        TSNode comma = ts_node_child(error, 1);
+        AssertThat(ts_node_type(comma, document), Equals(","));
+        AssertThat(get_node_text(comma), Equals(","));
+
         TSNode last = ts_node_named_child(root, 2);
         AssertThat(ts_node_type(last, document), Equals("true"));
         AssertThat(ts_node_start_byte(last), Equals(strlen("  [123, faaaaalse, ")));
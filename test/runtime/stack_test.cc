@@ -78,7 +78,7 @@ describe("Stack", [&]() {
     stack = ts_stack_new();
 
     for (size_t i = 0; i < tree_count; i++)
-      trees[i] = ts_tree_make_leaf(i, length_zero(), tree_len, {
+      trees[i] = ts_tree_make_leaf(nullptr, i, length_zero(), tree_len, {
         true, true, false, true,
       });
   });
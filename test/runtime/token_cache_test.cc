@@ -0,0 +1,69 @@
+#include "test_helper.h"
+#include "helpers/record_alloc.h"
+#include "runtime/token_cache.h"
+#include "runtime/tree.h"
+#include "runtime/length.h"
+
+START_TEST
+
+describe("TokenCache", [&]() {
+  TokenCache cache;
+  Tree *token;
+  TSSymbolMetadata metadata = {true, true, false, true};
+  TSLexMode lex_mode = {1, 0};
+  TSExternalTokenState external_token_state = {1, 2, 3};
+
+  before_each([&]() {
+    record_alloc::start();
+    ts_token_cache_init(&cache);
+    token = ts_tree_make_leaf(nullptr, 1, length_zero(), {2, 2, {0, 2}}, metadata);
+  });
+
+  after_each([&]() {
+    ts_tree_release(token);
+    ts_token_cache_clear(&cache);
+    record_alloc::stop();
+    AssertThat(record_alloc::outstanding_allocation_indices(), IsEmpty());
+  });
+
+  it("returns tokens lexed at the same position in the same lex mode", [&]() {
+    ts_token_cache_set(&cache, 5, lex_mode, nullptr, token);
+    AssertThat(token->ref_count, Equals(2));
+
+    AssertThat(ts_token_cache_get(&cache, 5, lex_mode, nullptr), Equals(token));
+    AssertThat(ts_token_cache_get(&cache, 6, lex_mode, nullptr), IsNull());
+    AssertThat(ts_token_cache_get(&cache, 5, {2, 0}, nullptr), IsNull());
+    AssertThat(cache.hit_count, Equals(1u));
+    AssertThat(cache.miss_count, Equals(2u));
+  });
+
+  it("distinguishes tokens by their preceding external scanner state", [&]() {
+    TSExternalTokenState other_external_token_state = {1, 2, 4};
+    ts_token_cache_set(&cache, 5, lex_mode, &external_token_state, token);
+
+    AssertThat(ts_token_cache_get(&cache, 5, lex_mode, &external_token_state), Equals(token));
+    AssertThat(ts_token_cache_get(&cache, 5, lex_mode, &other_external_token_state), IsNull());
+    AssertThat(ts_token_cache_get(&cache, 5, lex_mode, nullptr), IsNull());
+  });
+
+  it("releases the oldest token when it is full", [&]() {
+    ts_token_cache_set(&cache, 0, lex_mode, nullptr, token);
+    for (uint32_t i = 1; i < TOKEN_CACHE_SIZE; i++) {
+      Tree *other_token = ts_tree_make_leaf(nullptr, 1, length_zero(), {2, 2, {0, 2}}, metadata);
+      ts_token_cache_set(&cache, i, lex_mode, nullptr, other_token);
+      ts_tree_release(other_token);
+    }
+
+    AssertThat(token->ref_count, Equals(2));
+    AssertThat(ts_token_cache_get(&cache, 0, lex_mode, nullptr), Equals(token));
+
+    Tree *other_token = ts_tree_make_leaf(nullptr, 1, length_zero(), {2, 2, {0, 2}}, metadata);
+    ts_token_cache_set(&cache, TOKEN_CACHE_SIZE, lex_mode, nullptr, other_token);
+    ts_tree_release(other_token);
+
+    AssertThat(token->ref_count, Equals(1));
+    AssertThat(ts_token_cache_get(&cache, 0, lex_mode, nullptr), IsNull());
+  });
+});
+
+END_TEST
@@ -1,8 +1,10 @@
 #include "test_helper.h"
 #include "helpers/tree_helpers.h"
 #include "helpers/point_helpers.h"
+#include "helpers/record_alloc.h"
 #include "runtime/tree.h"
 #include "runtime/length.h"
+#include <thread>
 
 void assert_consistent(const Tree *tree) {
   if (tree->child_count == 0)
@@ -40,15 +42,71 @@ describe("Tree", []() {
 
   describe("make_leaf", [&]() {
     it("does not mark the tree as fragile", [&]() {
-      Tree *tree = ts_tree_make_leaf(symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+      Tree *tree = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
       AssertThat(tree->fragile_left, IsFalse());
       AssertThat(tree->fragile_right, IsFalse());
     });
+
+    it("allocates a compact tree without the fields used by internal nodes", [&]() {
+      Tree *tree = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+      AssertThat(tree->compact, IsTrue());
+      AssertThat(ts_tree_error_cost(tree), Equals(0u));
+      AssertThat(TREE_COMPACT_SIZE, IsLessThan(sizeof(Tree)));
+      ts_tree_release(tree);
+    });
+  });
+
+  describe("make_copy", [&]() {
+    it("expands compact trees so that children can be assigned", [&]() {
+      Tree *leaf = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+      Tree *copy = ts_tree_make_copy(nullptr, leaf);
+      AssertThat(copy->compact, IsFalse());
+      AssertThat(copy->symbol, Equals(symbol1));
+      AssertThat(copy->size, Equals<Length>(leaf->size));
+      AssertThat(copy->error_cost, Equals(0u));
+      AssertThat(copy->children, Equals<Tree **>(nullptr));
+      AssertThat(ts_tree_eq(copy, leaf), IsTrue());
+      ts_tree_release(leaf);
+      ts_tree_release(copy);
+    });
+  });
+
+  describe("retain/release", [&]() {
+    it("counts references beyond the range of a 16-bit integer", [&]() {
+      Tree *tree = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+      for (unsigned i = 0; i < 70000; i++)
+        ts_tree_retain(tree);
+      AssertThat(tree->ref_count, Equals(70001u));
+      for (unsigned i = 0; i < 70000; i++)
+        ts_tree_release(tree);
+      AssertThat(tree->ref_count, Equals(1u));
+      ts_tree_release(tree);
+    });
+
+    it("updates reference counts atomically across threads", [&]() {
+      Tree *tree = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+
+      vector<std::thread> threads;
+      for (unsigned i = 0; i < 4; i++) {
+        threads.push_back(std::thread([tree]() {
+          for (unsigned j = 0; j < 10000; j++) {
+            ts_tree_retain(tree);
+            ts_tree_release(tree);
+          }
+        }));
+      }
+      for (auto &thread : threads)
+        thread.join();
+
+      AssertThat(tree->ref_count, Equals(1u));
+      ts_tree_release(tree);
+    });
   });
 
   describe("make_error", [&]() {
     it("marks the tree as fragile", [&]() {
       Tree *error_tree = ts_tree_make_error(
+        nullptr,
         length_zero(),
         length_zero(),
         'z');
@@ -60,16 +118,52 @@ describe("Tree", []() {
     });
   });
 
+  describe("make_leaf(arena)", [&]() {
+    it("frees the arena's blocks once their trees have all been released", [&]() {
+      record_alloc::start();
+      TreeArena *arena = ts_tree_arena_new();
+
+      Tree *tree1 = ts_tree_make_leaf(arena, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+      Tree *tree2 = ts_tree_make_leaf(arena, symbol2, {1, 1, {0, 1}}, {3, 3, {0, 3}}, visible);
+      Tree *parent = ts_tree_make_node(arena, symbol3, 2, tree_array({
+        tree1,
+        tree2,
+      }), visible);
+      AssertThat(tree1->in_arena, IsTrue());
+      AssertThat(parent->in_arena, IsTrue());
+      AssertThat(arena->block_count, Equals(1u));
+
+      // Only the block remains allocated.
+      ts_tree_arena_delete(arena);
+      AssertThat(record_alloc::outstanding_allocation_indices().size(), Equals(1u));
+
+      ts_tree_release(parent);
+      record_alloc::stop();
+      AssertThat(record_alloc::outstanding_allocation_indices(), IsEmpty());
+    });
+
+    it("allocates a new block when the current one is full", [&]() {
+      TreeArena *arena = ts_tree_arena_new();
+      vector<Tree *> trees;
+      while (arena->block_count < 2)
+        trees.push_back(ts_tree_make_leaf(arena, symbol1, length_zero(), length_zero(), visible));
+      ts_tree_arena_delete(arena);
+
+      for (Tree *tree : trees)
+        ts_tree_release(tree);
+    });
+  });
+
   describe("make_node", [&]() {
     Tree *tree1, *tree2, *parent1;
 
     before_each([&]() {
-      tree1 = ts_tree_make_leaf(symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
-      tree2 = ts_tree_make_leaf(symbol2, {1, 1, {0, 1}}, {3, 3, {0, 3}}, visible);
+      tree1 = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+      tree2 = ts_tree_make_leaf(nullptr, symbol2, {1, 1, {0, 1}}, {3, 3, {0, 3}}, visible);
 
       ts_tree_retain(tree1);
       ts_tree_retain(tree2);
-      parent1 = ts_tree_make_node(symbol3, 2, tree_array({
+      parent1 = ts_tree_make_node(nullptr, symbol3, 2, tree_array({
         tree1,
         tree2,
       }), visible);
@@ -100,7 +194,7 @@ describe("Tree", []() {
 
         ts_tree_retain(tree1);
         ts_tree_retain(tree2);
-        parent = ts_tree_make_node(symbol3, 2, tree_array({
+        parent = ts_tree_make_node(nullptr, symbol3, 2, tree_array({
           tree1,
           tree2,
         }), visible);
@@ -124,7 +218,7 @@ describe("Tree", []() {
 
         ts_tree_retain(tree1);
         ts_tree_retain(tree2);
-        parent = ts_tree_make_node(symbol3, 2, tree_array({
+        parent = ts_tree_make_node(nullptr, symbol3, 2, tree_array({
           tree1,
           tree2,
         }), visible);
@@ -148,7 +242,7 @@ describe("Tree", []() {
 
         ts_tree_retain(tree1);
         ts_tree_retain(tree2);
-        parent = ts_tree_make_node(symbol3, 2, tree_array({
+        parent = ts_tree_make_node(nullptr, symbol3, 2, tree_array({
           tree1,
           tree2,
         }), visible);
@@ -169,10 +263,10 @@ describe("Tree", []() {
     Tree *tree = nullptr;
 
     before_each([&]() {
-      tree = ts_tree_make_node(symbol1, 3, tree_array({
-        ts_tree_make_leaf(symbol2, {2, 2, {0, 2}}, {3, 3, {0, 3}}, visible),
-        ts_tree_make_leaf(symbol3, {2, 2, {0, 2}}, {3, 3, {0, 3}}, visible),
-        ts_tree_make_leaf(symbol4, {2, 2, {0, 2}}, {3, 3, {0, 3}}, visible),
+      tree = ts_tree_make_node(nullptr, symbol1, 3, tree_array({
+        ts_tree_make_leaf(nullptr, symbol2, {2, 2, {0, 2}}, {3, 3, {0, 3}}, visible),
+        ts_tree_make_leaf(nullptr, symbol3, {2, 2, {0, 2}}, {3, 3, {0, 3}}, visible),
+        ts_tree_make_leaf(nullptr, symbol4, {2, 2, {0, 2}}, {3, 3, {0, 3}}, visible),
       }), visible);
 
       AssertThat(tree->padding, Equals<Length>({2, 2, {0, 2}}));
@@ -336,7 +430,7 @@ describe("Tree", []() {
     Tree *leaf;
 
     before_each([&]() {
-      leaf = ts_tree_make_leaf(symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
+      leaf = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, {5, 4, {0, 4}}, visible);
     });
 
     after_each([&]() {
@@ -344,17 +438,17 @@ describe("Tree", []() {
     });
 
     it("returns true for identical trees", [&]() {
-      Tree *leaf_copy = ts_tree_make_leaf(symbol1, {2, 1, {1, 1}}, {5, 4, {1, 4}}, visible);
+      Tree *leaf_copy = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {1, 1}}, {5, 4, {1, 4}}, visible);
       AssertThat(ts_tree_eq(leaf, leaf_copy), IsTrue());
 
-      Tree *parent = ts_tree_make_node(symbol2, 2, tree_array({
+      Tree *parent = ts_tree_make_node(nullptr, symbol2, 2, tree_array({
         leaf,
         leaf_copy,
       }), visible);
       ts_tree_retain(leaf);
       ts_tree_retain(leaf_copy);
 
-      Tree *parent_copy = ts_tree_make_node(symbol2, 2, tree_array({
+      Tree *parent_copy = ts_tree_make_node(nullptr, symbol2, 2, tree_array({
         leaf,
         leaf_copy,
       }), visible);
@@ -370,6 +464,7 @@ describe("Tree", []() {
 
     it("returns false for trees with different symbols", [&]() {
       Tree *different_leaf = ts_tree_make_leaf(
+        nullptr,
         leaf->symbol + 1,
         leaf->padding,
         leaf->size,
@@ -380,32 +475,32 @@ describe("Tree", []() {
     });
 
     it("returns false for trees with different options", [&]() {
-      Tree *different_leaf = ts_tree_make_leaf(symbol1, leaf->padding, leaf->size, invisible);
+      Tree *different_leaf = ts_tree_make_leaf(nullptr, symbol1, leaf->padding, leaf->size, invisible);
       AssertThat(ts_tree_eq(leaf, different_leaf), IsFalse());
       ts_tree_release(different_leaf);
     });
 
     it("returns false for trees with different sizes", [&]() {
-      Tree *different_leaf = ts_tree_make_leaf(symbol1, {2, 1, {0, 1}}, leaf->size, invisible);
+      Tree *different_leaf = ts_tree_make_leaf(nullptr, symbol1, {2, 1, {0, 1}}, leaf->size, invisible);
       AssertThat(ts_tree_eq(leaf, different_leaf), IsFalse());
       ts_tree_release(different_leaf);
 
-      different_leaf = ts_tree_make_leaf(symbol1, leaf->padding, {5, 4, {1, 10}}, invisible);
+      different_leaf = ts_tree_make_leaf(nullptr, symbol1, leaf->padding, {5, 4, {1, 10}}, invisible);
       AssertThat(ts_tree_eq(leaf, different_leaf), IsFalse());
       ts_tree_release(different_leaf);
     });
 
     it("returns false for trees with different children", [&]() {
-      Tree *leaf2 = ts_tree_make_leaf(symbol2, {1, 1, {0, 1}}, {3, 3, {0, 3}}, visible);
+      Tree *leaf2 = ts_tree_make_leaf(nullptr, symbol2, {1, 1, {0, 1}}, {3, 3, {0, 3}}, visible);
 
-      Tree *parent = ts_tree_make_node(symbol2, 2, tree_array({
+      Tree *parent = ts_tree_make_node(nullptr, symbol2, 2, tree_array({
         leaf,
         leaf2,
       }), visible);
       ts_tree_retain(leaf);
       ts_tree_retain(leaf2);
 
-      Tree *different_parent = ts_tree_make_node(symbol2, 2, tree_array({
+      Tree *different_parent = ts_tree_make_node(nullptr, symbol2, 2, tree_array({
         leaf2,
         leaf,
       }), visible);
@@ -421,30 +516,112 @@ describe("Tree", []() {
     });
   });
 
+  describe("balance", [&]() {
+    auto repeat_height = [](const Tree *tree) {
+      uint32_t result = 0;
+      vector<pair<const Tree *, uint32_t>> stack({{tree, 1}});
+      while (!stack.empty()) {
+        auto entry = stack.back();
+        stack.pop_back();
+        if (entry.second > result) result = entry.second;
+        for (uint32_t i = 0; i < entry.first->child_count; i++) {
+          const Tree *child = entry.first->children[i];
+          if (child->symbol == entry.first->symbol)
+            stack.push_back({child, entry.second + 1});
+        }
+      }
+      return result;
+    };
+
+    auto leaves = [](const Tree *tree) {
+      vector<const Tree *> result;
+      vector<const Tree *> stack({tree});
+      while (!stack.empty()) {
+        const Tree *node = stack.back();
+        stack.pop_back();
+        if (node->child_count == 0) result.push_back(node);
+        for (uint32_t i = node->child_count; i > 0; i--)
+          stack.push_back(node->children[i - 1]);
+      }
+      return result;
+    };
+
+    it("turns left-recursive chains of repetition nodes into balanced trees", [&]() {
+      Length size = {1, 1, {0, 1}};
+      Tree *tree = ts_tree_make_node(nullptr, symbol2, 1, tree_array({
+        ts_tree_make_leaf(nullptr, symbol1, length_zero(), size, visible),
+      }), invisible);
+      for (unsigned i = 1; i < 64; i++) {
+        tree = ts_tree_make_node(nullptr, symbol2, 2, tree_array({
+          tree,
+          ts_tree_make_node(nullptr, symbol2, 1, tree_array({
+            ts_tree_make_leaf(nullptr, symbol1, length_zero(), size, visible),
+          }), invisible),
+        }), invisible);
+      }
+
+      AssertThat(tree->repeat_depth, Equals(63u));
+      vector<const Tree *> leaves_before = leaves(tree);
+
+      TreePath path = array_new();
+      ts_tree_balance(tree, &path);
+      ts_tree_assign_parents(tree, &path);
+      array_delete(&path);
+
+      AssertThat(repeat_height(tree), IsLessThan(10u));
+      AssertThat(leaves(tree), Equals(leaves_before));
+      AssertThat(tree->size, Equals<Length>({64, 64, {0, 64}}));
+      assert_consistent(tree);
+
+      ts_tree_release(tree);
+    });
+
+    it("does not modify trees that are shared", [&]() {
+      Tree *chain = ts_tree_make_node(nullptr, symbol2, 2, tree_array({
+        ts_tree_make_node(nullptr, symbol2, 2, tree_array({
+          ts_tree_make_node(nullptr, symbol2, 1, tree_array({
+            ts_tree_make_leaf(nullptr, symbol1, length_zero(), length_zero(), visible),
+          }), invisible),
+          ts_tree_make_node(nullptr, symbol2, 1, tree_array({
+            ts_tree_make_leaf(nullptr, symbol1, length_zero(), length_zero(), visible),
+          }), invisible),
+        }), invisible),
+        ts_tree_make_node(nullptr, symbol2, 1, tree_array({
+          ts_tree_make_leaf(nullptr, symbol1, length_zero(), length_zero(), visible),
+        }), invisible),
+      }), invisible);
+
+      Tree *left_child = chain->children[0];
+      ts_tree_retain(chain);
+
+      TreePath path = array_new();
+      ts_tree_balance(chain, &path);
+      array_delete(&path);
+
+      AssertThat(chain->children[0], Equals(left_child));
+      ts_tree_release(chain);
+      ts_tree_release(chain);
+    });
+  });
+
   describe("last_external_token_state", [&]() {
     Length padding = {1, 1, {0, 1}};
     Length size = {2, 2, {0, 2}};
 
-    auto make_external = [](Tree *tree) {
-      tree->has_external_tokens = true;
-      tree->has_external_token_state = true;
-      return tree;
-    };
-
     it("returns the last serialized external token state in the given tree", [&]() {
       Tree *tree1, *tree2, *tree3, *tree4, *tree5, *tree6, *tree7, *tree8, *tree9;
 
-      tree1 = ts_tree_make_node(symbol1, 2, tree_array({
-        (tree2 = ts_tree_make_node(symbol2, 3, tree_array({
-          (tree3 = make_external(ts_tree_make_leaf(symbol3, padding, size, visible))),
-          (tree4 = ts_tree_make_leaf(symbol4, padding, size, visible)),
-          (tree5 = ts_tree_make_leaf(symbol5, padding, size, visible)),
+      tree1 = ts_tree_make_node(nullptr, symbol1, 2, tree_array({
+        (tree2 = ts_tree_make_node(nullptr, symbol2, 3, tree_array({
+          (tree3 = ts_tree_make_external_leaf(nullptr, symbol3, padding, size, visible)),
+          (tree4 = ts_tree_make_leaf(nullptr, symbol4, padding, size, visible)),
+          (tree5 = ts_tree_make_leaf(nullptr, symbol5, padding, size, visible)),
         }), visible)),
-        (tree6 = ts_tree_make_node(symbol6, 2, tree_array({
-          (tree7 = ts_tree_make_node(symbol7, 1, tree_array({
-            (tree8 = ts_tree_make_leaf(symbol8, padding, size, visible)),
+        (tree6 = ts_tree_make_node(nullptr, symbol6, 2, tree_array({
+          (tree7 = ts_tree_make_node(nullptr, symbol7, 1, tree_array({
+            (tree8 = ts_tree_make_leaf(nullptr, symbol8, padding, size, visible)),
           }), visible)),
-          (tree9 = ts_tree_make_leaf(symbol9, padding, size, visible)),
+          (tree9 = ts_tree_make_leaf(nullptr, symbol9, padding, size, visible)),
         }), visible)),
       }), visible);
 
@@ -0,0 +1,73 @@
+#include "test_helper.h"
+#include "runtime/utf8.h"
+
+START_TEST
+
+describe("utf8_iterate", []() {
+  auto decode = [](const string &input, int32_t *code_point) {
+    return utf8_iterate((const uint8_t *)input.data(), input.size(), code_point);
+  };
+
+  it("decodes ascii characters as single bytes", [&]() {
+    int32_t code_point;
+    AssertThat(decode("a", &code_point), Equals(1));
+    AssertThat(code_point, Equals('a'));
+  });
+
+  it("decodes multi-byte sequences", [&]() {
+    int32_t code_point;
+    AssertThat(decode("\xc3\xa9", &code_point), Equals(2));
+    AssertThat(code_point, Equals(0xe9));
+    AssertThat(decode("\xe2\x82\xac", &code_point), Equals(3));
+    AssertThat(code_point, Equals(0x20ac));
+    AssertThat(decode("\xf0\x9f\x98\x80", &code_point), Equals(4));
+    AssertThat(code_point, Equals(0x1f600));
+  });
+
+  it("consumes one byte of a malformed sequence", [&]() {
+    int32_t code_point;
+
+    // Truncated
+    AssertThat(decode("\xe2\x82", &code_point), Equals(1));
+    AssertThat(code_point, Equals(-1));
+
+    // Bad continuation byte
+    AssertThat(decode("\xc3x", &code_point), Equals(1));
+    AssertThat(code_point, Equals(-1));
+
+    // Overlong encoding of '/'
+    AssertThat(decode("\xe0\x80\xaf", &code_point), Equals(1));
+    AssertThat(code_point, Equals(-1));
+
+    // UTF-16 surrogate
+    AssertThat(decode("\xed\xa0\x80", &code_point), Equals(1));
+    AssertThat(code_point, Equals(-1));
+
+    // Past U+10FFFF
+    AssertThat(decode("\xf4\x90\x80\x80", &code_point), Equals(1));
+    AssertThat(code_point, Equals(-1));
+  });
+});
+
+describe("utf8_ascii_prefix_length", []() {
+  auto prefix_length = [](const string &input) {
+    return utf8_ascii_prefix_length((const uint8_t *)input.data(), input.size());
+  };
+
+  it("returns the full length of ascii-only strings", [&]() {
+    AssertThat(prefix_length(""), Equals(0u));
+    AssertThat(prefix_length("abc"), Equals(3u));
+    AssertThat(prefix_length(string(100, 'x')), Equals(100u));
+  });
+
+  it("returns the position of the first non-ascii byte", [&]() {
+    AssertThat(prefix_length("\xc3\xa9"), Equals(0u));
+
+    for (size_t i = 0; i < 70; i++) {
+      string input = string(i, 'x') + "\xc3\xa9" + string(40, 'y');
+      AssertThat(prefix_length(input), Equals<uint32_t>(i));
+    }
+  });
+});
+
+END_TEST
@@ -21,10 +21,11 @@
         '<!@(find test/helpers -name "*.cc")',
       ],
       'libraries': [
-        '-ldl'
+        '-ldl',
+        '-lpthread',
       ],
       'default_configuration': 'Test',
-      'configurations': {'Test': {}, 'Release': {}},
+      'configurations': {'Test': {}, 'Release': {}, 'Benchmark': {}},
       'cflags': [
         '-g',
         '-O0',
@@ -53,6 +54,63 @@
           '-Wno-unused-parameter'
         ],
       },
+    },
+    {
+      'target_name': 'benchmarks',
+      'type': 'executable',
+      'dependencies': [
+        'project.gyp:runtime',
+        'project.gyp:compiler'
+      ],
+      'include_dirs': [
+        'src',
+        'test',
+        'externals/bandit',
+        'externals/utf8proc',
+      ],
+      'sources': [
+        'test/benchmarks.cc',
+        'test/helpers/encoding_helpers.cc',
+        'test/helpers/file_helpers.cc',
+        'test/helpers/load_language.cc',
+        'test/helpers/read_test_entries.cc',
+        'test/helpers/record_alloc.cc',
+        'test/helpers/spy_input.cc',
+      ],
+      'libraries': [
+        '-ldl',
+        '-lpthread',
+      ],
+      'default_configuration': 'Benchmark',
+      'configurations': {'Test': {}, 'Release': {}, 'Benchmark': {}},
+      'cflags': [
+        '-g',
+        '-O2',
+        '-Wall',
+        '-Wextra',
+        '-Wno-unused-parameter',
+        '-Wno-unknown-pragmas',
+      ],
+      'cflags_c': [
+        '-std=c99',
+      ],
+      'cflags_cc': [
+        '-std=c++14',
+      ],
+      'ldflags': [
+        '-g',
+      ],
+      'xcode_settings': {
+        'CLANG_CXX_LANGUAGE_STANDARD': 'c++14',
+        'OTHER_LDFLAGS': ['-g'],
+        'GCC_OPTIMIZATION_LEVEL': '2',
+        'ALWAYS_SEARCH_USER_PATHS': 'NO',
+        'WARNING_CFLAGS': [
+          '-Wall',
+          '-Wextra',
+          '-Wno-unused-parameter'
+        ],
+      },
     }
   ]
 }